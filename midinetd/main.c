@@ -59,6 +59,7 @@ int midi_fd;
 int inetd = 0;
 
 #define MPUDEVICE "/dev/mpu401"
+#define MIDIDEVICE "/dev/midi"
 #define MIDINETSERVICE "midinet"
 
 int printerror( char *str ) {
@@ -100,15 +101,43 @@ struct servent *sent;
 int addlen;
 int *addlen_ptr = &addlen;
 int setval;
+int c;
+int udp_port = 0;
+char *udp_device = MIDIDEVICE;
+int jitter_ms = 5;
+int loopback = 0;
 
 
 /* argv[0] == "in.midinetd" means started by inetd */
 if (!strcmp( argv[0], "in.midinetd") ) inetd = 1;
 
-if (argc > 1) {
-	logfd = open( argv[1], O_APPEND | O_CREAT | O_WRONLY, 00666 );
+/* midinetd [-u port [-d device] [-j jitter ms] [-l]] [logfile] */
+while ((c = getopt( argc, argv, "u:d:j:l" )) != -1) {
+	switch (c) {
+	case 'u':
+		udp_port = atoi( optarg );
+		break;
+	case 'd':
+		udp_device = optarg;
+		break;
+	case 'j':
+		jitter_ms = atoi( optarg );
+		break;
+	case 'l':
+		loopback = 1;
+		break;
+	default:
+		fprintf( stderr,
+			"usage: %s [-u port [-d device] [-j jitter ms] [-l]] [logfile]\n",
+			argv[0] );
+		exit(1);
+	}
+}
+
+if (optind < argc) {
+	logfd = open( argv[optind], O_APPEND | O_CREAT | O_WRONLY, 00666 );
 	if (logfd == -1) {
-		fprintf( stderr, "Could not open logfile %s\n", argv[1] );
+		fprintf( stderr, "Could not open logfile %s\n", argv[optind] );
 		exit(1);
 	}
 	if (dup2( logfd, 2 ) == -1) {
@@ -117,6 +146,12 @@ if (argc > 1) {
 	}
 }
 
+/* The datagram transport replaces the RPC and TCP connections */
+if (udp_port) {
+	udp_server( udp_port, udp_device, jitter_ms, loopback );
+	exit(1);
+}
+
 if (!inetd) {
 
 	/* Set adress-type and address */
@@ -24,3 +24,4 @@ int printerror( char *str );
 void closedown( int sig );
 void mpu_reader_process( int fd, int tcp_sd );
 void midinet_prog_1( struct svc_req *rqstp, register SVCXPRT *transp );
+int udp_server( int port, char *device, int jitter_ms, int loopback );
@@ -0,0 +1,479 @@
+/*
+**  jazz - a midi sequencer for Linux
+**
+**  Copyright (C) 1994 Andreas Voss (andreas@avix.rhein-neckar.de)
+**
+**  Portions Copyright (C) 1995 Per Sigmond (Per.Sigmond@hia.no)
+**
+**  This program is free software; you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation; either version 2 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program; if not, write to the Free Software
+**  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* midinetd UDP transport: timestamped bundles and a jitter buffer.	*/
+/* The packet layout is described in src/midinet.h.			*/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <rpc/rpc.h>
+#include "midinet.h"
+#include "midinetd.h"
+
+/* Events waiting in the jitter buffer */
+#define MAX_PENDING 4096
+
+/* The clock offset is the smallest one seen in a window of this length */
+#define OFFSET_WINDOW 2000000
+
+struct pending_event {
+	long long due;
+	int len;
+	unsigned char data[255];
+};
+
+static int udp_sd = -1;
+static int dev_fd = -1;
+static int loopback;
+static long long jitter;
+
+static struct sockaddr_in peer;
+static int have_peer;
+
+/* Receive state */
+static int have_seq;
+static unsigned short last_seq;
+static unsigned long long seen_seq;
+static int have_offset;
+static unsigned int offset;
+static unsigned int window_offset;
+static long long window_start;
+
+static struct pending_event pending[MAX_PENDING];
+static int npending;
+
+/* Send state */
+static unsigned short send_seq;
+static unsigned char bundle[MIDINET_UDP_MAX_BUNDLE_DATA];
+static int bundle_len;
+static unsigned int bundle_time;
+static unsigned char history[MIDINET_UDP_REDUNDANCY + 1]
+	[MIDINET_UDP_BUNDLE_HEADER_SIZE + MIDINET_UDP_MAX_BUNDLE_DATA];
+static int history_len[MIDINET_UDP_REDUNDANCY + 1];
+static int nhistory;
+static long long resend_time;
+static int resend_count = MIDINET_UDP_RESEND_COUNT;
+
+/* Statistics */
+static unsigned long stat_received, stat_recovered, stat_duplicate;
+static long stat_lost;
+static unsigned long stat_late, stat_overflow;
+
+static long long now_usec( void ) {
+	struct timeval tv;
+
+	gettimeofday( &tv, NULL );
+	return (long long) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void print_statistics( void ) {
+	fprintf( stderr,
+		"midinetd: %lu bundles received, %lu recovered, %lu duplicate, "
+		"%ld lost, %lu events late, %lu dropped\n",
+		stat_received, stat_recovered, stat_duplicate,
+		stat_lost, stat_late, stat_overflow );
+}
+
+static void reset_receive( void ) {
+	have_seq = 0;
+	have_offset = 0;
+	npending = 0;
+	stat_received = stat_recovered = stat_duplicate = 0;
+	stat_lost = 0;
+	stat_late = stat_overflow = 0;
+}
+
+static void send_packet( int type ) {
+	unsigned char packet[MIDINET_UDP_MAX_PACKET];
+	int count = 0, len = 0, i;
+
+	if (!have_peer) return;
+
+	packet[0] = MIDINET_UDP_MAGIC0;
+	packet[1] = MIDINET_UDP_MAGIC1;
+	packet[2] = MIDINET_UDP_VERSION;
+	packet[3] = type;
+	MIDINET_PUT32( packet + 4, (unsigned int) now_usec() );
+	if (type == MIDINET_UDP_BUNDLES) {
+		/* Oldest bundle first */
+		for (i = 0; i < nhistory; i++) {
+			memcpy( packet + MIDINET_UDP_HEADER_SIZE + len, history[i], history_len[i] );
+			len += history_len[i];
+			count++;
+		}
+	}
+	packet[8] = count;
+	packet[9] = 0;
+
+	if (sendto( udp_sd, packet, MIDINET_UDP_HEADER_SIZE + len, 0,
+		(struct sockaddr *) &peer, sizeof(peer) ) < 0) {
+		if (errno != EAGAIN && errno != ECONNREFUSED) printerror("sendto");
+	}
+}
+
+/* Close the bundle under construction and send it with its predecessors */
+static void flush_bundle( void ) {
+	unsigned char *p;
+	int i;
+
+	if (!bundle_len) return;
+
+	if (nhistory == MIDINET_UDP_REDUNDANCY + 1) {
+		for (i = 1; i < nhistory; i++) {
+			memcpy( history[i - 1], history[i], history_len[i] );
+			history_len[i - 1] = history_len[i];
+		}
+		nhistory--;
+	}
+	p = history[nhistory];
+	MIDINET_PUT16( p, send_seq );
+	MIDINET_PUT32( p + 2, bundle_time );
+	MIDINET_PUT16( p + 6, bundle_len );
+	memcpy( p + MIDINET_UDP_BUNDLE_HEADER_SIZE, bundle, bundle_len );
+	history_len[nhistory++] = MIDINET_UDP_BUNDLE_HEADER_SIZE + bundle_len;
+	send_seq++;
+	bundle_len = 0;
+
+	send_packet( MIDINET_UDP_BUNDLES );
+	resend_time = now_usec() + MIDINET_UDP_RESEND_INTERVAL;
+	resend_count = 0;
+}
+
+/* Repeat the last packet while nothing new is sent, the receiver drops	*/
+/* the bundles it already has.						*/
+static void resend_bundles( long long now ) {
+	if (resend_count >= MIDINET_UDP_RESEND_COUNT || now < resend_time) return;
+
+	send_packet( MIDINET_UDP_BUNDLES );
+	resend_time = now + MIDINET_UDP_RESEND_INTERVAL;
+	resend_count++;
+}
+
+/* Add MIDI bytes received at the passed time to the outgoing bundle */
+static void add_event( long long when, unsigned char *data, int len ) {
+	unsigned int t = (unsigned int) when;
+	unsigned int delay;
+	int n;
+
+	while (len > 0) {
+		n = len > 255 ? 255 : len;
+		delay = t - bundle_time;
+		if (bundle_len && (delay > MIDINET_UDP_MAX_DELAY ||
+			bundle_len + MIDINET_UDP_EVENT_HEADER_SIZE + n > MIDINET_UDP_MAX_BUNDLE_DATA)) {
+			flush_bundle();
+		}
+		if (!bundle_len) {
+			bundle_time = t;
+			delay = 0;
+		}
+		MIDINET_PUT16( bundle + bundle_len, delay );
+		bundle[bundle_len + 2] = n;
+		memcpy( bundle + bundle_len + MIDINET_UDP_EVENT_HEADER_SIZE, data, n );
+		bundle_len += MIDINET_UDP_EVENT_HEADER_SIZE + n;
+		data += n;
+		len -= n;
+	}
+}
+
+/* Track the smallest transit time, which follows the sender clock */
+static void update_offset( long long arrival, unsigned int send_time ) {
+	unsigned int candidate = (unsigned int) arrival - send_time;
+
+	if (!have_offset) {
+		have_offset = 1;
+		offset = window_offset = candidate;
+		window_start = arrival;
+		return;
+	}
+	if ((int) (candidate - offset) < 0) offset = candidate;
+	if ((int) (candidate - window_offset) < 0) window_offset = candidate;
+	if (arrival - window_start >= OFFSET_WINDOW) {
+		/* Let the offset rise again when the clocks drift apart */
+		offset = window_offset;
+		window_offset = candidate;
+		window_start = arrival;
+	}
+}
+
+/* Returns 1 if the bundle has not been received before */
+static int accept_seq( unsigned short seq, int primary ) {
+	int diff;
+
+	if (!have_seq) {
+		have_seq = 1;
+		last_seq = seq;
+		seen_seq = 1;
+		stat_received++;
+		return 1;
+	}
+
+	diff = (short) (seq - last_seq);
+	if (diff > 0) {
+		seen_seq = diff >= 64 ? 0 : seen_seq << diff;
+		seen_seq |= 1;
+		stat_lost += diff - 1;
+		last_seq = seq;
+		stat_received++;
+		if (!primary) stat_recovered++;
+		return 1;
+	}
+
+	diff = -diff;
+	if (diff >= 64 || (seen_seq >> diff) & 1) {
+		stat_duplicate++;
+		return 0;
+	}
+	seen_seq |= 1ULL << diff;
+	stat_lost--;
+	stat_received++;
+	stat_recovered++;
+	return 1;
+}
+
+static void queue_event( long long due, unsigned char *data, int len ) {
+	int i;
+
+	if (npending == MAX_PENDING) {
+		stat_overflow++;
+		return;
+	}
+
+	/* Keep the buffer sorted, events mostly arrive in order */
+	for (i = npending; i > 0 && pending[i - 1].due > due; i--) {
+		pending[i] = pending[i - 1];
+	}
+	pending[i].due = due;
+	pending[i].len = len;
+	memcpy( pending[i].data, data, len );
+	npending++;
+}
+
+static void queue_bundle( long long arrival, unsigned char *p, int len ) {
+	unsigned int time = MIDINET_GET32( p + 2 );
+	unsigned int due;
+	int pos = 0, n;
+
+	p += MIDINET_UDP_BUNDLE_HEADER_SIZE;
+	while (pos + MIDINET_UDP_EVENT_HEADER_SIZE <= len) {
+		n = p[pos + 2];
+		if (pos + MIDINET_UDP_EVENT_HEADER_SIZE + n > len) break;
+
+		/* Sender time to local time, delayed by the jitter allowance */
+		due = time + MIDINET_GET16( p + pos ) + offset + (unsigned int) jitter;
+		due -= (unsigned int) arrival;
+		if ((int) due < 0) stat_late++;
+		queue_event( arrival + (int) due, p + pos + MIDINET_UDP_EVENT_HEADER_SIZE, n );
+		pos += MIDINET_UDP_EVENT_HEADER_SIZE + n;
+	}
+}
+
+static int is_peer( struct sockaddr_in *from ) {
+	return have_peer &&
+		from->sin_addr.s_addr == peer.sin_addr.s_addr &&
+		from->sin_port == peer.sin_port;
+}
+
+static void handle_packet( struct sockaddr_in *from, unsigned char *p, int len ) {
+	long long arrival = now_usec();
+	int count, pos, i, n;
+
+	if (len < MIDINET_UDP_HEADER_SIZE ||
+		p[0] != MIDINET_UDP_MAGIC0 || p[1] != MIDINET_UDP_MAGIC1 ||
+		p[2] != MIDINET_UDP_VERSION) {
+		return;
+	}
+
+	switch (p[3]) {
+	case MIDINET_UDP_HELLO:
+		if (have_peer) print_statistics();
+		peer = *from;
+		have_peer = 1;
+		reset_receive();
+
+		/* The bundles sent to the last peer are not repeated */
+		nhistory = 0;
+		resend_count = MIDINET_UDP_RESEND_COUNT;
+		fprintf( stderr, "midinetd: hello from %s:%d\n",
+			inet_ntoa( from->sin_addr ), ntohs( from->sin_port ) );
+		send_packet( MIDINET_UDP_HELLO );
+		return;
+
+	case MIDINET_UDP_BYE:
+		if (!is_peer( from )) return;
+		print_statistics();
+		have_peer = 0;
+		return;
+
+	case MIDINET_UDP_BUNDLES:
+		break;
+
+	default:
+		return;
+	}
+
+	if (!have_peer) {
+		peer = *from;
+		have_peer = 1;
+	}
+	else if (!is_peer( from )) {
+		/* Only the peer that said hello last may play */
+		return;
+	}
+
+	update_offset( arrival, MIDINET_GET32( p + 4 ) );
+	count = p[8];
+	pos = MIDINET_UDP_HEADER_SIZE;
+	for (i = 0; i < count; i++) {
+		if (pos + MIDINET_UDP_BUNDLE_HEADER_SIZE > len) break;
+		n = MIDINET_GET16( p + pos + 6 );
+		if (pos + MIDINET_UDP_BUNDLE_HEADER_SIZE + n > len) break;
+		if (accept_seq( MIDINET_GET16( p + pos ), i == count - 1 )) {
+			queue_bundle( arrival, p + pos, n );
+		}
+		pos += MIDINET_UDP_BUNDLE_HEADER_SIZE + n;
+	}
+}
+
+/* Write the events that are due, in loopback mode echo them instead */
+static void play_due( long long now ) {
+	int i, j, k;
+
+	for (i = 0; i < npending && pending[i].due <= now; i++) {
+		if (loopback) {
+			add_event( now, pending[i].data, pending[i].len );
+			continue;
+		}
+		for (j = 0; j < pending[i].len; j += k) {
+			k = write( dev_fd, pending[i].data + j, pending[i].len - j );
+			if (k < 0) {
+				if (errno != EAGAIN) printerror("write midi device");
+				break;
+			}
+		}
+	}
+	if (i > 0) {
+		memmove( pending, pending + i, (npending - i) * sizeof(pending[0]) );
+		npending -= i;
+	}
+}
+
+int udp_server( int port, char *device, int jitter_ms, int loop ) {
+	struct sockaddr_in addr, from;
+	socklen_t fromlen;
+	unsigned char packet[MIDINET_UDP_MAX_PACKET];
+	unsigned char buf[256];
+	struct timeval tv, *tvp;
+	fd_set fds;
+	long long now, wait;
+	int n, maxfd;
+
+	loopback = loop;
+	jitter = (long long) jitter_ms * 1000;
+
+	if (!loopback) {
+		dev_fd = open( device, O_RDWR | O_NONBLOCK );
+		if (dev_fd < 0) {
+			printerror("Open file failed");
+			return -1;
+		}
+	}
+
+	udp_sd = socket( PF_INET, SOCK_DGRAM, 0 );
+	if (udp_sd < 0) {
+		printerror("socket");
+		return -1;
+	}
+	memset( (char *) &addr, 0, sizeof addr );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons( port );
+	if (bind( udp_sd, (struct sockaddr *) &addr, sizeof(addr) ) < 0) {
+		printerror("bind");
+		close( udp_sd );
+		return -1;
+	}
+	fcntl( udp_sd, F_SETFL, O_NONBLOCK );
+
+	fprintf( stderr, "midinetd: udp port %d, %s, jitter %d ms\n",
+		port, loopback ? "loopback" : device, jitter_ms );
+
+	for (;;) {
+		now = now_usec();
+		play_due( now );
+		flush_bundle();
+		resend_bundles( now );
+
+		tvp = NULL;
+		if (npending || resend_count < MIDINET_UDP_RESEND_COUNT) {
+			wait = npending ? pending[0].due : resend_time;
+			if (resend_count < MIDINET_UDP_RESEND_COUNT && resend_time < wait) {
+				wait = resend_time;
+			}
+			wait -= now;
+			if (wait < 0) wait = 0;
+			tv.tv_sec = wait / 1000000;
+			tv.tv_usec = wait % 1000000;
+			tvp = &tv;
+		}
+
+		FD_ZERO( &fds );
+		FD_SET( udp_sd, &fds );
+		maxfd = udp_sd;
+		if (dev_fd >= 0) {
+			FD_SET( dev_fd, &fds );
+			if (dev_fd > maxfd) maxfd = dev_fd;
+		}
+		if (select( maxfd + 1, &fds, NULL, NULL, tvp ) < 0) {
+			if (errno == EINTR) continue;
+			printerror("select");
+			break;
+		}
+
+		if (FD_ISSET( udp_sd, &fds )) {
+			for (;;) {
+				fromlen = sizeof(from);
+				n = recvfrom( udp_sd, packet, sizeof(packet), 0,
+					(struct sockaddr *) &from, &fromlen );
+				if (n < 0) break;
+				handle_packet( &from, packet, n );
+			}
+		}
+
+		if (dev_fd >= 0 && FD_ISSET( dev_fd, &fds )) {
+			n = read( dev_fd, buf, sizeof(buf) );
+			if (n > 0) add_event( now_usec(), buf, n );
+		}
+	}
+
+	close( udp_sd );
+	if (dev_fd >= 0) close( dev_fd );
+	return -1;
+}
@@ -0,0 +1,255 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "ActiveNotes.h"
+
+#include "Events.h"
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the active notes class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZActiveNotes::JZDeviceNotes::JZDeviceNotes()
+{
+  for (int Index = 0; Index < eKeyCount; ++Index)
+  {
+    mKeys[Index].mClock = INT_MIN;
+    mKeys[Index].mIsOn = false;
+    mKeys[Index].mIsUsed = false;
+  }
+  for (int Channel = 0; Channel < 16; ++Channel)
+  {
+    mPedals[Channel] = 0;
+    mIsBent[Channel] = false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZActiveNotes::JZActiveNotes()
+  : mDevices(),
+    mUsedKeys()
+{
+  mUsedKeys.reserve(256);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZActiveNotes::Clear()
+{
+  for (
+    vector<int>::const_iterator iKey = mUsedKeys.begin();
+    iKey != mUsedKeys.end();
+    ++iKey)
+  {
+    JZKeyState& KeyState = mDevices[*iKey / eKeyCount].mKeys[*iKey % eKeyCount];
+    KeyState.mIsOn = false;
+    KeyState.mIsUsed = false;
+  }
+  mUsedKeys.clear();
+
+  for (
+    vector<JZDeviceNotes>::iterator iDevice = mDevices.begin();
+    iDevice != mDevices.end();
+    ++iDevice)
+  {
+    for (int Channel = 0; Channel < 16; ++Channel)
+    {
+      iDevice->mPedals[Channel] = 0;
+      iDevice->mIsBent[Channel] = false;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZActiveNotes::Update(int Device, JZEvent* pEvent, int Clock)
+{
+  JZChannelEvent* pChannelEvent = pEvent->IsChannelEvent();
+  if (!pChannelEvent)
+  {
+    return;
+  }
+
+  if (Device < 0)
+  {
+    Device = 0;
+  }
+  int Channel = pChannelEvent->GetChannel() & 0x0f;
+
+  switch (pEvent->GetStat())
+  {
+    case StatKeyOn:
+      {
+        JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
+        SetKey(
+          Device,
+          Channel,
+          pKeyOn->GetKey(),
+          pKeyOn->GetVelocity() > 0,
+          Clock);
+      }
+      break;
+
+    case StatKeyOff:
+      SetKey(Device, Channel, pEvent->IsKeyOff()->GetKey(), false, Clock);
+      break;
+
+    case StatControl:
+      {
+        JZControlEvent* pControl = pEvent->IsControl();
+        unsigned char Pedal = 0;
+        switch (pControl->GetControl())
+        {
+          case 0x40:
+            Pedal = eSustain;
+            break;
+          case 0x42:
+            Pedal = eSostenuto;
+            break;
+          case 0x79:
+            if (static_cast<unsigned>(Device) < mDevices.size())
+            {
+              mDevices[Device].mPedals[Channel] = 0;
+              mDevices[Device].mIsBent[Channel] = false;
+            }
+            return;
+          default:
+            return;
+        }
+
+        if (static_cast<unsigned>(Device) >= mDevices.size())
+        {
+          mDevices.resize(Device + 1);
+        }
+        if (pControl->GetControlValue() >= 64)
+        {
+          mDevices[Device].mPedals[Channel] |= Pedal;
+        }
+        else
+        {
+          mDevices[Device].mPedals[Channel] &= ~Pedal;
+        }
+      }
+      break;
+
+    case StatPitch:
+      if (static_cast<unsigned>(Device) >= mDevices.size())
+      {
+        mDevices.resize(Device + 1);
+      }
+      mDevices[Device].mIsBent[Channel] = pEvent->GetValue() != 0;
+      break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   A pedal or pitch bend that was queued but dropped is reset anyway, which
+// does no harm.
+//-----------------------------------------------------------------------------
+void JZActiveNotes::Release(int Clock, vector<JZEvent*>& Events)
+{
+  for (
+    vector<int>::const_iterator iKey = mUsedKeys.begin();
+    iKey != mUsedKeys.end();
+    ++iKey)
+  {
+    const JZKeyState& KeyState =
+      mDevices[*iKey / eKeyCount].mKeys[*iKey % eKeyCount];
+    if (KeyState.mIsOn || KeyState.mClock > Clock)
+    {
+      JZEvent* pKeyOff =
+        new JZKeyOffEvent(0, (*iKey % eKeyCount) / 128, *iKey % 128);
+      pKeyOff->SetDevice(*iKey / eKeyCount);
+      Events.push_back(pKeyOff);
+    }
+  }
+
+  for (
+    vector<JZDeviceNotes>::size_type Device = 0;
+    Device < mDevices.size();
+    ++Device)
+  {
+    const JZDeviceNotes& DeviceNotes = mDevices[Device];
+    for (int Channel = 0; Channel < 16; ++Channel)
+    {
+      if (DeviceNotes.mPedals[Channel] & eSustain)
+      {
+        JZEvent* pSustain = new JZControlEvent(0, Channel, 0x40, 0);
+        pSustain->SetDevice(Device);
+        Events.push_back(pSustain);
+      }
+      if (DeviceNotes.mPedals[Channel] & eSostenuto)
+      {
+        JZEvent* pSostenuto = new JZControlEvent(0, Channel, 0x42, 0);
+        pSostenuto->SetDevice(Device);
+        Events.push_back(pSostenuto);
+      }
+      if (DeviceNotes.mIsBent[Channel])
+      {
+        JZEvent* pPitch = new JZPitchEvent(0, Channel, 0);
+        pPitch->SetDevice(Device);
+        Events.push_back(pPitch);
+      }
+    }
+  }
+
+  Clear();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZActiveNotes::SetKey(
+  int Device,
+  int Channel,
+  int Key,
+  bool IsOn,
+  int Clock)
+{
+  if (static_cast<unsigned>(Device) >= mDevices.size())
+  {
+    if (!IsOn)
+    {
+      return;
+    }
+    mDevices.resize(Device + 1);
+  }
+
+  int Index = Channel * 128 + (Key & 0x7f);
+  JZKeyState& KeyState = mDevices[Device].mKeys[Index];
+  if (!KeyState.mIsUsed)
+  {
+    if (!IsOn)
+    {
+      return;
+    }
+    KeyState.mIsUsed = true;
+    mUsedKeys.push_back(Device * eKeyCount + Index);
+  }
+  KeyState.mIsOn = IsOn;
+  KeyState.mClock = Clock;
+}
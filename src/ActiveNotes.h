@@ -0,0 +1,110 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <climits>
+#include <vector>
+
+class JZEvent;
+
+//*****************************************************************************
+// Description:
+//   This is the active notes class declaration.  It follows the notes, the
+// sustain and sostenuto pedals and the pitch bend of every channel of every
+// output device, so stopping playback can send exactly the messages that
+// end what is still sounding instead of resetting all channels of all
+// devices.
+//
+//   Events sent ahead of time are passed with their clock.  A note counts
+// as ended only if the last event sent for its key is a note off that was
+// due when playback stopped, so events that were queued but dropped at stop
+// at worst cause a superfluous note off, never a hanging note.
+//*****************************************************************************
+class JZActiveNotes
+{
+  public:
+
+    JZActiveNotes();
+
+    void Clear();
+
+    // Record an event sent to the passed device that is played at the
+    // passed clock.
+    void Update(int Device, JZEvent* pEvent, int Clock);
+
+    // Same as above for an event that is played immediately.
+    void Update(int Device, JZEvent* pEvent);
+
+    // Create the events that end everything still sounding at the passed
+    // clock and forget all notes.  The caller deletes the events.
+    void Release(int Clock, std::vector<JZEvent*>& Events);
+
+  private:
+
+    enum
+    {
+      eKeyCount = 16 * 128,
+      eSustain = 0x01,
+      eSostenuto = 0x02
+    };
+
+    struct JZKeyState
+    {
+      int mClock;
+      bool mIsOn;
+      bool mIsUsed;
+    };
+
+    struct JZDeviceNotes
+    {
+      JZDeviceNotes();
+
+      JZKeyState mKeys[eKeyCount];
+
+      // The pedals held down on every channel.
+      unsigned char mPedals[16];
+
+      bool mIsBent[16];
+    };
+
+    void SetKey(int Device, int Channel, int Key, bool IsOn, int Clock);
+
+  private:
+
+    std::vector<JZDeviceNotes> mDevices;
+
+    // The keys with a state, as device * eKeyCount + channel * 128 + key.
+    std::vector<int> mUsedKeys;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the active notes class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZActiveNotes::Update(int Device, JZEvent* pEvent)
+{
+  Update(Device, pEvent, INT_MIN);
+}
@@ -37,8 +37,16 @@
 #include "Globals.h"
 
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -132,6 +140,10 @@ JZAlsaAudioPlayer::JZAlsaAudioPlayer(JZSong* pSong)
   mCanDuplex    = 0;    // no duplex yet.
   pcm[PLAYBACK] = NULL;
   pcm[CAPTURE] = NULL;
+  cur_scount = 0;
+  mIsRendering = false;
+  mRequests = 0;
+  mWakeFds[0] = mWakeFds[1] = -1;
 
   mDeviceNames[PLAYBACK] = gpConfig->GetStrValue(C_AlsaAudioOutputDevice);
   mDeviceNames[CAPTURE] = gpConfig->GetStrValue(C_AlsaAudioInputDevice);
@@ -145,6 +157,7 @@ JZAlsaAudioPlayer::JZAlsaAudioPlayer(JZSong* pSong)
 
 JZAlsaAudioPlayer::~JZAlsaAudioPlayer()
 {
+  StopRenderThread();
   delete mpListener;
   delete mpAudioBuffer;
   if (pcm[PLAYBACK])
@@ -222,12 +235,20 @@ void JZAlsaAudioPlayer::StartPlay(int clock, int loopClock, int cont)
   {
     WriteSamples();
   }
+  StartRenderThread();
   compose_echo(clock, 1); // trigger echo
 }
 
 
 void JZAlsaAudioPlayer::StartAudio()
 {
+  if (mRenderThread.joinable())
+  {
+    mRequests.fetch_or(eStartRequest);
+    WakeRenderThread();
+    return;
+  }
+
   if (pcm[PLAYBACK])
   {
     snd_pcm_start(pcm[PLAYBACK]);
@@ -343,6 +364,9 @@ void JZAlsaAudioPlayer::OpenDsp(int mode, int sync_mode)
   {
     snd_pcm_sw_params_set_start_threshold(pcm[mode], sw, 1);
   }
+
+  // Wake the render thread once per period.
+  snd_pcm_sw_params_set_avail_min(pcm[mode], sw, period_size);
   if (snd_pcm_sw_params(pcm[mode], sw) < 0)
   {
     perror("snd_pcm_sw_params");
@@ -409,19 +433,23 @@ void JZAlsaAudioPlayer::Notify()
 {
   if (mAudioEnabled)
   {
-    if (pcm[PLAYBACK])
+    // Without a render thread the device is served from here.
+    if (!mRenderThread.joinable())
     {
-      WriteSamples();
+      if (pcm[PLAYBACK])
+      {
+        WriteSamples();
 
-      // The code may hang here when swapping in pages.
-      mSamples.FillBuffers(mOutClock);
+        // The code may hang here when swapping in pages.
+        mSamples.FillBuffers(mOutClock);
 
-      WriteSamples();
-    }
+        WriteSamples();
+      }
 
-    if (pcm[CAPTURE])
-    {
-      ReadSamples();
+      if (pcm[CAPTURE])
+      {
+        ReadSamples();
+      }
     }
 
     if (pcm[PLAYBACK] && mSamples.GetSoftSync())
@@ -430,6 +458,170 @@ void JZAlsaAudioPlayer::Notify()
     }
   }
   JZAlsaPlayer::Notify();
+
+  // Pass the audio notes prepared by the base class to the render thread.
+  if (mRenderThread.joinable())
+  {
+    mSamples.QueueNotes(mOutClock);
+    WakeRenderThread();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Without a render thread the player falls back to serving the device
+// from Notify().
+//-----------------------------------------------------------------------------
+void JZAlsaAudioPlayer::StartRenderThread()
+{
+  if (running_mode == 0 || mRenderThread.joinable())
+  {
+    return;
+  }
+
+  if (pipe(mWakeFds) < 0)
+  {
+    perror("pipe");
+    mWakeFds[0] = mWakeFds[1] = -1;
+    return;
+  }
+  fcntl(mWakeFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(mWakeFds[1], F_SETFL, O_NONBLOCK);
+
+  mRequests = 0;
+  mIsRendering = true;
+  mRenderThread = std::thread(&JZAlsaAudioPlayer::RenderLoop, this);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaAudioPlayer::StopRenderThread()
+{
+  if (!mRenderThread.joinable())
+  {
+    return;
+  }
+
+  mIsRendering = false;
+  WakeRenderThread();
+  mRenderThread.join();
+
+  close(mWakeFds[0]);
+  close(mWakeFds[1]);
+  mWakeFds[0] = mWakeFds[1] = -1;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   A full pipe already wakes the thread, so a failed write is ignored.
+//-----------------------------------------------------------------------------
+void JZAlsaAudioPlayer::WakeRenderThread()
+{
+  char Byte = 0;
+  if (::write(mWakeFds[1], &Byte, 1) < 0 && errno != EAGAIN)
+  {
+    perror("write");
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Failing to get a real time priority is not fatal, the thread just risks
+// more underruns.
+//-----------------------------------------------------------------------------
+void JZAlsaAudioPlayer::SetRenderThreadPriority()
+{
+  int Priority = gpConfig->GetValue(C_AudioPriority);
+  if (Priority <= 0)
+  {
+    return;
+  }
+
+  sched_param Parameters;
+  memset(&Parameters, 0, sizeof(Parameters));
+  Parameters.sched_priority = Priority;
+  int Error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &Parameters);
+  if (Error != 0)
+  {
+    fprintf(
+      stderr,
+      "Jazz++ Audio: unable to set SCHED_FIFO priority %d: %s\n",
+      Priority,
+      strerror(Error));
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The thread also starts and drops the device on behalf of the user
+// interface thread, because an ALSA PCM handle must not be used by two
+// threads at once.
+//-----------------------------------------------------------------------------
+void JZAlsaAudioPlayer::RenderLoop()
+{
+  SetRenderThreadPriority();
+
+  snd_pcm_t* pWaitPcm = pcm[PLAYBACK] ? pcm[PLAYBACK] : pcm[CAPTURE];
+  int Count = snd_pcm_poll_descriptors_count(pWaitPcm);
+  vector<pollfd> Fds(Count + 1);
+  Fds[0].fd = mWakeFds[0];
+  Fds[0].events = POLLIN;
+  Fds[0].revents = 0;
+  snd_pcm_poll_descriptors(pWaitPcm, &Fds[1], Count);
+
+  bool IsStarved = false;
+  while (mIsRendering)
+  {
+    // Wait for a period of room in the device, or only for Notify() when
+    // everything up to the queued clock is rendered and written.
+    if (poll(&Fds[0], IsStarved ? 1 : Fds.size(), 100) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("poll");
+      break;
+    }
+
+    if (Fds[0].revents)
+    {
+      char Buffer[64];
+      while (::read(mWakeFds[0], Buffer, sizeof(Buffer)) > 0)
+      {
+      }
+    }
+
+    int Requests = mRequests.exchange(0);
+    if (Requests & eStartRequest)
+    {
+      if (pcm[PLAYBACK])
+      {
+        snd_pcm_start(pcm[PLAYBACK]);
+      }
+      if (pcm[CAPTURE])
+      {
+        snd_pcm_start(pcm[CAPTURE]);
+      }
+    }
+    if ((Requests & eDropRequest) && pcm[PLAYBACK])
+    {
+      snd_pcm_drop(pcm[PLAYBACK]);
+    }
+
+    IsStarved = false;
+    if (pcm[PLAYBACK])
+    {
+      WriteSamples();
+      int Rendered = mSamples.RenderBuffers();
+      WriteSamples();
+      IsStarved = Rendered == 0 && mSamples.GetFullBuffers().Empty();
+    }
+    if (pcm[CAPTURE])
+    {
+      ReadSamples();
+    }
+  }
 }
 
 // number of frames (or bytes) free
@@ -495,13 +687,14 @@ int JZAlsaAudioPlayer::WriteSamples()
 }
 
 
-void JZAlsaAudioPlayer::ReadSamples()
+int JZAlsaAudioPlayer::ReadSamples()
 {
   if (!mAudioEnabled || pcm[CAPTURE] == NULL)
   {
-    return;
+    return 0;
   }
 
+  int blocks_read = 0;
   int room = GetFreeSpace(CAPTURE);
 
   for (; room > frag_size[CAPTURE]; room -= frag_size[CAPTURE])
@@ -513,14 +706,22 @@ void JZAlsaAudioPlayer::ReadSamples()
       recbuffers.UndoRequest();
       break;
     }
+    blocks_read++;
   }
+
+  return blocks_read;
 }
 
 
 void JZAlsaAudioPlayer::ResetPlay(int clock)
 {
   JZAlsaPlayer::ResetPlay(clock);
-  if (pcm[PLAYBACK])
+  if (mRenderThread.joinable())
+  {
+    mRequests.fetch_or(eDropRequest);
+    WakeRenderThread();
+  }
+  else if (pcm[PLAYBACK])
   {
     snd_pcm_drop(pcm[PLAYBACK]);
 //    int ticks_per_minute = mpSong->GetTicksPerQuarter() * mpSong->Speed();
@@ -615,8 +816,22 @@ void JZAlsaAudioPlayer::MidiSync()
 
 void JZAlsaAudioPlayer::StopPlay()
 {
+  StopRenderThread();
   mSamples.StopPlay();
   JZAlsaPlayer::StopPlay();
+
+#ifdef DEBUG_ALSA
+  cout
+    << "JZAlsaAudioPlayer::StopPlay " << mSamples.GetStolenVoiceCount()
+    << " voices stolen, " << mSamples.GetDroppedVoiceCount()
+    << " notes dropped, "
+    << mSamples.GetStreamer().GetUnderrunCount()
+    << " streamed samples late, "
+    << mSamples.GetStreamer().GetUnavailableCount()
+    << " streams unavailable"
+    << endl;
+#endif // DEBUG_ALSA
+
   if (!mAudioEnabled)
   {
     return;
@@ -27,6 +27,9 @@
 #include "Audio.h"
 #include "AlsaPlayer.h"
 
+#include <atomic>
+#include <thread>
+
 #include <sys/time.h>
 
 class JZSample;
@@ -76,8 +79,25 @@ class JZAlsaAudioPlayer : public JZAlsaPlayer
 
   private:
 
+    // Requests handled by the render thread.
+    enum
+    {
+      eStartRequest = 1,
+      eDropRequest = 2
+    };
+
+    void StartRenderThread();
+    void StopRenderThread();
+    void WakeRenderThread();
+    void SetRenderThreadPriority();
+
+    // The render thread.  It renders and writes the audio buffers when the
+    // device has room for a period, and waits for Notify() when it has
+    // rendered everything up to the queued clock.
+    void RenderLoop();
+
     int WriteSamples();
-    void ReadSamples();
+    int ReadSamples();
     void MidiSync();
     void OpenDsp(int mode, int sync_mode);
 
@@ -95,7 +115,9 @@ class JZAlsaAudioPlayer : public JZAlsaPlayer
     int audio_clock_offset;
     int cur_pos;
     int last_scount;
-    int cur_scount;
+
+    // Written by the render thread, read by MidiSync().
+    std::atomic<int> cur_scount;
     int running_mode;
     int  midi_speed;  // start speed in bpm
     int  curr_speed;  // actual speed in bpm
@@ -112,4 +134,9 @@ class JZAlsaAudioPlayer : public JZAlsaPlayer
 
     JZAlsaAudioListener* mpListener;
     JZAudioRecordBuffer recbuffers;
+
+    std::thread mRenderThread;
+    std::atomic<bool> mIsRendering;
+    std::atomic<int> mRequests;
+    int mWakeFds[2];
 };
@@ -0,0 +1,295 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "AlsaOutputPort.h"
+
+#include "AlsaPlayer.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA output port class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaOutputPort::JZAlsaOutputPort(
+  const snd_seq_addr_t& Destination,
+  int Queue)
+  : mpHandle(0),
+    mPort(-1),
+    mPending(),
+    mGeneration(0),
+    mIsStopping(false),
+    mEventCount(0),
+    mPeakQueueSize(0),
+    mBlockedMicroseconds(0),
+    mMutex(),
+    mCondition(),
+    mHandleMutex(),
+    mWorker()
+{
+  if (snd_seq_open(&mpHandle, "hw", SND_SEQ_OPEN_OUTPUT, SND_SEQ_NONBLOCK) < 0)
+  {
+    perror("open output port sequencer");
+    mpHandle = 0;
+    return;
+  }
+  JZAlsaPlayer::set_client_info(mpHandle, "Jazz++ Midi Output");
+
+  mPort = snd_seq_create_simple_port(
+    mpHandle,
+    "Output",
+    SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+    SND_SEQ_PORT_TYPE_MIDI_GENERIC);
+  if (
+    mPort < 0 ||
+    snd_seq_set_queue_usage(mpHandle, Queue, 1) < 0 ||
+    snd_seq_connect_to(
+      mpHandle,
+      mPort,
+      Destination.client,
+      Destination.port) < 0)
+  {
+    perror("connect output port");
+    snd_seq_close(mpHandle);
+    mpHandle = 0;
+    return;
+  }
+
+  mWorker = thread(&JZAlsaOutputPort::Run, this);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaOutputPort::~JZAlsaOutputPort()
+{
+  if (mWorker.joinable())
+  {
+    {
+      lock_guard<mutex> Lock(mMutex);
+      mIsStopping = true;
+    }
+    mCondition.notify_all();
+    mWorker.join();
+  }
+  if (mpHandle)
+  {
+    snd_seq_close(mpHandle);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaOutputPort::Write(const snd_seq_event_t& Event)
+{
+  if (!IsInstalled())
+  {
+    return;
+  }
+
+  lock_guard<mutex> Lock(mMutex);
+
+  mPending.push_back(JZOutputEvent());
+  JZOutputEvent& OutputEvent = mPending.back();
+  OutputEvent.mEvent = Event;
+  if (snd_seq_ev_is_variable(&Event))
+  {
+    const unsigned char* pData =
+      static_cast<const unsigned char*>(Event.data.ext.ptr);
+    OutputEvent.mData.assign(pData, pData + Event.data.ext.len);
+  }
+
+  int QueueSize = static_cast<int>(mPending.size());
+  if (QueueSize > mPeakQueueSize)
+  {
+    mPeakQueueSize = QueueSize;
+  }
+
+  mCondition.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaOutputPort::Drop()
+{
+  {
+    lock_guard<mutex> Lock(mMutex);
+    mPending.clear();
+    ++mGeneration;
+  }
+
+  if (mpHandle)
+  {
+    lock_guard<mutex> HandleLock(mHandleMutex);
+    snd_seq_drop_output_buffer(mpHandle);
+    snd_seq_drop_output(mpHandle);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+unsigned JZAlsaOutputPort::GetEventCount() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mEventCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZAlsaOutputPort::GetPeakQueueSize() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mPeakQueueSize;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+long long JZAlsaOutputPort::GetBlockedMicroseconds() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mBlockedMicroseconds;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The worker thread takes all waiting events at once, so the player never
+// waits for it longer than it takes to swap two vectors.
+//-----------------------------------------------------------------------------
+void JZAlsaOutputPort::Run()
+{
+  vector<JZOutputEvent> Events;
+
+  unique_lock<mutex> Lock(mMutex);
+  while (!mIsStopping)
+  {
+    if (mPending.empty())
+    {
+      mCondition.wait(Lock);
+      continue;
+    }
+
+    Events.swap(mPending);
+    unsigned Generation = mGeneration;
+    Lock.unlock();
+
+    unsigned Count = 0;
+    for (
+      vector<JZOutputEvent>::iterator iEvent = Events.begin();
+      iEvent != Events.end() && Output(*iEvent, Generation);
+      ++iEvent)
+    {
+      ++Count;
+    }
+    Drain(Generation);
+    Events.clear();
+
+    Lock.lock();
+    mEventCount += Count;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZAlsaOutputPort::Output(JZOutputEvent& OutputEvent, unsigned Generation)
+{
+  snd_seq_event_t& Event = OutputEvent.mEvent;
+  snd_seq_ev_set_source(&Event, mPort);
+  if (!OutputEvent.mData.empty())
+  {
+    snd_seq_ev_set_variable(
+      &Event,
+      OutputEvent.mData.size(),
+      &OutputEvent.mData[0]);
+  }
+
+  while (true)
+  {
+    {
+      lock_guard<mutex> HandleLock(mHandleMutex);
+      if (mGeneration != Generation)
+      {
+        return false;
+      }
+      int Result = snd_seq_event_output(mpHandle, &Event);
+      if (Result >= 0)
+      {
+        return true;
+      }
+      if (Result != -EAGAIN)
+      {
+        // Skip the event, like the player does.
+        snd_seq_extract_output(mpHandle, NULL);
+        return true;
+      }
+    }
+    if (!WaitForPool())
+    {
+      return false;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZAlsaOutputPort::Drain(unsigned Generation)
+{
+  while (true)
+  {
+    {
+      lock_guard<mutex> HandleLock(mHandleMutex);
+      if (mGeneration != Generation)
+      {
+        return false;
+      }
+      int Result = snd_seq_drain_output(mpHandle);
+      if (Result == 0 || (Result < 0 && Result != -EAGAIN))
+      {
+        return true;
+      }
+    }
+    if (!WaitForPool())
+    {
+      return false;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The kernel pool of the client is full.  Wait a millisecond for the
+// device to take some events, unless the thread is stopping.
+//-----------------------------------------------------------------------------
+bool JZAlsaOutputPort::WaitForPool()
+{
+  chrono::steady_clock::time_point Start = chrono::steady_clock::now();
+
+  unique_lock<mutex> Lock(mMutex);
+  mCondition.wait_for(Lock, chrono::milliseconds(1));
+  mBlockedMicroseconds += chrono::duration_cast<chrono::microseconds>(
+    chrono::steady_clock::now() - Start).count();
+  return !mIsStopping;
+}
@@ -0,0 +1,133 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <alsa/asoundlib.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA output port class declaration.  It sends the events
+// for one output device through a sequencer client and worker thread of
+// its own.  The events are scheduled on the queue of the player, so all
+// devices share one clock, but each device has its own kernel pool: when a
+// slow or stalled device fills it, only the worker thread of that device
+// waits.
+//*****************************************************************************
+class JZAlsaOutputPort
+{
+  public:
+
+    JZAlsaOutputPort(const snd_seq_addr_t& Destination, int Queue);
+
+    ~JZAlsaOutputPort();
+
+    bool IsInstalled() const;
+
+    // Queue an event for the worker thread.  The data of a variable length
+    // event is copied.  Does nothing if the port is not installed.
+    void Write(const snd_seq_event_t& Event);
+
+    // Drop the events that were not delivered yet, queued here or in the
+    // kernel.
+    void Drop();
+
+    // The number of events handed to the kernel.
+    unsigned GetEventCount() const;
+
+    // The largest number of events waiting for the worker thread.
+    int GetPeakQueueSize() const;
+
+    // The time the worker thread waited because the kernel pool was full.
+    long long GetBlockedMicroseconds() const;
+
+  private:
+
+    struct JZOutputEvent
+    {
+      snd_seq_event_t mEvent;
+      std::vector<unsigned char> mData;
+    };
+
+    void Run();
+
+    // Returns false if the events were dropped or the thread is stopping.
+    bool Output(JZOutputEvent& OutputEvent, unsigned Generation);
+
+    bool Drain(unsigned Generation);
+
+    bool WaitForPool();
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZAlsaOutputPort(const JZAlsaOutputPort&);
+    JZAlsaOutputPort& operator = (const JZAlsaOutputPort&);
+
+  private:
+
+    snd_seq_t* mpHandle;
+
+    int mPort;
+
+    // The events waiting for the worker thread.
+    std::vector<JZOutputEvent> mPending;
+
+    // Incremented by Drop(), so the worker thread discards the events it
+    // took before.
+    std::atomic<unsigned> mGeneration;
+
+    bool mIsStopping;
+
+    unsigned mEventCount;
+
+    int mPeakQueueSize;
+
+    long long mBlockedMicroseconds;
+
+    mutable std::mutex mMutex;
+
+    std::condition_variable mCondition;
+
+    // Held while the sequencer handle is used.
+    std::mutex mHandleMutex;
+
+    std::thread mWorker;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the ALSA output port class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZAlsaOutputPort::IsInstalled() const
+{
+  return mWorker.joinable();
+}
@@ -39,6 +39,7 @@
 #include "TrackWindow.h"
 
 #include <wx/choicdlg.h>
+#include <wx/stopwatch.h>
 
 #include <cerrno>
 #include <cstdlib>
@@ -50,9 +51,22 @@ using namespace std;
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 JZAlsaPlayer::JZAlsaPlayer(JZSong* pSong)
-  : JZPlayer(pSong)
+  : JZPlayer(pSong),
+    mpSyncGenerator(0),
+    mSyncDeviceIndex(-1),
+    mOutputEvents(),
+    mPeakFlushSize(0),
+    mPoolFlushSize(-1),
+    mOutputPoolSize(0),
+    mFlushCount(0),
+    mBackpressureCount(0),
+    mIsMultiPort(false),
+    mOutputPorts(),
+    mTimingPort(-1),
+    mTimingProbeClock(-1)
 {
   ithru = othru = 0;
+  mOutputEvents.reserve(1024);
 
   mInstalled = true;
   mPollMillisec = 25;
@@ -92,6 +106,7 @@ JZAlsaPlayer::JZAlsaPlayer(JZSong* pSong)
 
   // Allocate a queue.
   queue = snd_seq_alloc_named_queue(handle, "Jazz++");
+  CreateTimingPort();
 
   // Register the name of this application.
   set_client_info(handle, "The JAZZ++ Midi Sequencer");
@@ -185,14 +200,15 @@ JZAlsaPlayer::JZAlsaPlayer(JZSong* pSong)
       mOutputDeviceIndex = -1;
     }
   }
+  mIsMultiPort = gpConfig->GetValue(C_AlsaMultiPort) != 0;
+  mOutputPorts.resize(oaddr.GetCount(), nullptr);
+  CreateSysExSender();
 
   set_pool_sizes();
 
-  snd_seq_set_output_buffer_size(handle, 65536);
-
   if (mInstalled)
   {
-    thru = new JZAlsaThru();
+    thru = new JZAlsaThru(mStatistics);
     SetSoftThru(
       gpConfig->GetValue(C_SoftThru),
       gpConfig->GetValue(C_ThruInput),
@@ -208,21 +224,67 @@ void JZAlsaPlayer::clear_input_queue()
 }
 
 //-----------------------------------------------------------------------------
+// Description:
+//   Size the sequencer pools and the output buffer from the largest number
+// of events sent in one flush.  The output pool holds the events queued
+// ahead of the play position, which is about three flushes because of the
+// lookahead.  The output buffer should hold a complete flush, so it is only
+// drained once.
+//
+//   The kernel limits the pool size, so a pool that cannot be set is
+// reduced until the kernel accepts it.  The pools can only be changed while
+// nothing is queued, so this is done before playback starts.
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::set_pool_sizes()
 {
-  if (snd_seq_set_client_pool_output(handle, 2000) < 0)
+  if (mPoolFlushSize == mPeakFlushSize)
+  {
+    return;
+  }
+  mPoolFlushSize = mPeakFlushSize;
+
+  int OutputPoolSize = 3 * mPeakFlushSize;
+  if (OutputPoolSize < 2000)
+  {
+    OutputPoolSize = 2000;
+  }
+  while (
+    OutputPoolSize > mOutputPoolSize &&
+    snd_seq_set_client_pool_output(handle, OutputPoolSize) < 0)
+  {
+    OutputPoolSize = (OutputPoolSize + mOutputPoolSize) / 2;
+  }
+  if (OutputPoolSize > mOutputPoolSize)
+  {
+    mOutputPoolSize = OutputPoolSize;
+  }
+  if (mOutputPoolSize == 0)
   {
     perror("set pool output");
   }
+
   if (snd_seq_set_client_pool_input(handle, 2000) < 0)
   {
     perror("set pool input");
   }
-  if (snd_seq_set_client_pool_output_room(handle, 1000) < 0)
+  if (snd_seq_set_client_pool_output_room(handle, mOutputPoolSize / 2) < 0)
   {
     perror("set pool output room");
   }
+
+  int OutputBufferSize = 2 * mPeakFlushSize * sizeof(snd_seq_event_t);
+  if (OutputBufferSize < 65536)
+  {
+    OutputBufferSize = 65536;
+  }
+  snd_seq_set_output_buffer_size(handle, OutputBufferSize);
+
+#ifdef DEBUG_ALSA
+  cout
+    << "JZAlsaPlayer::set_pool_sizes output pool " << mOutputPoolSize
+    << ", output buffer " << OutputBufferSize
+    << endl;
+#endif // DEBUG_ALSA
 }
 
 //-----------------------------------------------------------------------------
@@ -272,6 +334,7 @@ void JZAlsaPlayer::SetSoftThru(int on, int idev, int odev)
 
     if (StartThru)
     {
+      thru->SetRealtimePriority(gpConfig->GetValue(C_ThruPriority));
       thru->Start();
     }
   }
@@ -379,6 +442,32 @@ int JZAlsaPlayer::create_port(snd_seq_t *handle, const char *name)
       SND_SEQ_PORT_TYPE_MIDI_GENERIC);
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Create the port that receives the timing probes.  The sequencer stamps
+// every event delivered to it with the real time of the queue, which tells
+// when the events scheduled with the probe actually left.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::CreateTimingPort()
+{
+  snd_seq_port_info_t* pPortInfo;
+  snd_seq_port_info_alloca(&pPortInfo);
+  snd_seq_port_info_set_name(pPortInfo, "Timing");
+  snd_seq_port_info_set_capability(
+    pPortInfo,
+    SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT);
+  snd_seq_port_info_set_type(pPortInfo, SND_SEQ_PORT_TYPE_APPLICATION);
+  snd_seq_port_info_set_timestamping(pPortInfo, 1);
+  snd_seq_port_info_set_timestamp_real(pPortInfo, 1);
+  snd_seq_port_info_set_timestamp_queue(pPortInfo, queue);
+  if (snd_seq_create_port(handle, pPortInfo) < 0)
+  {
+    perror("create timing port");
+    return;
+  }
+  mTimingPort = snd_seq_port_info_get_port(pPortInfo);
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 bool JZAlsaPlayer::IsInstalled()
@@ -390,6 +479,15 @@ bool JZAlsaPlayer::IsInstalled()
 //-----------------------------------------------------------------------------
 JZAlsaPlayer::~JZAlsaPlayer()
 {
+  delete mpSyncGenerator;
+  delete mpSysExSender;
+  for (
+    vector<JZAlsaOutputPort*>::iterator iPort = mOutputPorts.begin();
+    iPort != mOutputPorts.end();
+    ++iPort)
+  {
+    delete *iPort;
+  }
   if (thru)
   {
     delete thru;
@@ -406,114 +504,247 @@ int JZAlsaPlayer::OutEvent(JZEvent* pEvent, int now)
 {
   int rc = 0;
   snd_seq_event_t ev;
-  memset(&ev, 0, sizeof(ev));
+  if (pEvent->IsSysEx())
+  {
+    JZSysExEvent* pSysEx = pEvent->IsSysEx();
+    // prepend 0xf0
+    char* pBuffer = new char[pSysEx->GetDataLength() + 1];
+    pBuffer[0] = 0xF0;
+    memcpy(pBuffer + 1, pSysEx->GetData(), pSysEx->GetDataLength());
+    set_event_header(
+      &ev,
+      pEvent->GetClock(),
+      pSysEx->GetDataLength() + 1,
+      pBuffer);
+    SetDeviceDestination(&ev, pEvent->GetDevice(), now);
+    rc = write(&ev, now);
+    delete [] pBuffer;
+  }
+  else if (EncodeEvent(pEvent, pEvent->GetClock(), &ev))
+  {
+    SetDeviceDestination(&ev, pEvent->GetDevice(), now);
+    rc = write(&ev, now);
+  }
+  return rc < 0 ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Fill an ALSA sequencer event for the passed event, scheduled at Clock.
+// SysEx events need a data buffer and are not handled here.
+//
+// Returns:
+//   bool:
+//     false if the event has no fixed size ALSA sequencer equivalent.
+//-----------------------------------------------------------------------------
+bool JZAlsaPlayer::EncodeEvent(
+  JZEvent* pEvent,
+  int Clock,
+  snd_seq_event_t* pAlsaEvent)
+{
   switch (pEvent->GetStat())
   {
     case StatKeyOn:
       {
         JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_NOTEON);
-        ev.data.note.channel = pKeyOn->GetChannel();
-        ev.data.note.note = pKeyOn->GetKey();
-        ev.data.note.velocity = pKeyOn->GetVelocity();
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_NOTEON);
+        pAlsaEvent->data.note.channel = pKeyOn->GetChannel();
+        pAlsaEvent->data.note.note = pKeyOn->GetKey();
+        pAlsaEvent->data.note.velocity = pKeyOn->GetVelocity();
       }
-      break;
+      return true;
 
     case StatKeyOff:
       {
         JZKeyOffEvent* pKeyOff = pEvent->IsKeyOff();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_NOTEOFF);
-        ev.data.note.channel = pKeyOff->GetChannel();
-        ev.data.note.note = pKeyOff->GetKey();
-        ev.data.note.velocity = pKeyOff->GetOffVelocity();
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_NOTEOFF);
+        pAlsaEvent->data.note.channel = pKeyOff->GetChannel();
+        pAlsaEvent->data.note.note = pKeyOff->GetKey();
+        pAlsaEvent->data.note.velocity = pKeyOff->GetOffVelocity();
       }
-      break;
+      return true;
 
     case StatProgram:
       {
         JZProgramEvent* pProgram = pEvent->IsProgram();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_PGMCHANGE);
-        ev.data.control.channel = pProgram->GetChannel();
-        ev.data.control.value = pProgram->GetProgram();
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_PGMCHANGE);
+        pAlsaEvent->data.control.channel = pProgram->GetChannel();
+        pAlsaEvent->data.control.value = pProgram->GetProgram();
       }
-      break;
+      return true;
 
     case StatKeyPressure:
       {
         JZKeyPressureEvent* pKeyPressure = pEvent->IsKeyPressure();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_KEYPRESS);
-        ev.data.note.channel = pKeyPressure->GetChannel();
-        ev.data.note.note = pKeyPressure->GetKey();
-        ev.data.note.velocity = pKeyPressure->GetPressureValue();
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_KEYPRESS);
+        pAlsaEvent->data.note.channel = pKeyPressure->GetChannel();
+        pAlsaEvent->data.note.note = pKeyPressure->GetKey();
+        pAlsaEvent->data.note.velocity = pKeyPressure->GetPressureValue();
       }
-      break;
+      return true;
 
     case StatChnPressure:
       {
         JZChnPressureEvent *k = pEvent->IsChnPressure();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_CHANPRESS);
-        ev.data.control.channel = k->GetChannel();
-        ev.data.control.value = k->Value;
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_CHANPRESS);
+        pAlsaEvent->data.control.channel = k->GetChannel();
+        pAlsaEvent->data.control.value = k->Value;
       }
-      break;
+      return true;
 
     case StatControl:
       {
         JZControlEvent* k = pEvent->IsControl();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_CONTROLLER);
-        ev.data.control.channel = k->GetChannel();
-        ev.data.control.param = k->GetControl();
-        ev.data.control.value = k->GetControlValue();
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_CONTROLLER);
+        pAlsaEvent->data.control.channel = k->GetChannel();
+        pAlsaEvent->data.control.param = k->GetControl();
+        pAlsaEvent->data.control.value = k->GetControlValue();
       }
-      break;
+      return true;
 
     case StatPitch:
       {
         JZPitchEvent *k = pEvent->IsPitch();
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_PITCHBEND);
-        ev.data.control.channel = k->GetChannel();
-        ev.data.control.value = k->Value;
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_PITCHBEND);
+        pAlsaEvent->data.control.channel = k->GetChannel();
+        pAlsaEvent->data.control.value = k->Value;
       }
-      break;
+      return true;
 
     case StatSetTempo:
       {
         int bpm = pEvent->IsSetTempo()->GetBPM();
         int us  = (int)( 60.0E6 / (double)bpm );
-        set_event_header(&ev, pEvent->GetClock(), SND_SEQ_EVENT_TEMPO);
-        snd_seq_ev_set_queue_tempo(&ev, queue, us);
-        rc = write(&ev, now);
+        set_event_header(pAlsaEvent, Clock, SND_SEQ_EVENT_TEMPO);
+        snd_seq_ev_set_queue_tempo(pAlsaEvent, queue, us);
       }
+      return true;
+
+    default:
       break;
+  }
+  return false;
+}
 
-    case StatSysEx:
+//-----------------------------------------------------------------------------
+// Description:
+//   Send the play buffer records up to mOutClock.  The records are encoded
+// into mOutputEvents in one pass and then written to the sequencer output
+// buffer, which is drained once at the end.  SysEx records, which need their
+// own data buffer, are written one at a time between the batches.
+//
+//   If the sequencer pool is full (-EAGAIN), the records that were not
+// written stay in the play buffer for the next flush.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::FlushToDevice()
+{
+  if (mIsMultiPort)
+  {
+    FlushToPorts();
+    return;
+  }
+
+  int RecordCount = mPlayBuffer.GetCount();
+  int Count = 0;
+  bool BufferFull = false;
+  int FlushedCount = 0;
+
+  while (
+    !BufferFull &&
+    Count < RecordCount &&
+    mPlayBuffer.GetRecord(Count).mClock < mOutClock)
+  {
+    mOutputEvents.clear();
+    int End = Count;
+    while (
+      End < RecordCount &&
+      mPlayBuffer.GetRecord(End).mClock < mOutClock &&
+      !mPlayBuffer.GetRecord(End).mpEvent->IsSysEx())
+    {
+      const JZPlayRecord& Record = mPlayBuffer.GetRecord(End);
+      mOutputEvents.push_back(snd_seq_event_t());
+      if (!EncodeEvent(Record.mpEvent, Record.mClock, &mOutputEvents.back()))
       {
-        JZSysExEvent* pSysEx = pEvent->IsSysEx();
-        // prepend 0xf0
-        char* pBuffer = new char[pSysEx->GetDataLength() + 1];
-        pBuffer[0] = 0xF0;
-        memcpy(pBuffer + 1, pSysEx->GetData(), pSysEx->GetDataLength());
-        set_event_header(
-          &ev,
-          pEvent->GetClock(),
-          pSysEx->GetDataLength() + 1,
-          pBuffer);
-        rc = write(&ev, now);
-        delete [] pBuffer;
+        mOutputEvents.back().type = SND_SEQ_EVENT_NONE;
       }
-      break;
+      ++End;
+    }
 
-    default:
-      break;
+    // Only the records written count as sent, the others are retried.
+    int Written = WriteBatch();
+    for (int Index = Count; Index < Count + Written; ++Index)
+    {
+      const JZPlayRecord& Record = mPlayBuffer.GetRecord(Index);
+      mDeviceState.Update(Record.mDevice, Record.mpEvent);
+      mActiveNotes.Update(Record.mDevice, Record.mpEvent, Record.mClock);
+      mStatistics.AddHandOff(Record.mClock - mNotifyClock);
+      SendTimingProbe(Record.mClock);
+    }
+    Count += Written;
+    FlushedCount += Written;
+    if (Count < End)
+    {
+      BufferFull = true;
+    }
+    else if (
+      Count < RecordCount &&
+      mPlayBuffer.GetRecord(Count).mClock < mOutClock)
+    {
+      // A SysEx record.
+      if (OutRecord(mPlayBuffer.GetRecord(Count)) != 0)
+      {
+        ++mBackpressureCount;
+        BufferFull = true;
+      }
+      else
+      {
+        ++Count;
+        ++FlushedCount;
+      }
+    }
   }
-  return rc < 0 ? 1 : 0;
+
+  ++mFlushCount;
+  if (FlushedCount > mPeakFlushSize)
+  {
+    mPeakFlushSize = FlushedCount;
+  }
+
+  if (BufferFull)
+  {
+    flush_output();
+  }
+  else
+  {
+    // Drains the output buffer.
+    OutBreak();
+  }
+  mPlayBuffer.RemoveFirst(Count);
+  ReclaimPlayedEvents();
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Write the events in mOutputEvents to the sequencer output buffer.
+//
+// Returns:
+//   int:
+//     The number of events that were written, or skipped because they had
+//     no ALSA equivalent.  Less than the batch size if the pool is full.
+//-----------------------------------------------------------------------------
+int JZAlsaPlayer::WriteBatch()
+{
+  int EventCount = static_cast<int>(mOutputEvents.size());
+  for (int EventIndex = 0; EventIndex < EventCount; ++EventIndex)
+  {
+    snd_seq_event_t& AlsaEvent = mOutputEvents[EventIndex];
+    if (AlsaEvent.type != SND_SEQ_EVENT_NONE && write(&AlsaEvent) < 0)
+    {
+      ++mBackpressureCount;
+      return EventIndex;
+    }
+  }
+  return EventCount;
 }
 
 //-----------------------------------------------------------------------------
@@ -541,6 +772,84 @@ int JZAlsaPlayer::compose_echo(int clock, unsigned int arg)
   return write(&ev);
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Schedule a timing probe behind the events of a clock, once per clock.
+// The sequencer dispatches events of the same tick in the order they were
+// written, so the probe leaves right after them.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::SendTimingProbe(int Clock)
+{
+  if (mTimingPort < 0 || Clock == mTimingProbeClock)
+  {
+    return;
+  }
+  snd_seq_event_t ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.source = self;
+  snd_seq_ev_set_dest(&ev, client, mTimingPort);
+  snd_seq_ev_schedule_tick(&ev, queue, 0, Clock);
+  snd_seq_ev_set_fixed(&ev);
+  ev.type = SND_SEQ_EVENT_ECHO;
+
+  // The time stamp of the delivered probe replaces the tick.
+  ev.data.raw32.d[0] = Clock;
+  if (write(&ev) >= 0)
+  {
+    mTimingProbeClock = Clock;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Add how late a timing probe was dispatched.  The real time the probe was
+// scheduled for is worked out backwards from the current tick and real time
+// of the queue, using the current tempo.  A tempo change in the few
+// milliseconds since the dispatch is not taken into account.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::AddDispatchLateness(const snd_seq_event_t& Probe)
+{
+  snd_seq_queue_status_t* pStatus;
+  snd_seq_queue_status_alloca(&pStatus);
+  snd_seq_queue_tempo_t* pTempo;
+  snd_seq_queue_tempo_alloca(&pTempo);
+  if (
+    snd_seq_get_queue_status(handle, queue, pStatus) < 0 ||
+    snd_seq_get_queue_tempo(handle, queue, pTempo) < 0 ||
+    snd_seq_queue_tempo_get_ppq(pTempo) <= 0)
+  {
+    return;
+  }
+
+  long long TickNow = snd_seq_queue_status_get_tick_time(pStatus);
+  long long Tick = Probe.data.raw32.d[0];
+  if (Tick > TickNow)
+  {
+    // The queue was repositioned since the probe was dispatched.
+    return;
+  }
+
+  const snd_seq_real_time_t* pRealNow =
+    snd_seq_queue_status_get_real_time(pStatus);
+  long long Now =
+    pRealNow->tv_sec * 1000000LL + pRealNow->tv_nsec / 1000;
+  long long Scheduled =
+    Now -
+    (TickNow - Tick) * snd_seq_queue_tempo_get_tempo(pTempo) /
+      snd_seq_queue_tempo_get_ppq(pTempo);
+  long long Dispatched =
+    Probe.time.time.tv_sec * 1000000LL + Probe.time.time.tv_nsec / 1000;
+  if (Dispatched >= Scheduled)
+  {
+    mStatistics.AddDispatchLateness(
+      static_cast<unsigned>(Dispatched - Scheduled));
+  }
+  else
+  {
+    mStatistics.AddDispatchLateness(0);
+  }
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::OutBreak(int clock)
@@ -561,16 +870,271 @@ void JZAlsaPlayer::OutBreak(int clock)
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::StartPlay(int clock, int loopClock, int cont)
 {
+  // The queue is empty, so this is the time to grow the pools if the last
+  // playback was denser than they allowed.
+  set_pool_sizes();
+
   recd_clock = clock;
   echo_clock = clock;
   play_clock = clock;
+  mTimingProbeClock = -1;
   flush_output();
-  start_timer(clock);
+
+  // Create the output ports of the tracks now, rather than in the middle of
+  // playback.
+  if (mIsMultiPort)
+  {
+    for (int i = 0; i < mpSong->GetTrackCount(); ++i)
+    {
+      OpenOutputPort(mpSong->GetTrack(i)->GetDevice());
+    }
+  }
+
+  // The setup may take a while to go out through the SysEx sender, so the
+  // queue starts after it.
   JZPlayer::StartPlay(clock, loopClock, cont);
+  start_timer(clock);
+  StartSyncGenerator(clock, loopClock, cont);
   Notify();
 //  flush_output();
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Start sending MIDI clock and MTC as configured by C_RealTimeOut, right
+// after the queue timer was started, so both count from the same moment.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::StartSyncGenerator(int Clock, int LoopClock, int Continue)
+{
+  int Messages = gpConfig->GetValue(C_RealTimeOut);
+  if (!Messages)
+  {
+    return;
+  }
+
+  int DeviceIndex = gpConfig->GetValue(C_SyncOutputDevice);
+  if (DeviceIndex < 0)
+  {
+    DeviceIndex = mOutputDeviceIndex;
+  }
+  if (
+    DeviceIndex < 0 ||
+    static_cast<unsigned>(DeviceIndex) >= oaddr.GetCount())
+  {
+    return;
+  }
+
+  if (mpSyncGenerator && DeviceIndex != mSyncDeviceIndex)
+  {
+    delete mpSyncGenerator;
+    mpSyncGenerator = 0;
+  }
+  if (!mpSyncGenerator)
+  {
+    mpSyncGenerator = new JZAlsaSyncGenerator(
+      mStatistics,
+      oaddr[DeviceIndex],
+      queue);
+    mSyncDeviceIndex = DeviceIndex;
+  }
+  if (!mpSyncGenerator->IsInstalled())
+  {
+    return;
+  }
+
+  mpSyncGenerator->SetRealtimePriority(gpConfig->GetValue(C_SyncPriority));
+  mpSyncGenerator->Start(
+    *mpSong,
+    Clock,
+    LoopClock,
+    Continue != 0,
+    Messages);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   (Re)create the SysEx sender for the current output device.  Without
+// one, SysEx messages are sent directly like all other events.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::CreateSysExSender()
+{
+  delete mpSysExSender;
+  mpSysExSender = nullptr;
+
+  if (
+    mOutputDeviceIndex < 0 ||
+    static_cast<unsigned>(mOutputDeviceIndex) >= oaddr.GetCount())
+  {
+    return;
+  }
+
+  JZAlsaSysExSender* pSysExSender =
+    new JZAlsaSysExSender(oaddr[mOutputDeviceIndex]);
+  if (!pSysExSender->IsInstalled())
+  {
+    delete pSysExSender;
+    return;
+  }
+  if (mIsMultiPort)
+  {
+    vector<snd_seq_addr_t> Destinations;
+    for (unsigned Device = 0; Device < oaddr.GetCount(); ++Device)
+    {
+      Destinations.push_back(oaddr[Device]);
+    }
+    pSysExSender->SetDeviceDestinations(Destinations);
+  }
+  mpSysExSender = pSysExSender;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+const JZAlsaOutputPort* JZAlsaPlayer::GetOutputPort(int Device) const
+{
+  if (Device < 0 || static_cast<unsigned>(Device) >= mOutputPorts.size())
+  {
+    return nullptr;
+  }
+  return mOutputPorts[Device];
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::WriteStatistics(ostream& Os) const
+{
+  JZPlayer::WriteStatistics(Os);
+
+  for (unsigned Device = 0; Device < mOutputPorts.size(); ++Device)
+  {
+    const JZAlsaOutputPort* pPort = GetOutputPort(Device);
+    if (pPort)
+    {
+      Os
+        << "port_" << Device << "_events " << pPort->GetEventCount() << '\n'
+        << "port_" << Device << "_peak_queue " << pPort->GetPeakQueueSize()
+        << '\n'
+        << "port_" << Device << "_blocked_us "
+        << pPort->GetBlockedMicroseconds() << '\n';
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Returns null if the device does not exist or its port could not be
+// connected.
+//-----------------------------------------------------------------------------
+JZAlsaOutputPort* JZAlsaPlayer::OpenOutputPort(int Device)
+{
+  if (Device < 0 || static_cast<unsigned>(Device) >= mOutputPorts.size())
+  {
+    return nullptr;
+  }
+
+  JZAlsaOutputPort*& pPort = mOutputPorts[Device];
+  if (!pPort)
+  {
+    pPort = new JZAlsaOutputPort(oaddr[Device], queue);
+  }
+  return pPort->IsInstalled() ? pPort : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Hand the due events to the output ports of their devices.  The ports
+// queue without limit, so unlike FlushToDevice() this never stops early.
+// The events of a device without a working port are written directly.
+// Tempo changes control the shared queue, which only this client may do,
+// so they are written here.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::FlushToPorts()
+{
+  int RecordCount = mPlayBuffer.GetCount();
+  int Count = 0;
+  vector<unsigned char> SysEx;
+
+  while (
+    Count < RecordCount &&
+    mPlayBuffer.GetRecord(Count).mClock < mOutClock)
+  {
+    const JZPlayRecord& Record = mPlayBuffer.GetRecord(Count);
+    snd_seq_event_t AlsaEvent;
+    bool IsEncoded = false;
+    JZSysExEvent* pSysEx = Record.mpEvent->IsSysEx();
+    if (pSysEx)
+    {
+      SysEx.resize(pSysEx->GetDataLength() + 1);
+      SysEx[0] = 0xF0;
+      memcpy(&SysEx[1], pSysEx->GetData(), pSysEx->GetDataLength());
+      set_event_header(&AlsaEvent, Record.mClock, SysEx.size(), &SysEx[0]);
+      IsEncoded = true;
+    }
+    else
+    {
+      IsEncoded = EncodeEvent(Record.mpEvent, Record.mClock, &AlsaEvent);
+    }
+
+    if (IsEncoded)
+    {
+      if (AlsaEvent.type == SND_SEQ_EVENT_TEMPO)
+      {
+        write(&AlsaEvent);
+      }
+      else if (JZAlsaOutputPort* pPort = OpenOutputPort(Record.mDevice))
+      {
+        pPort->Write(AlsaEvent);
+      }
+      else
+      {
+        // The port could not be set up, so the player sends the event to
+        // the device itself.
+        if (
+          Record.mDevice >= 0 &&
+          static_cast<unsigned>(Record.mDevice) < oaddr.GetCount())
+        {
+          snd_seq_ev_set_dest(
+            &AlsaEvent,
+            oaddr[Record.mDevice].client,
+            oaddr[Record.mDevice].port);
+        }
+        write(&AlsaEvent);
+      }
+    }
+
+    mDeviceState.Update(Record.mDevice, Record.mpEvent);
+    mActiveNotes.Update(Record.mDevice, Record.mpEvent, Record.mClock);
+    mStatistics.AddHandOff(Record.mClock - mNotifyClock);
+    SendTimingProbe(Record.mClock);
+    ++Count;
+  }
+
+  ++mFlushCount;
+  if (Count > mPeakFlushSize)
+  {
+    mPeakFlushSize = Count;
+  }
+
+  OutBreak();
+  mPlayBuffer.RemoveFirst(Count);
+  ReclaimPlayedEvents();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::DropPortOutput()
+{
+  for (
+    vector<JZAlsaOutputPort*>::iterator iPort = mOutputPorts.begin();
+    iPort != mOutputPorts.end();
+    ++iPort)
+  {
+    if (*iPort)
+    {
+      (*iPort)->Drop();
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::ResetPlay(int clock)
@@ -578,14 +1142,12 @@ void JZAlsaPlayer::ResetPlay(int clock)
   // Purge queues.
   snd_seq_drop_output_buffer(handle);
   snd_seq_drop_output(handle);
+  DropPortOutput();
 
-  AllNotesOff();
+  // Only the notes that were sent to the devices before clock are sounding.
+  ReleaseNotes(clock);
 }
 
-#define FIRST_DELTACLOCK 720
-#define DELTACLOCK 960
-#define ADVANCE_PLAY 480
-
 //-----------------------------------------------------------------------------
 // Description:
 //   Notify is periodically called by the timer.  It will output events to the
@@ -593,6 +1155,8 @@ void JZAlsaPlayer::ResetPlay(int clock)
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::Notify()
 {
+  wxStopWatch NotifyStopWatch;
+
   // called by timer
   int Now = GetRealTimeClock();
 
@@ -604,6 +1168,8 @@ void JZAlsaPlayer::Notify()
   {
     return;
   }
+  mNotifyClock = Now;
+  MeasureNotifyGap();
 
   if (Now < play_clock)
   {
@@ -613,26 +1179,29 @@ void JZAlsaPlayer::Notify()
     cout << "JZAlsaPlayer::Notify rewind" << endl;
 #endif // DEBUG_ALSA
     ResetPlay(Now);
+    mpPlayLoop->Restart(Now);
     mPlayBuffer.Clear();
-    mOutClock = Now + FIRST_DELTACLOCK;
+    UpdateLookahead(Now);
+    mOutClock = Now + mLookaheadClock * 3 / 4;
     mpPlayLoop->PrepareOutput(&mPlayBuffer, mpSong, Now, mOutClock, 0);
     if (mpAudioBuffer)
     {
       mpAudioBuffer->Clear();
       mpPlayLoop->PrepareOutput(mpAudioBuffer, mpSong, Now, mOutClock, 1);
     }
-    mPlayBuffer.Length2Keyoff();
   }
   else
   {
     // time to put more events
-    if (Now >= (mOutClock - ADVANCE_PLAY))
+    if (Now >= mOutClock - mLookaheadClock / 2)
     {
+      UpdateLookahead(Now);
+
       mpPlayLoop->PrepareOutput(
         &mPlayBuffer,
         mpSong,
         mOutClock,
-        Now + DELTACLOCK,
+        Now + mLookaheadClock,
         0);
       if (mpAudioBuffer)
       {
@@ -640,25 +1209,30 @@ void JZAlsaPlayer::Notify()
           mpAudioBuffer,
           mpSong,
           mOutClock,
-          Now + DELTACLOCK,
+          Now + mLookaheadClock,
           1);
       }
-      mOutClock = Now + DELTACLOCK;
-      mPlayBuffer.Length2Keyoff();
+      mOutClock = Now + mLookaheadClock;
     }
   }
 
   play_clock = Now;
   if (
-    mPlayBuffer.mEventCount &&
-    mPlayBuffer.mppEvents[0]->GetClock() < mOutClock)
+    !mPlayBuffer.IsEmpty() &&
+    mPlayBuffer.GetRecord(0).mClock < mOutClock)
   {
+    if (mPlayBuffer.GetRecord(0).mClock < Now)
+    {
+      mStatistics.AddUnderrun();
+    }
     FlushToDevice();
   }
   else
   {
     OutBreak();        // does nothing unless mOutClock has changed
   }
+
+  mStatistics.AddNotifyTime(NotifyStopWatch.TimeInMicro().ToLong());
 }
 
 //-----------------------------------------------------------------------------
@@ -688,6 +1262,30 @@ void JZAlsaPlayer::set_event_header(
   snd_seq_ev_set_variable(ev, len, ptr);
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   When the tracks have output devices of their own, events sent directly
+// go to the device of the event instead of the subscribers.  Queued events
+// go through the output ports and queue control events keep their
+// destination.
+//-----------------------------------------------------------------------------
+void JZAlsaPlayer::SetDeviceDestination(
+  snd_seq_event_t* pAlsaEvent,
+  int Device,
+  int Now)
+{
+  if (
+    !mIsMultiPort ||
+    !Now ||
+    pAlsaEvent->dest.client != SND_SEQ_ADDRESS_SUBSCRIBERS ||
+    Device < 0 ||
+    static_cast<unsigned>(Device) >= oaddr.GetCount())
+  {
+    return;
+  }
+  snd_seq_ev_set_dest(pAlsaEvent, oaddr[Device].client, oaddr[Device].port);
+}
+
 //-----------------------------------------------------------------------------
 // Description:
 //   Initialize the alsa timer.
@@ -813,13 +1411,52 @@ int JZAlsaPlayer::set_blocking_mode(int enable)
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::StopPlay()
 {
+  if (mpSyncGenerator)
+  {
+    mpSyncGenerator->Stop();
+  }
+
+  // Drop the queued events before the base class releases the sounding
+  // notes, so a queued note on cannot follow its note off.
+  ResetPlay(GetRealTimeClock());
   JZPlayer::StopPlay();
-  ResetPlay(0);
   flush_output();
   stop_queue_timer();
   clear_input_queue();
   JZProjectManager::Instance()->NewPlayPosition(-1);
+  mRecordRing.MoveTo(mRecdBuffer);
   mRecdBuffer.Keyoff2Length();
+
+#ifdef DEBUG_ALSA
+  cout
+    << "JZAlsaPlayer::StopPlay " << mFlushCount << " flushes, "
+    << mPeakFlushSize << " events in the largest flush, "
+    << mBackpressureCount << " times the output pool was full, "
+    << mRecordRing.GetDroppedCount() << " recorded messages dropped"
+    << endl;
+  for (unsigned Device = 0; Device < mOutputPorts.size(); ++Device)
+  {
+    if (mOutputPorts[Device])
+    {
+      cout
+        << "JZAlsaPlayer::StopPlay device " << Device << ": "
+        << mOutputPorts[Device]->GetEventCount() << " events, "
+        << mOutputPorts[Device]->GetPeakQueueSize() << " queued at most, "
+        << mOutputPorts[Device]->GetBlockedMicroseconds()
+        << " us waiting for the kernel pool"
+        << endl;
+    }
+  }
+  if (mpSysExSender)
+  {
+    cout
+      << "JZAlsaPlayer::StopPlay " << mpSysExSender->GetSentMessageCount()
+      << " messages sent paced, "
+      << mpSysExSender->GetQueuedMessageCount() << " still queued, "
+      << mpSysExSender->GetPeakQueuedByteCount() << " bytes queued at most"
+      << endl;
+  }
+#endif // DEBUG_ALSA
 }
 
 //-----------------------------------------------------------------------------
@@ -831,12 +1468,12 @@ void JZAlsaPlayer::StartAudio()
 //-----------------------------------------------------------------------------
 // Description:
 //   Called from GetRealTimeClock.  Parses events in the queue.  Sets
-// recd_clock, from event time stamps.
+// recd_clock, from event time stamps.  Channel messages are only captured
+// into the record ring here, they are converted into events in bulk.  Timing
+// probes go to the dispatch statistics.
 //-----------------------------------------------------------------------------
 void JZAlsaPlayer::recd_event(snd_seq_event_t* ev)
 {
-  JZEvent* pEvent = 0;
-
 #ifdef DEBUG_ALSA
   cout
     << "JZAlsaPlayer::recd_event got " << (int)ev->type
@@ -844,77 +1481,87 @@ void JZAlsaPlayer::recd_event(snd_seq_event_t* ev)
     << endl;
 #endif // DEBUG_ALSA
 
+  if (ev->dest.port == mTimingPort)
+  {
+    AddDispatchLateness(*ev);
+    return;
+  }
+
+  int Clock = mpPlayLoop->Ext2IntClock(ev->time.tick);
+
   switch (ev->type)
   {
     case SND_SEQ_EVENT_NOTEON:
-      if (ev->data.note.velocity > 0)
-      {
-        pEvent = new JZKeyOnEvent(
-          0,
-          ev->data.note.channel,
-          ev->data.note.note,
-          ev->data.note.velocity);
-      }
-      else
-      {
-        pEvent = new JZKeyOffEvent(
-          0,
-          ev->data.note.channel,
-          ev->data.note.note,
-          0);
-      }
+      mRecordRing.Put(
+        Clock,
+        StatKeyOn | ev->data.note.channel,
+        ev->data.note.note,
+        ev->data.note.velocity);
       break;
 
     case SND_SEQ_EVENT_NOTEOFF:
-      pEvent = new JZKeyOffEvent(
-        0,
-        ev->data.note.channel,
+      mRecordRing.Put(
+        Clock,
+        StatKeyOff | ev->data.note.channel,
         ev->data.note.note,
         ev->data.note.velocity);
       break;
 
     case SND_SEQ_EVENT_PGMCHANGE:
-      pEvent = new JZProgramEvent(
-        0,
-        ev->data.control.channel,
-        ev->data.control.value);
+      mRecordRing.Put(
+        Clock,
+        StatProgram | ev->data.control.channel,
+        ev->data.control.value,
+        0);
       break;
 
     case SND_SEQ_EVENT_KEYPRESS:
-      pEvent = new JZKeyPressureEvent(
-        0,
-        ev->data.note.channel,
+      mRecordRing.Put(
+        Clock,
+        StatKeyPressure | ev->data.note.channel,
         ev->data.note.note,
         ev->data.note.velocity);
       break;
 
     case SND_SEQ_EVENT_CHANPRESS:
-      pEvent = new JZChnPressureEvent(
-        0,
-        ev->data.control.channel,
-        ev->data.control.value);
+      mRecordRing.Put(
+        Clock,
+        StatChnPressure | ev->data.control.channel,
+        ev->data.control.value,
+        0);
       break;
 
     case SND_SEQ_EVENT_CONTROLLER:
-      pEvent = new JZControlEvent(
-        0,
-        ev->data.control.channel,
+      mRecordRing.Put(
+        Clock,
+        StatControl | ev->data.control.channel,
         ev->data.control.param,
         ev->data.control.value);
       break;
 
     case SND_SEQ_EVENT_PITCHBEND:
-      pEvent = new JZPitchEvent(
-        0,
-        ev->data.control.channel,
-        ev->data.control.value);
+      {
+        int Value = ev->data.control.value + 8192;
+        mRecordRing.Put(
+          Clock,
+          StatPitch | ev->data.control.channel,
+          Value & 0x7f,
+          (Value >> 7) & 0x7f);
+      }
       break;
 
     case SND_SEQ_EVENT_SYSEX:
-      pEvent = new JZSysExEvent(
-        0,
-        ((unsigned char *)ev->data.ext.ptr) + 1,
-        ev->data.ext.len - 1);
+      {
+        // System exclusive messages do not fit into the ring.  Convert the
+        // captured messages first to keep the events in arrival order.
+        mRecordRing.MoveTo(mRecdBuffer);
+        JZEvent* pEvent = new JZSysExEvent(
+          0,
+          ((unsigned char *)ev->data.ext.ptr) + 1,
+          ev->data.ext.len - 1);
+        pEvent->SetClock(Clock);
+        mRecdBuffer.Put(pEvent);
+      }
       break;
 
     case SND_SEQ_EVENT_ECHO:
@@ -932,14 +1579,6 @@ void JZAlsaPlayer::recd_event(snd_seq_event_t* ev)
       break;
 
   }
-
-  if (pEvent)
-  {
-    // Not all events are to be recorded.  Only those filtered out and put
-    // into the event.
-    pEvent->SetClock(mpPlayLoop->Ext2IntClock(ev->time.tick));
-    mRecdBuffer.Put(pEvent);
-  }
 }
 
 //-----------------------------------------------------------------------------
@@ -958,6 +1597,12 @@ int JZAlsaPlayer::GetRealTimeClock()
     recd_event(ie);
     snd_seq_free_event(ie);
   }
+
+  // Convert a long recording in bulk before the ring fills up.
+  if (mRecordRing.GetCount() >= JZRecordRing::eCapacity / 2)
+  {
+    mRecordRing.MoveTo(mRecdBuffer);
+  }
   if (recd_clock != old_recd_clock)
   {
     JZProjectManager::Instance()->NewPlayPosition(
@@ -1040,6 +1685,7 @@ int JZAlsaPlayer::FindMidiDevice()
   {
     subscribe_out(mOutputDeviceIndex);
   }
+  CreateSysExSender();
   return 0;
 }
 
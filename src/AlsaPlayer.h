@@ -24,10 +24,14 @@
 
 #include "Player.h"
 #include "AlsaThru.h"
+#include "AlsaOutputPort.h"
+#include "AlsaSyncGenerator.h"
+#include "AlsaSysExSender.h"
 
 #include <alsa/asoundlib.h>
 
 #include <string>
+#include <vector>
 
 class JZAlsaDeviceList : public JZDeviceList
 {
@@ -43,7 +47,10 @@ class JZAlsaDeviceList : public JZDeviceList
 
 class JZAlsaPlayer : public JZPlayer
 {
+  friend class JZAlsaOutputPort;
   friend class JZAlsaThru;
+  friend class JZAlsaSyncGenerator;
+  friend class JZAlsaSysExSender;
   public:
     JZAlsaPlayer(JZSong *song);
     virtual ~JZAlsaPlayer();
@@ -70,6 +77,10 @@ class JZAlsaPlayer : public JZPlayer
     {
       return 1;
     }
+    virtual bool HasSyncGenerator() const
+    {
+      return true;
+    }
     virtual JZDeviceList & GetOutputDevices()
     {
       return oaddr;
@@ -88,6 +99,33 @@ class JZAlsaPlayer : public JZPlayer
     }
     int FindMidiDevice();
 
+    void FlushToDevice();
+
+    // The number of FlushToDevice() calls.
+    unsigned GetFlushCount() const
+    {
+      return mFlushCount;
+    }
+
+    // The number of writes that failed because the output pool was full.
+    unsigned GetBackpressureCount() const
+    {
+      return mBackpressureCount;
+    }
+
+    // The largest number of events sent in one FlushToDevice() call.
+    int GetPeakFlushSize() const
+    {
+      return mPeakFlushSize;
+    }
+
+    // The output port of a device, if the events of the tracks are sent to
+    // their own devices and the device has been used.
+    const JZAlsaOutputPort* GetOutputPort(int Device) const;
+
+    // Adds the counters of the output ports.
+    virtual void WriteStatistics(std::ostream& Os) const;
+
   protected:
     snd_seq_t *handle;
     JZAlsaDeviceList iaddr;        // addresses of input devices
@@ -122,6 +160,15 @@ class JZAlsaPlayer : public JZPlayer
     int write(snd_seq_event_t *ev, int now); // 0 == ok
     void set_event_header(snd_seq_event_t *ev, int clock, int type);
     void set_event_header(snd_seq_event_t *ev, int clock, int len, void *ptr);
+    void SetDeviceDestination(
+      snd_seq_event_t* pAlsaEvent,
+      int Device,
+      int Now);
+    bool EncodeEvent(
+      JZEvent* pEvent,
+      int Clock,
+      snd_seq_event_t* pAlsaEvent);
+    int WriteBatch();
     void init_queue_tempo(int time_base, int bpm);
     void start_queue_timer(int clock);
     void stop_queue_timer();
@@ -138,6 +185,14 @@ class JZAlsaPlayer : public JZPlayer
     void sync_master_remove();
     int sync_slave();
     void sync_slave_remove();
+    void StartSyncGenerator(int Clock, int LoopClock, int Continue);
+    void CreateSysExSender();
+    JZAlsaOutputPort* OpenOutputPort(int Device);
+    void FlushToPorts();
+    void DropPortOutput();
+    void CreateTimingPort();
+    void SendTimingProbe(int Clock);
+    void AddDispatchLateness(const snd_seq_event_t& Probe);
 
     int play_clock;   // current clock
     int recd_clock;  // clock received so far from recorded events or echo events
@@ -145,4 +200,32 @@ class JZAlsaPlayer : public JZPlayer
 
     JZAlsaThru *thru;
     int ithru, othru;  // index in iaddr, oaddr of source/target device
+
+    // Sends MIDI clock and MTC, created when playback first needs it.
+    JZAlsaSyncGenerator* mpSyncGenerator;
+    int mSyncDeviceIndex;
+
+    // Preallocated events for one FlushToDevice() batch.
+    std::vector<snd_seq_event_t> mOutputEvents;
+
+    // The largest flush so far and the one the pools were sized for.
+    int mPeakFlushSize;
+    int mPoolFlushSize;
+
+    int mOutputPoolSize;
+
+    unsigned mFlushCount;
+    unsigned mBackpressureCount;
+
+    // Send the events of each track to the output device of the track,
+    // through the output port of that device.
+    bool mIsMultiPort;
+
+    // The output ports by device, created when first used.
+    std::vector<JZAlsaOutputPort*> mOutputPorts;
+
+    // A port that receives timing probes stamped with the real time of the
+    // queue when they were dispatched, and the clock of the last probe.
+    int mTimingPort;
+    int mTimingProbeClock;
 };
@@ -0,0 +1,172 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "AlsaSyncGenerator.h"
+
+#include "AlsaPlayer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA sync generator class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaSyncGenerator::JZAlsaSyncGenerator(
+  JZPlaybackStatistics& Statistics,
+  const snd_seq_addr_t& Destination,
+  int Queue)
+  : JZSyncGenerator(Statistics),
+    mpHandle(0),
+    mpEncoder(0),
+    mPort(-1),
+    mQueue(Queue),
+    mRealtimePriority(0)
+{
+  if (snd_seq_open(&mpHandle, "hw", SND_SEQ_OPEN_OUTPUT, 0) < 0)
+  {
+    perror("open sync sequencer");
+    mpHandle = 0;
+    return;
+  }
+  JZAlsaPlayer::set_client_info(mpHandle, "Jazz++ Midi Sync");
+
+  mPort = snd_seq_create_simple_port(
+    mpHandle,
+    "Sync Output",
+    SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+    SND_SEQ_PORT_TYPE_MIDI_GENERIC);
+  if (
+    mPort < 0 ||
+    snd_seq_connect_to(
+      mpHandle,
+      mPort,
+      Destination.client,
+      Destination.port) < 0)
+  {
+    perror("connect sync port");
+    return;
+  }
+
+  // The largest message is the MTC full frame message.
+  if (snd_midi_event_new(16, &mpEncoder) < 0)
+  {
+    perror("sync encoder");
+    mpEncoder = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaSyncGenerator::~JZAlsaSyncGenerator()
+{
+  Stop();
+  if (mpEncoder)
+  {
+    snd_midi_event_free(mpEncoder);
+  }
+  if (mpHandle)
+  {
+    snd_seq_close(mpHandle);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Messages are sent directly, bypassing the queue, because the worker
+// thread already sends them on time.
+//-----------------------------------------------------------------------------
+void JZAlsaSyncGenerator::Send(const unsigned char* pMessage, int Length)
+{
+  if (!mpEncoder)
+  {
+    return;
+  }
+
+  snd_seq_event_t Event;
+  snd_seq_ev_clear(&Event);
+  snd_midi_event_reset_encode(mpEncoder);
+  if (snd_midi_event_encode(mpEncoder, pMessage, Length, &Event) <= 0)
+  {
+    return;
+  }
+
+  snd_seq_ev_set_source(&Event, mPort);
+  snd_seq_ev_set_subs(&Event);
+  snd_seq_ev_set_direct(&Event);
+  snd_seq_event_output_direct(mpHandle, &Event);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Failing to get a real time priority is not fatal, the deadlines are just
+// met less precisely.
+//-----------------------------------------------------------------------------
+void JZAlsaSyncGenerator::OnThreadStart()
+{
+  if (mRealtimePriority <= 0)
+  {
+    return;
+  }
+
+  sched_param Parameters;
+  memset(&Parameters, 0, sizeof(Parameters));
+  Parameters.sched_priority = mRealtimePriority;
+  int Error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &Parameters);
+  if (Error != 0)
+  {
+    fprintf(
+      stderr,
+      "Jazz++ Midi Sync: unable to set SCHED_FIFO priority %d: %s\n",
+      mRealtimePriority,
+      strerror(Error));
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Any client may read the status of the queue, so the own handle is used.
+//-----------------------------------------------------------------------------
+bool JZAlsaSyncGenerator::GetDriverTime(int& Clock, double& Microseconds)
+{
+  if (!mpHandle)
+  {
+    return false;
+  }
+
+  snd_seq_queue_status_t* pStatus;
+  snd_seq_queue_status_alloca(&pStatus);
+  if (snd_seq_get_queue_status(mpHandle, mQueue, pStatus) < 0)
+  {
+    return false;
+  }
+
+  Clock = snd_seq_queue_status_get_tick_time(pStatus);
+  const snd_seq_real_time_t* pRealTime =
+    snd_seq_queue_status_get_real_time(pStatus);
+  Microseconds = pRealTime->tv_sec * 1000000.0 + pRealTime->tv_nsec / 1000.0;
+  return true;
+}
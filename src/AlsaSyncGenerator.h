@@ -0,0 +1,99 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include "SyncGenerator.h"
+
+#include <alsa/asoundlib.h>
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA sync generator class declaration.  It sends the sync
+// messages through a sequencer client of its own, so the worker thread never
+// shares the sequencer handle of the player, and converts them into
+// sequencer events with the ALSA MIDI event encoder.  The messages follow
+// the tick and real time of the queue of the player.
+//*****************************************************************************
+class JZAlsaSyncGenerator : public JZSyncGenerator
+{
+  public:
+
+    JZAlsaSyncGenerator(
+      JZPlaybackStatistics& Statistics,
+      const snd_seq_addr_t& Destination,
+      int Queue);
+
+    virtual ~JZAlsaSyncGenerator();
+
+    bool IsInstalled() const;
+
+    // A priority from 1 to 99 runs the worker thread with the SCHED_FIFO
+    // policy, 0 leaves it a normal thread.  Takes effect on the next Start().
+    void SetRealtimePriority(int Priority);
+
+  protected:
+
+    virtual void Send(const unsigned char* pMessage, int Length);
+
+    virtual void OnThreadStart();
+
+    virtual bool GetDriverTime(int& Clock, double& Microseconds);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZAlsaSyncGenerator(const JZAlsaSyncGenerator&);
+    JZAlsaSyncGenerator& operator = (const JZAlsaSyncGenerator&);
+
+  private:
+
+    snd_seq_t* mpHandle;
+
+    snd_midi_event_t* mpEncoder;
+
+    int mPort;
+
+    int mQueue;
+
+    int mRealtimePriority;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the ALSA sync generator class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZAlsaSyncGenerator::IsInstalled() const
+{
+  return mpEncoder != 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZAlsaSyncGenerator::SetRealtimePriority(int Priority)
+{
+  mRealtimePriority = Priority;
+}
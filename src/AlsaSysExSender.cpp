@@ -0,0 +1,152 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "AlsaSysExSender.h"
+
+#include "AlsaPlayer.h"
+
+#include <cstdio>
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA SysEx sender class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaSysExSender::JZAlsaSysExSender(const snd_seq_addr_t& Destination)
+  : JZSysExSender(),
+    mpHandle(0),
+    mpEncoder(0),
+    mPort(-1),
+    mDeviceDestinations()
+{
+  if (snd_seq_open(&mpHandle, "hw", SND_SEQ_OPEN_OUTPUT, 0) < 0)
+  {
+    perror("open sysex sequencer");
+    mpHandle = 0;
+    return;
+  }
+  JZAlsaPlayer::set_client_info(mpHandle, "Jazz++ Midi SysEx");
+
+  mPort = snd_seq_create_simple_port(
+    mpHandle,
+    "SysEx Output",
+    SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+    SND_SEQ_PORT_TYPE_MIDI_GENERIC);
+  if (
+    mPort < 0 ||
+    snd_seq_connect_to(
+      mpHandle,
+      mPort,
+      Destination.client,
+      Destination.port) < 0)
+  {
+    perror("connect sysex port");
+    return;
+  }
+
+  // Only the short messages queued between SysEx messages are encoded.
+  if (snd_midi_event_new(16, &mpEncoder) < 0)
+  {
+    perror("sysex encoder");
+    mpEncoder = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAlsaSysExSender::~JZAlsaSysExSender()
+{
+  Stop();
+  if (mpEncoder)
+  {
+    snd_midi_event_free(mpEncoder);
+  }
+  if (mpHandle)
+  {
+    snd_seq_close(mpHandle);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAlsaSysExSender::SetDeviceDestinations(
+  const std::vector<snd_seq_addr_t>& Destinations)
+{
+  mDeviceDestinations = Destinations;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZAlsaSysExSender::GetQueueDevice(int Device) const
+{
+  if (Device >= 0 && static_cast<unsigned>(Device) < mDeviceDestinations.size())
+  {
+    return Device;
+  }
+  return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Messages of queue -1 go to the connected destination.
+//-----------------------------------------------------------------------------
+void JZAlsaSysExSender::Transmit(
+  int Device,
+  const unsigned char* pMessage,
+  int Length)
+{
+  if (!mpEncoder)
+  {
+    return;
+  }
+
+  snd_seq_event_t Event;
+  snd_seq_ev_clear(&Event);
+  if (pMessage[0] == 0xF0)
+  {
+    snd_seq_ev_set_sysex(&Event, Length, const_cast<unsigned char*>(pMessage));
+  }
+  else
+  {
+    snd_midi_event_reset_encode(mpEncoder);
+    if (snd_midi_event_encode(mpEncoder, pMessage, Length, &Event) <= 0)
+    {
+      return;
+    }
+  }
+
+  snd_seq_ev_set_source(&Event, mPort);
+  if (Device >= 0)
+  {
+    snd_seq_ev_set_dest(
+      &Event,
+      mDeviceDestinations[Device].client,
+      mDeviceDestinations[Device].port);
+  }
+  else
+  {
+    snd_seq_ev_set_subs(&Event);
+  }
+  snd_seq_ev_set_direct(&Event);
+  snd_seq_event_output_direct(mpHandle, &Event);
+}
@@ -0,0 +1,91 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include "SysExSender.h"
+
+#include <alsa/asoundlib.h>
+
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   This is the ALSA SysEx sender class declaration.  Like the sync
+// generator, it sends through a sequencer client of its own, connected to
+// the output device of the player, so the worker threads never share the
+// sequencer handle of the player.  The client blocks when the kernel pool
+// is full, which only holds up the worker thread.
+//*****************************************************************************
+class JZAlsaSysExSender : public JZSysExSender
+{
+  public:
+
+    JZAlsaSysExSender(const snd_seq_addr_t& Destination);
+
+    virtual ~JZAlsaSysExSender();
+
+    bool IsInstalled() const;
+
+    // Address the messages for a device to the passed address of the
+    // device instead of the connected destination.  Must be called before
+    // the first message is sent.
+    void SetDeviceDestinations(const std::vector<snd_seq_addr_t>& Destinations);
+
+  protected:
+
+    // The devices without a destination of their own share queue -1.
+    virtual int GetQueueDevice(int Device) const;
+
+    virtual void Transmit(
+      int Device,
+      const unsigned char* pMessage,
+      int Length);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZAlsaSysExSender(const JZAlsaSysExSender&);
+    JZAlsaSysExSender& operator = (const JZAlsaSysExSender&);
+
+  private:
+
+    snd_seq_t* mpHandle;
+
+    snd_midi_event_t* mpEncoder;
+
+    int mPort;
+
+    std::vector<snd_seq_addr_t> mDeviceDestinations;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the ALSA SysEx sender class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZAlsaSysExSender::IsInstalled() const
+{
+  return mpEncoder != 0;
+}
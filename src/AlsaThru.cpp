@@ -38,41 +38,59 @@
 #include "AlsaThru.h"
 
 #include "AlsaPlayer.h"
+#include "PlaybackStatistics.h"
 
 #include <cstdlib>
 #include <errno.h>
 #include <cstdio>
-#include <sys/wait.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <string.h>
-#include <signal.h>
 
 /*
-** midi thru for alsa. it creates a new process (because threads dont work
-** with wxwin) that copies from input to output.
+** midi thru for alsa. a worker thread copies from input to output.
 */
 
-JZAlsaThru::JZAlsaThru()
+JZAlsaThru::JZAlsaThru(JZPlaybackStatistics& Statistics)
+  : running(0),
+    mStatistics(Statistics),
+    mRealtimePriority(0),
+    mQueue(-1),
+    mWorker(),
+    mArrivalTimes()
 {
-  running = 0;
+  mWakeFds[0] = mWakeFds[1] = -1;
+  mArrivalTimes.reserve(64);
 }
 
 
 JZAlsaThru::~JZAlsaThru()
 {
-  // Calling Stop() caused the creation of an unkillable process on Mandriva
-  // 2008.0.
-//  if (running)
-//    Stop();
+  // The worker thread must be gone before the thread object.
+#ifndef USE_DIRECT_CONNECTION
+  if (running)
+    Stop();
+#endif
 }
 
 
-void JZAlsaThru::connect(snd_seq_addr_t &src, snd_seq_addr_t &dest)
+void JZAlsaThru::connect(
+  snd_seq_addr_t &src,
+  snd_seq_addr_t &dest,
+  int TimeStampQueue)
 {
   snd_seq_port_subscribe_t *subs;
   snd_seq_port_subscribe_alloca(&subs);
   snd_seq_port_subscribe_set_sender(subs, &src);
   snd_seq_port_subscribe_set_dest(subs, &dest);
+  if (TimeStampQueue >= 0)
+  {
+    snd_seq_port_subscribe_set_queue(subs, TimeStampQueue);
+    snd_seq_port_subscribe_set_time_update(subs, 1);
+    snd_seq_port_subscribe_set_time_real(subs, 1);
+  }
   if (snd_seq_subscribe_port(handle, subs) < 0)
     perror("subscribe");
 }
@@ -98,7 +116,12 @@ void JZAlsaThru::initialize()
   }
   JZAlsaPlayer::set_client_info(handle, "Jazz++ Midi Thru");
 
+#ifdef USE_DIRECT_CONNECTION
   if (snd_seq_nonblock(handle, 0) < 0)
+#else
+  // The worker thread waits in poll() and then reads whatever has arrived.
+  if (snd_seq_nonblock(handle, 1) < 0)
+#endif
   {
     perror("blocking mode");
     exit(1);
@@ -107,7 +130,17 @@ void JZAlsaThru::initialize()
   self.client  = snd_seq_client_id(handle);
   self.port    = JZAlsaPlayer::create_port(handle, "Input/Output");
 #ifndef USE_DIRECT_CONNECTION
-  connect(source, self);
+  mQueue = snd_seq_alloc_queue(handle);
+  if (mQueue < 0)
+  {
+    perror("alloc queue");
+  }
+  else
+  {
+    snd_seq_start_queue(handle, mQueue, 0);
+    snd_seq_drain_output(handle);
+  }
+  connect(source, self, mQueue);
   connect(self, destin);
 #endif
 }
@@ -139,108 +172,164 @@ void JZAlsaThru::Stop()
 
 #else // USE_DIRECT_CONNECTION
 
-void JZAlsaThru::loop()
+void JZAlsaThru::Start()
 {
-  snd_seq_event_t *ev;
-  while (snd_seq_event_input(handle, &ev) >= 0 && ev != 0)
+  if (!running)
   {
-    if (ev->source.client == source.client && ev->source.port == source.port)
+    initialize();
+    if (pipe(mWakeFds) < 0)
     {
-      ev->flags &= ~SND_SEQ_TIME_STAMP_MASK;
-      ev->flags |= SND_SEQ_TIME_STAMP_TICK;
-      ev->time.tick = 0;
-      ev->source = self;
-      snd_seq_ev_set_subs(ev);
-      snd_seq_ev_set_direct(ev);
-      snd_seq_event_output_direct(handle, ev);
+      perror("pipe");
+      snd_seq_close(handle);
+      return;
     }
-    snd_seq_free_event(ev);
+    mWorker = std::thread(&JZAlsaThru::loop, this);
+    running = 1;
   }
 }
 
-#if 0
-
-// thread version
-
-void JZAlsaThru::stopworker(int sig)
+void JZAlsaThru::Stop()
 {
-  running = 0;
-  snd_seq_close(handle);
-  pthread_exit((void *)0);
-}
+  if (running)
+  {
+    char Byte = 0;
+    if (write(mWakeFds[1], &Byte, 1) < 0)
+    {
+      perror("write");
+    }
+    mWorker.join();
 
+    close(mWakeFds[0]);
+    close(mWakeFds[1]);
+    mWakeFds[0] = mWakeFds[1] = -1;
 
-void * JZAlsaThru::startworker(void *p)
-{
-  running = 1;
-  signal(SIGHUP, stopworker);
-  JZAlsaThru *thru = (JZAlsaThru *)p;
-  thru->initialize();
-  thru->loop();
-  return 0;
+    // Closing the client also removes its queue and subscriptions.
+    snd_seq_close(handle);
+    mQueue = -1;
+    running = 0;
+  }
 }
 
-void JZAlsaThru::Start()
+//-----------------------------------------------------------------------------
+// Description:
+//   Failing to get a real time priority, usually because of missing
+// permissions, is not fatal.  The thread still reacts to every event without
+// waiting for the user interface.
+//-----------------------------------------------------------------------------
+void JZAlsaThru::SetThreadPriority()
 {
-  if (!running)
-    pthread_create(&worker, (void *)0, startworker, (void *)this);
+  if (mRealtimePriority <= 0)
+  {
+    return;
+  }
+
+  sched_param Parameters;
+  memset(&Parameters, 0, sizeof(Parameters));
+  Parameters.sched_priority = mRealtimePriority;
+  int Error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &Parameters);
+  if (Error != 0)
+  {
+    fprintf(
+      stderr,
+      "Jazz++ Midi Thru: unable to set SCHED_FIFO priority %d: %s\n",
+      mRealtimePriority,
+      strerror(Error));
+  }
 }
 
-void JZAlsaThru::Stop()
+//-----------------------------------------------------------------------------
+// Description:
+//   The worker thread.  It sleeps in poll() until the sequencer has input or
+// Stop() writes to the wake up pipe.
+//-----------------------------------------------------------------------------
+void JZAlsaThru::loop()
 {
-  if (running)
-    pthread_kill(worker, SIGHUP);
-}
+  SetThreadPriority();
 
+  int Count = snd_seq_poll_descriptors_count(handle, POLLIN);
+  std::vector<pollfd> Fds(Count + 1);
+  snd_seq_poll_descriptors(handle, &Fds[0], Count, POLLIN);
+  Fds[Count].fd = mWakeFds[0];
+  Fds[Count].events = POLLIN;
+  Fds[Count].revents = 0;
 
+  snd_seq_queue_status_t* pQueueStatus;
+  snd_seq_queue_status_malloc(&pQueueStatus);
 
-#else
+  while (true)
+  {
+    if (poll(&Fds[0], Fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("poll");
+      break;
+    }
 
-// fork version
+    if (Fds[Count].revents)
+    {
+      break;
+    }
 
-static snd_seq_t *static_handle;  // ugly!!
+    midithru(pQueueStatus);
+  }
 
-void JZAlsaThru::stopworker(int sig)
-{
-  snd_seq_close(static_handle);
-  exit(0);
+  snd_seq_queue_status_free(pQueueStatus);
 }
 
-void JZAlsaThru::Start()
+//-----------------------------------------------------------------------------
+// Description:
+//   Forward everything that has arrived, then measure the time since each
+// event arrived with a single query of the time stamp queue.
+//-----------------------------------------------------------------------------
+void JZAlsaThru::midithru(snd_seq_queue_status_t* pQueueStatus)
 {
-  if (!running)
+  mArrivalTimes.clear();
+
+  snd_seq_event_t *ev;
+  while (snd_seq_event_input(handle, &ev) >= 0 && ev != 0)
   {
-    worker = fork();
-    if (worker < 0)
-    {
-      perror("fork");
-      exit(1);
-    }
-    if (worker == 0)
+    if (ev->source.client == source.client && ev->source.port == source.port)
     {
-      signal(SIGHUP, stopworker);
-      initialize();
-      loop();
-      static_handle = handle;
-      // never come here
-      perror("loop");
-      exit(1);
+      if (snd_seq_ev_is_real(ev))
+      {
+        mArrivalTimes.push_back(ev->time.time);
+      }
+      ev->flags &= ~SND_SEQ_TIME_STAMP_MASK;
+      ev->flags |= SND_SEQ_TIME_STAMP_TICK;
+      ev->time.tick = 0;
+      ev->source = self;
+      snd_seq_ev_set_subs(ev);
+      snd_seq_ev_set_direct(ev);
+      snd_seq_event_output(handle, ev);
     }
-    running = 1;
+    snd_seq_free_event(ev);
   }
-}
+  snd_seq_drain_output(handle);
 
-void JZAlsaThru::Stop()
-{
-  if (running)
+  if (
+    !mArrivalTimes.empty() &&
+    snd_seq_get_queue_status(handle, mQueue, pQueueStatus) >= 0)
   {
-    int status = 0;
-    kill(worker, SIGHUP);
-    wait(&status);
-    running = 0;
+    const snd_seq_real_time_t* pNow =
+      snd_seq_queue_status_get_real_time(pQueueStatus);
+    for (
+      std::vector<snd_seq_real_time_t>::const_iterator iArrival =
+        mArrivalTimes.begin();
+      iArrival != mArrivalTimes.end();
+      ++iArrival)
+    {
+      long long Microseconds =
+        ((long long)pNow->tv_sec - iArrival->tv_sec) * 1000000 +
+        ((long long)pNow->tv_nsec - iArrival->tv_nsec) / 1000;
+      if (Microseconds >= 0)
+      {
+        mStatistics.AddThruLatency(Microseconds);
+      }
+    }
   }
 }
 
-#endif
-
 #endif // !USE_DIRECT_CONNECTION
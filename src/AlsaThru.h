@@ -28,23 +28,33 @@
 #include <alsa/asoundlib.h>
 #include <unistd.h>
 
+#include <thread>
+#include <vector>
+
+class JZPlaybackStatistics;
+
 //
 // define this if use kernel mode connection:
 // it may leave connection between thru ports if jazz quits
 // abnormally.  in such a case, disconnect manually via aconnect
-// utility.
-
-#define USE_DIRECT_CONNECTION
-
+// utility.  The thru latency is not measured in this mode.
 
-// does not work together with wxwin $%!
-// #include <pthread.h>
+// #define USE_DIRECT_CONNECTION
 
+//*****************************************************************************
+// Description:
+//   This is the ALSA MIDI thru class declaration.  Unless the kernel mode
+// connection is used, a worker thread blocks in poll() on the sequencer and
+// forwards incoming events as soon as they arrive, independent of the user
+// interface.  Incoming events are time stamped by a queue of the thru
+// client, so the time from arrival to output is added to the thru latency
+// statistics.
+//*****************************************************************************
 class JZAlsaThru
 {
   public:
 
-    JZAlsaThru();
+    JZAlsaThru(JZPlaybackStatistics& Statistics);
     virtual ~JZAlsaThru();
 
     void SetSource(int client, int port)
@@ -67,6 +77,14 @@ class JZAlsaThru
       client = destin.client;
       port   = destin.port;
     }
+
+    // A priority from 1 to 99 runs the worker thread with the SCHED_FIFO
+    // policy, 0 leaves it a normal thread.  Takes effect on the next Start().
+    void SetRealtimePriority(int Priority)
+    {
+      mRealtimePriority = Priority;
+    }
+
     void Start();
     void Stop();
     int  IsRunning() const
@@ -82,15 +100,30 @@ class JZAlsaThru
     snd_seq_addr_t source;
     snd_seq_addr_t destin;
 
-    void connect(snd_seq_addr_t &src, snd_seq_addr_t &dest);
+    void connect(
+      snd_seq_addr_t &src,
+      snd_seq_addr_t &dest,
+      int TimeStampQueue = -1);
     void disconnect(snd_seq_addr_t &src, snd_seq_addr_t &dest);
     void initialize();
     void loop();
-    void midithru();
-    static void * startworker(void *p);
-    static void stopworker(int signum);
+    void midithru(snd_seq_queue_status_t* pQueueStatus);
+    void SetThreadPriority();
 
-    // pthread_t worker;
-    pid_t worker;
     int running;
+
+    JZPlaybackStatistics& mStatistics;
+
+    int mRealtimePriority;
+
+    // The queue that time stamps incoming events.
+    int mQueue;
+
+    // Writing to this pipe wakes the worker thread up to stop it.
+    int mWakeFds[2];
+
+    std::thread mWorker;
+
+    // The arrival times of the events forwarded by one midithru() call.
+    std::vector<snd_seq_real_time_t> mArrivalTimes;
 };
@@ -22,6 +22,7 @@
 
 #include "Audio.h"
 
+#include "Configuration.h"
 #include "Dialogs/AudioSettingsDialog.h"
 #include "Dialogs/SamplesDialog.h"
 #include "Events.h"
@@ -57,6 +58,10 @@
 
 using namespace std;
 
+// A stolen voice fades out in this many steps of this many frames.
+static const int FadeStepCount = 8;
+static const int FadeStepFrames = 32;
+
 //*****************************************************************************
 // Description:
 //   This is the sample voice class declaration.  This class is activated via a
@@ -68,21 +73,79 @@ class JZSampleVoice
   public:
 
     JZSampleVoice(JZSampleSet& s)
-      : set(s)
+      : set(s),
+        mpStream(0)
+    {
+    }
+
+    ~JZSampleVoice()
     {
+      ReleaseStream();
     }
 
-    void Start(JZSample* s, long c)
+    void Start(JZSample* s, long c, int Velocity)
     {
+      ReleaseStream();
       spl    = s;
       clock  = c;
       first  = 1;
-      length = spl->length;
-      mpData = spl->mpData;
+      length = spl->GetTotalLength();
+      mPosition = 0;
       prev   = 0;
+      mIsFading = false;
+      mFadeStart = 0;
+      SetGain(Velocity);
+    }
+
+    // Fade out from the passed clock on, so the voice can be taken by a new
+    // note without a click.
+    void FadeOut(long StopClock)
+    {
+      long FadeStart =
+        (StopClock > clock) ? set.Ticks2Samples(StopClock - clock) : 0;
+      if (FadeStart < mPosition)
+      {
+        FadeStart = mPosition;
+      }
+      long FadeEnd =
+        FadeStart + FadeStepCount * FadeStepFrames * set.GetChannelCount();
+      if (length > FadeEnd - mPosition)
+      {
+        length = FadeEnd - mPosition;
+      }
+      mFadeStart = FadeStart;
+      mIsFading = true;
+    }
+
+    bool IsFading() const
+    {
+      return mIsFading;
+    }
+
+    long GetClock() const
+    {
+      return clock;
+    }
+
+    short GetLevel() const
+    {
+      return mGain0 > mGain1 ? mGain0 : mGain1;
+    }
+
+    // Give the stream of a streamed sample back to the streamer.
+    void ReleaseStream()
+    {
+      if (mpStream)
+      {
+        mpStream->Close();
+        mpStream = 0;
+      }
     }
 
-    void AddBuffer(short* b, long buffer_clock, unsigned int bufsize)
+    void AddBuffer(
+      JZAudioMixer& Mixer,
+      long buffer_clock,
+      unsigned int bufsize)
     {
 
       // everything done?
@@ -105,12 +168,27 @@ class JZSampleVoice
         {
           // output starts somewhere in the middle of a sample
           long data_offs = set.Ticks2Samples(buffer_clock - clock);
-          mpData += data_offs;
+          mPosition += data_offs;
           length -= data_offs;
           if (length <= 0)
             return;
         }
         first = 0;
+
+        // Start reading the rest of a streamed sample while the head plays.
+        // Without a free stream only the head is played.
+        if (spl->IsStreamed())
+        {
+          long Position =
+            (mPosition > spl->length) ? mPosition : (long)spl->length;
+          mpStream = set.GetStreamer().Open(spl, Position);
+          if (!mpStream && length > spl->length - mPosition)
+          {
+            length = spl->length - mPosition;
+            if (length <= 0)
+              return;
+          }
+        }
       }
 
       // compute number of samples to put into this buffer
@@ -118,16 +196,20 @@ class JZSampleVoice
       if (count > length)
         count = length;
 
-      // update length and copy data
+      // update length and mix data
       length -= count;
-      b += offset;
-      while (count--)
+      Mix(Mixer, offset, count);
+      if (length <= 0)
       {
-        *b++ += *mpData++;
+        ReleaseStream();
       }
     }
 
-    void AddListen(short* b, long fr_smpl, long to_smpl, unsigned int bufsize)
+    void AddListen(
+      JZAudioMixer& Mixer,
+      long fr_smpl,
+      long to_smpl,
+      unsigned int bufsize)
     {
       // Is everything done?
       if (length <= 0)
@@ -145,7 +227,7 @@ class JZSampleVoice
 
         if (fr_smpl > 0 && fr_smpl < length)
         {
-          mpData += fr_smpl;
+          mPosition += fr_smpl;
           length -= fr_smpl;
         }
         first = false;
@@ -161,12 +243,9 @@ class JZSampleVoice
         count = length;
       }
 
-      // update length and copy data
+      // update length and mix data
       length -= count;
-      while (count--)
-      {
-        *b++ += *mpData++;
-      }
+      Mix(Mixer, 0, count);
     }
 
     int Finished()
@@ -175,13 +254,116 @@ class JZSampleVoice
     }
 
   private:
+
+    // Mix the next samples at the passed buffer offset, stepping the gains
+    // down during a fade out.  The head of the sample is in memory, the rest
+    // of a streamed sample comes from its stream.  What the stream has not
+    // delivered in time is left silent.
+    void Mix(JZAudioMixer& Mixer, long offset, long count)
+    {
+      long StepLength = FadeStepFrames * set.GetChannelCount();
+      while (count > 0)
+      {
+        long Chunk = count;
+        short Gain0 = mGain0;
+        short Gain1 = mGain1;
+        if (mIsFading && mPosition >= mFadeStart)
+        {
+          long Step = (mPosition - mFadeStart) / StepLength;
+          long StepEnd = mFadeStart + (Step + 1) * StepLength;
+          if (Chunk > StepEnd - mPosition)
+          {
+            Chunk = StepEnd - mPosition;
+          }
+          long Scale = FadeStepCount - Step;
+          Gain0 = (short)(Gain0 * Scale / (FadeStepCount + 1));
+          Gain1 = (short)(Gain1 * Scale / (FadeStepCount + 1));
+        }
+        else if (mIsFading && mPosition + Chunk > mFadeStart)
+        {
+          Chunk = mFadeStart - mPosition;
+        }
+
+        const short* pData = 0;
+        if (mPosition < spl->length)
+        {
+          pData = spl->mpData + mPosition;
+          if (Chunk > spl->length - mPosition)
+          {
+            Chunk = spl->length - mPosition;
+          }
+        }
+        else if (mpStream)
+        {
+          long Available;
+          pData = mpStream->Peek(Available);
+          Available -= Available % set.GetChannelCount();
+          if (Available == 0)
+          {
+            pData = 0;
+            mpStream->Skip(Chunk);
+          }
+          else if (Chunk > Available)
+          {
+            Chunk = Available;
+          }
+        }
+
+        if (pData)
+        {
+          Mixer.AddScaled(pData, offset, Chunk, Gain0, Gain1);
+          if (mPosition >= spl->length)
+          {
+            mpStream->Consume(Chunk);
+          }
+        }
+        offset += Chunk;
+        count -= Chunk;
+        mPosition += Chunk;
+      }
+    }
+
+    // Compute the left and right gains from the sample volume and pan and
+    // the key velocity, using the pan law the samples were once converted
+    // with.
+    void SetGain(int Velocity)
+    {
+      long Gain =
+        (long)JZAudioMixer::UnityGain * spl->GetVolume() * Velocity /
+        (127L * 127L);
+      if (Gain > JZAudioMixer::UnityGain)
+      {
+        Gain = JZAudioMixer::UnityGain;
+      }
+      else if (Gain < 0)
+      {
+        Gain = 0;
+      }
+
+      mGain0 = mGain1 = (short)Gain;
+      int Pan = (set.GetChannelCount() == 2) ? spl->GetPan() : 0;
+      if (Pan > 0)
+      {
+        mGain0 = (short)(Gain * (63L - Pan) / 64L);
+      }
+      else if (Pan < 0)
+      {
+        mGain1 = (short)(Gain * (63L + Pan) / 64L);
+      }
+    }
+
     JZSampleSet& set;
     long         clock;
     JZSample*    spl;
-    short*       mpData;
+    long         mPosition;
+    JZSampleStream* mpStream;
     int          first;
     long         length;
     short        prev;
+    short        mGain0;
+    short        mGain1;
+    bool         mIsFading;
+    long         mFadeStart;
 };
 
 //*****************************************************************************
@@ -198,6 +380,16 @@ JZSampleSet::JZSampleSet(long TicksPerMinute)
     mSoftwareSynchonization(true),
     mTicksPerMinute(TicksPerMinute),
     mpSamplesDialog(nullptr),
+    mNotes(),
+    mQueuedClock(0),
+    mVoices(),
+    mFreeVoices(),
+    mActiveVoices(),
+    mPolyphony(0),
+    mStolenVoiceCount(0),
+    mDroppedVoiceCount(0),
+    mStreamer(),
+    mMixer(),
     mDefaultFileName("noname.spl"),
     mRecordFileName("noname.wav")
 {
@@ -218,11 +410,7 @@ JZSampleSet::JZSampleSet(long TicksPerMinute)
     mSampleFrames[i] = 0;
   }
 
-  for (i = 0; i < MAXPOLY; i++)
-  {
-    voices[i] = new JZSampleVoice(*this);
-  }
-  num_voices = 0;
+  SetPolyphony(eDefaultPolyphony);
 }
 
 //-----------------------------------------------------------------------------
@@ -235,10 +423,7 @@ JZSampleSet::~JZSampleSet()
     delete mSamples[i];
     delete mSampleFrames[i];
   }
-  for (i = 0; i < MAXPOLY; i++)
-  {
-    delete voices[i];
-  }
+  DeleteVoices();
   for (i = 0; i < BUFCOUNT; i++)
   {
     delete mpBuffers[i];
@@ -253,6 +438,19 @@ void JZSampleSet::Edit(int key)
   {
     JZSample* spl = mSamples[key];
 
+    // The editor works on the data in memory.  Loading it frees the
+    // streamed data, which the render thread may be mixing, so like the
+    // edits in the sample editor this waits until playback stopped.
+    if (spl->IsStreamed() && gpMidiPlayer->IsPlaying())
+    {
+      ::wxMessageBox(
+        "Stop playback to edit a sample streamed from disk.",
+        "Error",
+        wxOK);
+      return;
+    }
+    spl->MakeResident();
+
     mSampleFrames[key] = new JZSampleFrame(
       gpTrackWindow,
       &mSampleFrames[key],
@@ -423,12 +621,152 @@ int JZSampleSet::ResetBuffers(
   start_clock       = clock;
   mTicksPerMinute  = TicksPerMinute;
   event_index       = 0;
+  mNotes.Clear();
+  mQueuedClock.store(clock);
   bufshorts = BUFSHORTS;
   mClocksPerBuffer = Samples2Ticks(bufshorts);
-  num_voices        = 0;
+
+  ReleaseStreams();
+  SetPolyphony(gpConfig->GetValue(C_AudioPolyphony));
+  mFreeVoices = mVoices;
+  mActiveVoices.clear();
+  mStolenVoiceCount = 0;
+  mDroppedVoiceCount = 0;
   return 0;
 }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleSet::SetPolyphony(int Polyphony)
+{
+  if (Polyphony < 1)
+  {
+    Polyphony = 1;
+  }
+  if (Polyphony == mPolyphony)
+  {
+    return;
+  }
+
+  DeleteVoices();
+  mPolyphony = Polyphony;
+  for (int i = 0; i < mPolyphony + eFadingVoiceCount; ++i)
+  {
+    mVoices.push_back(new JZSampleVoice(*this));
+  }
+  mFreeVoices = mVoices;
+  mActiveVoices.reserve(mVoices.size());
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleSet::DeleteVoices()
+{
+  for (
+    vector<JZSampleVoice*>::iterator iVoice = mVoices.begin();
+    iVoice != mVoices.end();
+    ++iVoice)
+  {
+    delete *iVoice;
+  }
+  mVoices.clear();
+  mFreeVoices.clear();
+  mActiveVoices.clear();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleSet::ReleaseStreams()
+{
+  for (
+    vector<JZSampleVoice*>::iterator iVoice = mVoices.begin();
+    iVoice != mVoices.end();
+    ++iVoice)
+  {
+    (*iVoice)->ReleaseStream();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Steal the quietest voice, and of those the oldest, when all voices are
+// taken.  The stolen voice fades out in one of the extra voices.  Only when
+// these are all fading too is it cut off and restarted right away.
+//-----------------------------------------------------------------------------
+void JZSampleSet::StartVoice(const JZAudioNote& Note)
+{
+  JZSample* pSample = mSamples[Note.mKey];
+  if (pSample->IsEmpty())
+  {
+    return;
+  }
+
+  int SoundingCount = 0;
+  for (
+    vector<JZSampleVoice*>::const_iterator iVoice = mActiveVoices.begin();
+    iVoice != mActiveVoices.end();
+    ++iVoice)
+  {
+    if (!(*iVoice)->IsFading())
+    {
+      ++SoundingCount;
+    }
+  }
+
+  JZSampleVoice* pStolenVoice = 0;
+  if (SoundingCount >= mPolyphony)
+  {
+    pStolenVoice = FindStolenVoice();
+    pStolenVoice->FadeOut(Note.mClock);
+    ++mStolenVoiceCount;
+  }
+
+  if (mFreeVoices.empty())
+  {
+    if (pStolenVoice)
+    {
+      pStolenVoice->Start(pSample, Note.mClock, Note.mVelocity);
+    }
+    else
+    {
+      ++mDroppedVoiceCount;
+    }
+    return;
+  }
+
+  JZSampleVoice* pVoice = mFreeVoices.back();
+  mFreeVoices.pop_back();
+  pVoice->Start(pSample, Note.mClock, Note.mVelocity);
+  mActiveVoices.push_back(pVoice);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSampleVoice* JZSampleSet::FindStolenVoice() const
+{
+  JZSampleVoice* pStolenVoice = 0;
+  for (
+    vector<JZSampleVoice*>::const_iterator iVoice = mActiveVoices.begin();
+    iVoice != mActiveVoices.end();
+    ++iVoice)
+  {
+    JZSampleVoice* pVoice = *iVoice;
+    if (pVoice->IsFading())
+    {
+      continue;
+    }
+    if (
+      !pStolenVoice ||
+      pVoice->GetLevel() < pStolenVoice->GetLevel() ||
+      (pVoice->GetLevel() == pStolenVoice->GetLevel() &&
+       pVoice->GetClock() < pStolenVoice->GetClock()))
+    {
+      pStolenVoice = pVoice;
+    }
+  }
+  return pStolenVoice;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 int JZSampleSet::ResetBufferSize(unsigned int bufsize)
@@ -447,6 +785,50 @@ int JZSampleSet::ResetBufferSize(unsigned int bufsize)
 //-----------------------------------------------------------------------------
 int JZSampleSet::FillBuffers(long last_clock)
 {
+  QueueNotes(last_clock);
+  return RenderBuffers();
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   When the queue is full, the queued clock stops at the first note left
+// out, so the renderer does not run ahead of it.
+//-----------------------------------------------------------------------------
+void JZSampleSet::QueueNotes(long last_clock)
+{
+  while (event_index < events->mEventCount)
+  {
+    JZEvent* pEvent = events->mppEvents[event_index];
+    if (pEvent->GetClock() >= last_clock)
+    {
+      break;
+    }
+
+    JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
+    if (pKeyOn)
+    {
+      JZAudioNote Note;
+      Note.mClock = pKeyOn->GetClock();
+      Note.mKey = pKeyOn->GetKey();
+      Note.mVelocity = pKeyOn->GetVelocity();
+      if (!mNotes.Put(Note))
+      {
+        last_clock = Note.mClock;
+        break;
+      }
+    }
+    event_index++;
+  }
+
+  mQueuedClock.store(last_clock, memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSampleSet::RenderBuffers()
+{
+  long last_clock = mQueuedClock.load(memory_order_acquire);
+
   // check if last_clock is bigger than free buffer space
   // and compute the count of buffers that can be filled
   int i;
@@ -474,30 +856,18 @@ int JZSampleSet::FillBuffers(long last_clock)
     return 0;
   }
 
-  // iterate the events and add sounding voices
-  while (event_index < events->mEventCount)
+  // start the voices of the queued notes
+  const JZAudioNote* pNote;
+  while ((pNote = mNotes.Peek()) != 0 && pNote->mClock < last_clock)
   {
-    JZEvent* pEvent = events->mppEvents[event_index];
-    if (pEvent->GetClock() >= last_clock)
-    {
-      break;
-    }
-    event_index++;
-
-    JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
-    if (pKeyOn && num_voices < MAXPOLY)
-    {
-      voices[num_voices++]->Start(
-        mSamples[pKeyOn->GetKey()],
-        pKeyOn->GetClock());
-    }
+    StartVoice(*pNote);
+    mNotes.Pop();
   }
 
   // add remaining sample data to the buffers
   for (i = 0; i < nfree; i++)
   {
     JZAudioBuffer* buf = mFreeBuffers.Get();
-    buf->Clear();
     long buffer_clock = BufferClock(buffers_written + i);
 
 //    cout
@@ -505,25 +875,30 @@ int JZSampleSet::FillBuffers(long last_clock)
 //      << ", clock " << buffer_clock
 //      << endl;
 
-    for (int k = 0; k < num_voices; k++)
+    // Sum the voices with headroom and convert the sum once.  A finished
+    // voice is replaced by the last one, so the following buffers do not
+    // visit it.
+    mMixer.Clear(bufshorts);
+    size_t k = 0;
+    while (k < mActiveVoices.size())
     {
-      voices[k]->AddBuffer(buf->data, buffer_clock, bufshorts);
+      JZSampleVoice* pVoice = mActiveVoices[k];
+      pVoice->AddBuffer(mMixer, buffer_clock, bufshorts);
+      if (pVoice->Finished())
+      {
+        mFreeVoices.push_back(pVoice);
+        mActiveVoices[k] = mActiveVoices.back();
+        mActiveVoices.pop_back();
+      }
+      else
+      {
+        ++k;
+      }
     }
+    mMixer.Render(buf->data);
     mFullBuffers.Put(buf);
   }
 
-  // delete finished voices
-  for (i = 0; i < num_voices; i++)
-  {
-    if (voices[i]->Finished())
-    {
-      JZSampleVoice* v = voices[i];
-      voices[i] = voices[num_voices-1];
-      voices[num_voices-1] = v;
-      num_voices--;
-    }
-  }
-
   // all buffer filled up?
   buffers_written += nfree;
 
@@ -538,9 +913,12 @@ int JZSampleSet::PrepareListen(JZSample* spl, long fr_smpl, long to_smpl)
 {
   listen_sample = spl;
 
+  // Listening renders far ahead at once, so the streamer could not keep up.
+  spl->MakeResident();
+
   assert(mTicksPerMinute);
   ResetBuffers(0, 0, mTicksPerMinute);
-  voices[0]->Start(spl, 0);
+  mVoices[0]->Start(spl, 0, 127);
   int nfree = mFreeBuffers.Count();
   int sound_buffers = 0;
 
@@ -548,9 +926,11 @@ int JZSampleSet::PrepareListen(JZSample* spl, long fr_smpl, long to_smpl)
   {
     JZAudioBuffer* buf = mFreeBuffers.Get();
     buf->Clear();
-    if (!voices[0]->Finished())
+    if (!mVoices[0]->Finished())
     {
-      voices[0]->AddListen(buf->Data(), fr_smpl, to_smpl, bufshorts);
+      mMixer.Clear(bufshorts);
+      mVoices[0]->AddListen(mMixer, fr_smpl, to_smpl, bufshorts);
+      mMixer.Render(buf->Data());
       sound_buffers++;
     }
     mFullBuffers.Put(buf);
@@ -578,9 +958,11 @@ int JZSampleSet::ContinueListen()
   {
     JZAudioBuffer* buf = mFreeBuffers.Get();
     buf->Clear();
-    if (!voices[0]->Finished())
+    if (!mVoices[0]->Finished())
     {
-      voices[0]->AddListen(buf->Data(), -1, -1, bufshorts);
+      mMixer.Clear(bufshorts);
+      mVoices[0]->AddListen(mMixer, -1, -1, bufshorts);
+      mMixer.Render(buf->Data());
       sound_buffers++;
     }
     mFullBuffers.Put(buf);
@@ -608,7 +990,7 @@ void JZSampleSet::AdjustAudioLength(JZTrack* pTrack, long TicksPerMinute)
     if (pKeyOn)
     {
       pKeyOn->SetLength(
-        (int)Samples2Ticks(mSamples[pKeyOn->GetKey()]->GetLength()));
+        (int)Samples2Ticks(mSamples[pKeyOn->GetKey()]->GetTotalLength()));
 
       // Is the event visble?
       if (pKeyOn->GetEventLength() < 15)
@@ -627,19 +1009,30 @@ void JZSampleSet::StartPlay(int clock)
   ReloadSamples();
 
   // touch all playback sample data, so they may get swapped into memory
+  bool HasStreamedSamples = false;
   for (int i = 0; i < eSampleCount; i++)
   {
     JZSample* spl = mSamples[i];
     spl->GotoRAM();
+    HasStreamedSamples |= spl->IsStreamed();
+  }
+
+  if (HasStreamedSamples)
+  {
+    mStreamer.Start();
   }
 
   is_playing = 1;
 }
 
 //-----------------------------------------------------------------------------
+// Description:
+//   The driver must have stopped rendering.
 //-----------------------------------------------------------------------------
 void JZSampleSet::StopPlay()
 {
+  ReleaseStreams();
+  mStreamer.Stop();
   is_playing = 0;
 }
 
@@ -22,12 +22,17 @@
 
 #pragma once
 
+#include "AudioMixer.h"
 #include "DynamicArray.h"
 #include "Project.h"
+#include "SampleStreamer.h"
 
 #include <wx/app.h>
 #include <wx/string.h>
 
+#include <atomic>
+#include <vector>
+
 class JZSamplesDialog;
 class JZTrack;
 class JZAudioBufferQueue;
@@ -113,6 +118,9 @@ struct JZAudioBuffer
 };
 
 //*****************************************************************************
+// Description:
+//   This is the audio buffer queue class declaration.  One thread may put
+// buffers into the queue while another thread gets them, without a lock.
 //*****************************************************************************
 class JZAudioBufferQueue
 {
@@ -127,9 +135,11 @@ class JZAudioBufferQueue
     {
     }
 
+    // Only call this when neither producer nor consumer are active.
     void Clear()
     {
-      written = read = 0;
+      mWritten.store(0);
+      mRead.store(0);
       for (int i = 0; i < BUFCOUNT; i++)
       {
         array[i] = 0;
@@ -138,38 +148,129 @@ class JZAudioBufferQueue
 
     int Count() const
     {
-      return written - read;
+      return (int)(
+        mWritten.load(std::memory_order_acquire) -
+        mRead.load(std::memory_order_acquire));
     }
 
     int Empty() const
     {
-      return written == read;
+      return Count() == 0;
     }
 
+    // Producer side.
     void Put(JZAudioBuffer *buf)
     {
-      array[written++ % BUFCOUNT] = buf;
+      unsigned Written = mWritten.load(std::memory_order_relaxed);
+      array[Written % BUFCOUNT] = buf;
+      mWritten.store(Written + 1, std::memory_order_release);
     }
 
+    // Consumer side.
     JZAudioBuffer* Get()
     {
-      if (written == read)
+      unsigned Read = mRead.load(std::memory_order_relaxed);
+      if (Read == mWritten.load(std::memory_order_acquire))
       {
         return 0;
       }
-      return(array[read++ % BUFCOUNT]);
+      JZAudioBuffer* buf = array[Read % BUFCOUNT];
+      mRead.store(Read + 1, std::memory_order_release);
+      return buf;
     }
 
+    // Consumer side.  The queue must not be full.
     void UnGet(JZAudioBuffer* buf)
     {
-      array[ --read % BUFCOUNT ] = buf;
+      unsigned Read = mRead.load(std::memory_order_relaxed) - 1;
+      array[Read % BUFCOUNT] = buf;
+      mRead.store(Read, std::memory_order_release);
     }
 
   private:
 
     JZAudioBuffer* array[BUFCOUNT];
 
-    int read, written;
+    std::atomic<unsigned> mRead;
+    std::atomic<unsigned> mWritten;
+};
+
+//*****************************************************************************
+// Description:
+//   A note on event of an audio track.
+//*****************************************************************************
+struct JZAudioNote
+{
+  long mClock;
+  int mKey;
+  int mVelocity;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the audio note queue class declaration.  It passes the notes of
+// the audio tracks from the thread that prepares the events to the thread
+// that renders the audio buffers, without a lock.
+//*****************************************************************************
+class JZAudioNoteQueue
+{
+  public:
+
+    enum
+    {
+      eCapacity = 1024
+    };
+
+    JZAudioNoteQueue()
+    {
+      Clear();
+    }
+
+    // Only call this when neither producer nor consumer are active.
+    void Clear()
+    {
+      mWritten.store(0);
+      mRead.store(0);
+    }
+
+    // Producer side.  Returns false if the queue is full.
+    bool Put(const JZAudioNote& Note)
+    {
+      unsigned Written = mWritten.load(std::memory_order_relaxed);
+      if (Written - mRead.load(std::memory_order_acquire) == eCapacity)
+      {
+        return false;
+      }
+      mNotes[Written % eCapacity] = Note;
+      mWritten.store(Written + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side.  Returns the oldest note or 0 if the queue is empty.
+    const JZAudioNote* Peek() const
+    {
+      unsigned Read = mRead.load(std::memory_order_relaxed);
+      if (Read == mWritten.load(std::memory_order_acquire))
+      {
+        return 0;
+      }
+      return &mNotes[Read % eCapacity];
+    }
+
+    // Consumer side.  Removes the note returned by Peek().
+    void Pop()
+    {
+      mRead.store(
+        mRead.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+    }
+
+  private:
+
+    JZAudioNote mNotes[eCapacity];
+
+    std::atomic<unsigned> mRead;
+    std::atomic<unsigned> mWritten;
 };
 
 //*****************************************************************************
@@ -290,8 +391,44 @@ class JZSampleSet
 
     int ResetBufferSize(unsigned int bytes);
 
+    // Queue the notes up to the passed clock and render as many buffers as
+    // possible.
     int FillBuffers(long last_clock);
 
+    // Queue the notes of the audio events up to the passed clock for
+    // RenderBuffers(), which may run in another thread.
+    void QueueNotes(long last_clock);
+
+    // Render buffers up to the clock of the last QueueNotes() call.
+    // Returns the number of buffers rendered.
+    int RenderBuffers();
+
+    int GetPolyphony() const
+    {
+      return mPolyphony;
+    }
+
+    // Reallocate the voices, which must not be in use.
+    void SetPolyphony(int Polyphony);
+
+    // The voices stolen by notes beyond the polyphony and the notes dropped
+    // since the last ResetBuffers().
+    unsigned GetStolenVoiceCount() const
+    {
+      return mStolenVoiceCount;
+    }
+
+    unsigned GetDroppedVoiceCount() const
+    {
+      return mDroppedVoiceCount;
+    }
+
+    // Reads the streamed samples while playing.
+    JZSampleStreamer& GetStreamer()
+    {
+      return mStreamer;
+    }
+
     JZAudioBuffer* GetBuffer(int i) const
     {
       // 0 < i < BUFCOUNT
@@ -383,6 +520,14 @@ class JZSampleSet
 
   protected:
 
+    void StartVoice(const JZAudioNote& Note);
+
+    JZSampleVoice* FindStolenVoice() const;
+
+    void DeleteVoices();
+
+    void ReleaseStreams();
+
     long SampleSize(long num_samples)
     {
       return mChannelCount * (mBitsPerSample == 8 ? 1L : 2L) * num_samples;
@@ -434,13 +579,32 @@ class JZSampleSet
 
     JZEventArray* events;
 
+    // The notes passed to RenderBuffers() and the clock up to which all
+    // notes were queued.
+    JZAudioNoteQueue mNotes;
+    std::atomic<long> mQueuedClock;
+
     enum
     {
-      MAXPOLY = 100
+      eDefaultPolyphony = 100,
+
+      // The extra voices that stolen voices fade out in.
+      eFadingVoiceCount = 16
     };
 
-    JZSampleVoice* voices[MAXPOLY];
-    int num_voices;
+    // All voices, the free ones and the sounding ones.  A finished voice
+    // moves from mActiveVoices to mFreeVoices as soon as it is mixed.
+    std::vector<JZSampleVoice*> mVoices;
+    std::vector<JZSampleVoice*> mFreeVoices;
+    std::vector<JZSampleVoice*> mActiveVoices;
+    int mPolyphony;
+    unsigned mStolenVoiceCount;
+    unsigned mDroppedVoiceCount;
+
+    JZSampleStreamer mStreamer;
+
+    // Sums the voices of one buffer.
+    JZAudioMixer mMixer;
     int adjust_audio_length;
 
     wxString mDefaultFileName;
@@ -0,0 +1,521 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "AudioMixer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JZ_MIXER_SSE2
+#include <emmintrin.h>
+#endif
+
+// GCC and clang compile the AVX2 loops for a processor without AVX2 and
+// select them at run time.  Other compilers need AVX2 enabled globally.
+#if defined(JZ_MIXER_SSE2) && defined(__GNUC__)
+#define JZ_MIXER_AVX2
+#define JZ_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(JZ_MIXER_SSE2) && defined(__AVX2__)
+#define JZ_MIXER_AVX2
+#define JZ_TARGET_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Samples above this level are compressed.
+static const int SoftClipKnee = 24576;
+static const int SoftClipRange = 32767 - SoftClipKnee;
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void AddScalar(int* pSum, const short* pData, unsigned Count)
+{
+  for (unsigned i = 0; i < Count; ++i)
+  {
+    pSum[i] += pData[i];
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void AddScaledScalar(
+  int* pSum,
+  const short* pData,
+  unsigned Count,
+  short Gain0,
+  short Gain1)
+{
+  unsigned i = 0;
+  for (; i + 2 <= Count; i += 2)
+  {
+    pSum[i] += (pData[i] * Gain0) >> 15;
+    pSum[i + 1] += (pData[i + 1] * Gain1) >> 15;
+  }
+  if (i < Count)
+  {
+    pSum[i] += (pData[i] * Gain0) >> 15;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static bool IsBelowKneeScalar(const int* pSum, unsigned Count)
+{
+  int Outside = 0;
+  for (unsigned i = 0; i < Count; ++i)
+  {
+    Outside |= (pSum[i] > SoftClipKnee) | (pSum[i] < -SoftClipKnee);
+  }
+  return Outside == 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void PackScalar(const int* pSum, short* pBuffer, unsigned Count)
+{
+  for (unsigned i = 0; i < Count; ++i)
+  {
+    pBuffer[i] = (short)pSum[i];
+  }
+}
+
+#ifdef JZ_MIXER_SSE2
+
+//-----------------------------------------------------------------------------
+// Description:
+//   SSE2 has no sign extension from 16 to 32 bits, so the samples are
+// unpacked into the upper halves and shifted down.
+//-----------------------------------------------------------------------------
+static void AddSse2(int* pSum, const short* pData, unsigned Count)
+{
+  unsigned i = 0;
+  for (; i + 8 <= Count; i += 8)
+  {
+    __m128i Data = _mm_loadu_si128((const __m128i*)(pData + i));
+    __m128i Low = _mm_srai_epi32(_mm_unpacklo_epi16(Data, Data), 16);
+    __m128i High = _mm_srai_epi32(_mm_unpackhi_epi16(Data, Data), 16);
+    __m128i* pLow = (__m128i*)(pSum + i);
+    __m128i* pHigh = (__m128i*)(pSum + i + 4);
+    _mm_storeu_si128(pLow, _mm_add_epi32(_mm_loadu_si128(pLow), Low));
+    _mm_storeu_si128(pHigh, _mm_add_epi32(_mm_loadu_si128(pHigh), High));
+  }
+  AddScalar(pSum + i, pData + i, Count - i);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   SSE2 has no 32 bit multiply, so the low and high halves of the 16 by 16
+// bit products are interleaved into 32 bit products.
+//-----------------------------------------------------------------------------
+static void AddScaledSse2(
+  int* pSum,
+  const short* pData,
+  unsigned Count,
+  short Gain0,
+  short Gain1)
+{
+  const __m128i Gain = _mm_set1_epi32(
+    (int)(((unsigned)(unsigned short)Gain1 << 16) | (unsigned short)Gain0));
+  unsigned i = 0;
+  for (; i + 8 <= Count; i += 8)
+  {
+    __m128i Data = _mm_loadu_si128((const __m128i*)(pData + i));
+    __m128i ProductLow = _mm_mullo_epi16(Data, Gain);
+    __m128i ProductHigh = _mm_mulhi_epi16(Data, Gain);
+    __m128i Low =
+      _mm_srai_epi32(_mm_unpacklo_epi16(ProductLow, ProductHigh), 15);
+    __m128i High =
+      _mm_srai_epi32(_mm_unpackhi_epi16(ProductLow, ProductHigh), 15);
+    __m128i* pLow = (__m128i*)(pSum + i);
+    __m128i* pHigh = (__m128i*)(pSum + i + 4);
+    _mm_storeu_si128(pLow, _mm_add_epi32(_mm_loadu_si128(pLow), Low));
+    _mm_storeu_si128(pHigh, _mm_add_epi32(_mm_loadu_si128(pHigh), High));
+  }
+  AddScaledScalar(pSum + i, pData + i, Count - i, Gain0, Gain1);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static bool IsBelowKneeSse2(const int* pSum, unsigned Count)
+{
+  const __m128i High = _mm_set1_epi32(SoftClipKnee);
+  const __m128i Low = _mm_set1_epi32(-SoftClipKnee);
+  __m128i Outside = _mm_setzero_si128();
+  unsigned i = 0;
+  for (; i + 4 <= Count; i += 4)
+  {
+    __m128i Sum = _mm_loadu_si128((const __m128i*)(pSum + i));
+    Outside = _mm_or_si128(
+      Outside,
+      _mm_or_si128(_mm_cmpgt_epi32(Sum, High), _mm_cmplt_epi32(Sum, Low)));
+  }
+  return
+    _mm_movemask_epi8(Outside) == 0 &&
+    IsBelowKneeScalar(pSum + i, Count - i);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static void PackSse2(const int* pSum, short* pBuffer, unsigned Count)
+{
+  unsigned i = 0;
+  for (; i + 8 <= Count; i += 8)
+  {
+    __m128i Low = _mm_loadu_si128((const __m128i*)(pSum + i));
+    __m128i High = _mm_loadu_si128((const __m128i*)(pSum + i + 4));
+    _mm_storeu_si128((__m128i*)(pBuffer + i), _mm_packs_epi32(Low, High));
+  }
+  PackScalar(pSum + i, pBuffer + i, Count - i);
+}
+
+#endif // JZ_MIXER_SSE2
+
+#ifdef JZ_MIXER_AVX2
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZ_TARGET_AVX2
+static void AddAvx2(int* pSum, const short* pData, unsigned Count)
+{
+  unsigned i = 0;
+  for (; i + 16 <= Count; i += 16)
+  {
+    __m256i Low = _mm256_cvtepi16_epi32(
+      _mm_loadu_si128((const __m128i*)(pData + i)));
+    __m256i High = _mm256_cvtepi16_epi32(
+      _mm_loadu_si128((const __m128i*)(pData + i + 8)));
+    __m256i* pLow = (__m256i*)(pSum + i);
+    __m256i* pHigh = (__m256i*)(pSum + i + 8);
+    _mm256_storeu_si256(pLow, _mm256_add_epi32(_mm256_loadu_si256(pLow), Low));
+    _mm256_storeu_si256(
+      pHigh,
+      _mm256_add_epi32(_mm256_loadu_si256(pHigh), High));
+  }
+  AddScalar(pSum + i, pData + i, Count - i);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZ_TARGET_AVX2
+static void AddScaledAvx2(
+  int* pSum,
+  const short* pData,
+  unsigned Count,
+  short Gain0,
+  short Gain1)
+{
+  const __m256i Gain = _mm256_setr_epi32(
+    Gain0, Gain1, Gain0, Gain1, Gain0, Gain1, Gain0, Gain1);
+  unsigned i = 0;
+  for (; i + 16 <= Count; i += 16)
+  {
+    __m256i Low = _mm256_cvtepi16_epi32(
+      _mm_loadu_si128((const __m128i*)(pData + i)));
+    __m256i High = _mm256_cvtepi16_epi32(
+      _mm_loadu_si128((const __m128i*)(pData + i + 8)));
+    Low = _mm256_srai_epi32(_mm256_mullo_epi32(Low, Gain), 15);
+    High = _mm256_srai_epi32(_mm256_mullo_epi32(High, Gain), 15);
+    __m256i* pLow = (__m256i*)(pSum + i);
+    __m256i* pHigh = (__m256i*)(pSum + i + 8);
+    _mm256_storeu_si256(pLow, _mm256_add_epi32(_mm256_loadu_si256(pLow), Low));
+    _mm256_storeu_si256(
+      pHigh,
+      _mm256_add_epi32(_mm256_loadu_si256(pHigh), High));
+  }
+  AddScaledScalar(pSum + i, pData + i, Count - i, Gain0, Gain1);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZ_TARGET_AVX2
+static bool IsBelowKneeAvx2(const int* pSum, unsigned Count)
+{
+  const __m256i High = _mm256_set1_epi32(SoftClipKnee);
+  const __m256i Low = _mm256_set1_epi32(-SoftClipKnee);
+  __m256i Outside = _mm256_setzero_si256();
+  unsigned i = 0;
+  for (; i + 8 <= Count; i += 8)
+  {
+    __m256i Sum = _mm256_loadu_si256((const __m256i*)(pSum + i));
+    Outside = _mm256_or_si256(
+      Outside,
+      _mm256_or_si256(
+        _mm256_cmpgt_epi32(Sum, High),
+        _mm256_cmpgt_epi32(Low, Sum)));
+  }
+  return
+    _mm256_testz_si256(Outside, Outside) &&
+    IsBelowKneeScalar(pSum + i, Count - i);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The 256 bit pack works on each 128 bit lane, so the quarters are put
+// back in order afterwards.
+//-----------------------------------------------------------------------------
+JZ_TARGET_AVX2
+static void PackAvx2(const int* pSum, short* pBuffer, unsigned Count)
+{
+  unsigned i = 0;
+  for (; i + 16 <= Count; i += 16)
+  {
+    __m256i Low = _mm256_loadu_si256((const __m256i*)(pSum + i));
+    __m256i High = _mm256_loadu_si256((const __m256i*)(pSum + i + 8));
+    __m256i Packed = _mm256_permute4x64_epi64(
+      _mm256_packs_epi32(Low, High),
+      0xD8);
+    _mm256_storeu_si256((__m256i*)(pBuffer + i), Packed);
+  }
+  PackScalar(pSum + i, pBuffer + i, Count - i);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static bool HasAvx2()
+{
+#if defined(__GNUC__)
+  return __builtin_cpu_supports("avx2");
+#else
+  return true;
+#endif
+}
+
+#endif // JZ_MIXER_AVX2
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Compress the samples above the knee so they approach full scale without
+// reaching it.  The samples up to the knee are unchanged, like in a buffer
+// that Render() packs without the clipper, so every sample gets the same
+// curve whichever way its buffer goes.
+//-----------------------------------------------------------------------------
+static void SoftClip(const int* pSum, short* pBuffer, unsigned Count)
+{
+  for (unsigned i = 0; i < Count; ++i)
+  {
+    int Sample = pSum[i];
+    int Magnitude = Sample < 0 ? -Sample : Sample;
+    if (Magnitude > SoftClipKnee)
+    {
+      double Excess = (double)(Magnitude - SoftClipKnee) / SoftClipRange;
+      Magnitude =
+        SoftClipKnee + (int)(SoftClipRange * Excess / (1.0 + Excess));
+      Sample = Sample < 0 ? -Magnitude : Magnitude;
+    }
+    pBuffer[i] = (short)Sample;
+  }
+}
+
+typedef void (*TFAdd)(int* pSum, const short* pData, unsigned Count);
+typedef void (*TFAddScaled)(
+  int* pSum,
+  const short* pData,
+  unsigned Count,
+  short Gain0,
+  short Gain1);
+typedef bool (*TFIsBelowKnee)(const int* pSum, unsigned Count);
+typedef void (*TFPack)(const int* pSum, short* pBuffer, unsigned Count);
+
+struct JZMixerKernel
+{
+  JZAudioMixer::TEKernel mKernel;
+  TFAdd mpAdd;
+  TFAddScaled mpAddScaled;
+  TFIsBelowKnee mpIsBelowKnee;
+  TFPack mpPack;
+};
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static JZMixerKernel SelectKernel()
+{
+#ifdef JZ_MIXER_AVX2
+  if (HasAvx2())
+  {
+    JZMixerKernel Kernel =
+    {
+      JZAudioMixer::eKernelAvx2,
+      AddAvx2,
+      AddScaledAvx2,
+      IsBelowKneeAvx2,
+      PackAvx2
+    };
+    return Kernel;
+  }
+#endif // JZ_MIXER_AVX2
+
+#ifdef JZ_MIXER_SSE2
+  JZMixerKernel Kernel =
+  {
+    JZAudioMixer::eKernelSse2,
+    AddSse2,
+    AddScaledSse2,
+    IsBelowKneeSse2,
+    PackSse2
+  };
+#else
+  JZMixerKernel Kernel =
+  {
+    JZAudioMixer::eKernelScalar,
+    AddScalar,
+    AddScaledScalar,
+    IsBelowKneeScalar,
+    PackScalar
+  };
+#endif // JZ_MIXER_SSE2
+  return Kernel;
+}
+
+static JZMixerKernel gKernel = SelectKernel();
+
+//*****************************************************************************
+// Description:
+//   This is the audio mixer class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAudioMixer::JZAudioMixer()
+  : mSum(),
+    mSampleCount(0),
+    mClippedBufferCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAudioMixer::Clear(unsigned SampleCount)
+{
+  mSampleCount = SampleCount;
+  mSum.assign(SampleCount, 0);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAudioMixer::Add(const short* pData, unsigned Offset, unsigned Count)
+{
+  if (Offset >= mSampleCount)
+  {
+    return;
+  }
+  if (Count > mSampleCount - Offset)
+  {
+    Count = mSampleCount - Offset;
+  }
+  gKernel.mpAdd(&mSum[Offset], pData, Count);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZAudioMixer::AddScaled(
+  const short* pData,
+  unsigned Offset,
+  unsigned Count,
+  short Gain0,
+  short Gain1)
+{
+  if (Gain0 == UnityGain && Gain1 == UnityGain)
+  {
+    Add(pData, Offset, Count);
+    return;
+  }
+
+  if (Offset >= mSampleCount)
+  {
+    return;
+  }
+  if (Count > mSampleCount - Offset)
+  {
+    Count = mSampleCount - Offset;
+  }
+  gKernel.mpAddScaled(&mSum[Offset], pData, Count, Gain0, Gain1);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZAudioMixer::Render(short* pBuffer)
+{
+  if (mSampleCount == 0)
+  {
+    return false;
+  }
+
+  if (gKernel.mpIsBelowKnee(&mSum[0], mSampleCount))
+  {
+    gKernel.mpPack(&mSum[0], pBuffer, mSampleCount);
+    return false;
+  }
+
+  SoftClip(&mSum[0], pBuffer, mSampleCount);
+  ++mClippedBufferCount;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZAudioMixer::TEKernel JZAudioMixer::GetKernel()
+{
+  return gKernel.mKernel;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZAudioMixer::SetKernel(TEKernel Kernel)
+{
+  switch (Kernel)
+  {
+    case eKernelScalar:
+      gKernel.mpAdd = AddScalar;
+      gKernel.mpAddScaled = AddScaledScalar;
+      gKernel.mpIsBelowKnee = IsBelowKneeScalar;
+      gKernel.mpPack = PackScalar;
+      break;
+
+#ifdef JZ_MIXER_SSE2
+    case eKernelSse2:
+      gKernel.mpAdd = AddSse2;
+      gKernel.mpAddScaled = AddScaledSse2;
+      gKernel.mpIsBelowKnee = IsBelowKneeSse2;
+      gKernel.mpPack = PackSse2;
+      break;
+#endif // JZ_MIXER_SSE2
+
+#ifdef JZ_MIXER_AVX2
+    case eKernelAvx2:
+      if (!HasAvx2())
+      {
+        return false;
+      }
+      gKernel.mpAdd = AddAvx2;
+      gKernel.mpAddScaled = AddScaledAvx2;
+      gKernel.mpIsBelowKnee = IsBelowKneeAvx2;
+      gKernel.mpPack = PackAvx2;
+      break;
+#endif // JZ_MIXER_AVX2
+
+    default:
+      return false;
+  }
+
+  gKernel.mKernel = Kernel;
+  return true;
+}
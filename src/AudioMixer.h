@@ -0,0 +1,102 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   This is the audio mixer class declaration.  The voices of a buffer are
+// summed in 32 bit integers, so an overload does not wrap around.  A voice
+// may be scaled by Q15 gains on the way in.  Render() converts the sum
+// back to 16 bit samples once per buffer: a buffer that stays below the
+// knee of the soft clipper is copied unchanged, any other buffer goes
+// through the soft clipper.  The loops use SSE2 or AVX2 when the processor
+// has them.
+//*****************************************************************************
+class JZAudioMixer
+{
+  public:
+
+    enum TEKernel
+    {
+      eKernelScalar,
+      eKernelSse2,
+      eKernelAvx2
+    };
+
+    // The gain that adds samples unscaled.
+    static const short UnityGain = 32767;
+
+    JZAudioMixer();
+
+    // Start a buffer with the passed number of samples.
+    void Clear(unsigned SampleCount);
+
+    // Add samples to the buffer, starting at the passed offset.
+    void Add(const short* pData, unsigned Offset, unsigned Count);
+
+    // Like Add() but multiply the even samples of pData by Gain0 / 32768 and
+    // the odd ones by Gain1 / 32768, so interleaved stereo data gets a left
+    // and a right gain.  Offset must be even for stereo data.
+    void AddScaled(
+      const short* pData,
+      unsigned Offset,
+      unsigned Count,
+      short Gain0,
+      short Gain1);
+
+    // Write the buffer as 16 bit samples.  Returns true if it went through
+    // the soft clipper.
+    bool Render(short* pBuffer);
+
+    // The number of buffers that went through the soft clipper.
+    unsigned GetClippedBufferCount() const;
+
+    // The loops used by all mixers, the fastest the processor supports
+    // unless another one was selected.
+    static TEKernel GetKernel();
+
+    // Returns false if the processor does not support the kernel.
+    static bool SetKernel(TEKernel Kernel);
+
+  private:
+
+    std::vector<int> mSum;
+
+    unsigned mSampleCount;
+
+    unsigned mClippedBufferCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the audio mixer class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZAudioMixer::GetClippedBufferCount() const
+{
+  return mClippedBufferCount;
+}
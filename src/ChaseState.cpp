@@ -0,0 +1,282 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "ChaseState.h"
+
+#include "Events.h"
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the chase state class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZChaseState::JZParamEvents::JZParamEvents()
+  : mpNumberMsb(0),
+    mpNumberLsb(0),
+    mpDataMsb(0),
+    mpDataLsb(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZChaseState::JZChaseState()
+{
+  Clear();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZChaseState::Clear()
+{
+  for (int Channel = 0; Channel < mChannelCount; ++Channel)
+  {
+    for (int Slot = 0; Slot < eSlotCount; ++Slot)
+    {
+      mpEvents[Channel][Slot] = 0;
+    }
+    mSelections[Channel] = JZParamEvents();
+    mParams[Channel].clear();
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZChaseState::Apply(JZEvent* pEvent)
+{
+  JZChannelEvent* pChannelEvent = pEvent->IsChannelEvent();
+  if (!pChannelEvent || pChannelEvent->GetChannel() >= mChannelCount)
+  {
+    return;
+  }
+
+  int Channel = pChannelEvent->GetChannel();
+  JZEvent** ppEvents = mpEvents[Channel];
+
+  if (pEvent->IsControl())
+  {
+    ApplyControl(Channel, pEvent);
+  }
+  else if (pEvent->IsProgram())
+  {
+    ppEvents[eProgramSlot] = pEvent;
+  }
+  else if (pEvent->IsPitch())
+  {
+    ppEvents[ePitchSlot] = pEvent;
+  }
+  else if (pEvent->IsChnPressure())
+  {
+    ppEvents[eChannelPressureSlot] = pEvent;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZChaseState::GetEvents(vector<JZEvent*>& Events) const
+{
+  for (int Channel = 0; Channel < mChannelCount; ++Channel)
+  {
+    JZEvent* const* ppEvents = mpEvents[Channel];
+
+    if (ppEvents[eBankSelectSlot])
+    {
+      Events.push_back(ppEvents[eBankSelectSlot]);
+    }
+    if (ppEvents[eBankSelectLsbSlot])
+    {
+      Events.push_back(ppEvents[eBankSelectLsbSlot]);
+    }
+    if (ppEvents[eProgramSlot])
+    {
+      Events.push_back(ppEvents[eProgramSlot]);
+    }
+
+    for (int Slot = 0; Slot < eProgramSlot; ++Slot)
+    {
+      if (
+        ppEvents[Slot] &&
+        Slot != eBankSelectSlot &&
+        Slot != eBankSelectLsbSlot)
+      {
+        Events.push_back(ppEvents[Slot]);
+      }
+    }
+
+    for (
+      map<int, JZParamEvents>::const_iterator iParam =
+        mParams[Channel].begin();
+      iParam != mParams[Channel].end();
+      ++iParam)
+    {
+      AppendParam(iParam->second, Events);
+    }
+    AppendParam(mSelections[Channel], Events);
+
+    if (ppEvents[ePitchSlot])
+    {
+      Events.push_back(ppEvents[ePitchSlot]);
+    }
+    if (ppEvents[eChannelPressureSlot])
+    {
+      Events.push_back(ppEvents[eChannelPressureSlot]);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Reset all controllers resets the controllers as in the General MIDI
+// recommended practice RP-015: all but bank select, volume and pan, and
+// the parameter selection.  The parameter values stay.
+//-----------------------------------------------------------------------------
+void JZChaseState::ApplyControl(int Channel, JZEvent* pEvent)
+{
+  JZEvent** ppEvents = mpEvents[Channel];
+  JZParamEvents& Selection = mSelections[Channel];
+  int Control = pEvent->IsControl()->GetControl() & 0x7f;
+
+  switch (Control)
+  {
+    case 0x06:
+    case 0x26:
+      {
+        // A parameter that was not selected, or the null RPN, ignores
+        // data entry.
+        if (!Selection.mpNumberMsb && !Selection.mpNumberLsb)
+        {
+          return;
+        }
+        int Type = 0;
+        int Msb = 0x80;
+        int Lsb = 0x80;
+        if (Selection.mpNumberMsb)
+        {
+          Type = Selection.mpNumberMsb->IsControl()->GetControl();
+          Msb = Selection.mpNumberMsb->IsControl()->GetControlValue();
+        }
+        if (Selection.mpNumberLsb)
+        {
+          Type = Selection.mpNumberLsb->IsControl()->GetControl() + 1;
+          Lsb = Selection.mpNumberLsb->IsControl()->GetControlValue();
+        }
+        if (Type == 0x65 && Msb == 0x7f && Lsb == 0x7f)
+        {
+          return;
+        }
+
+        int Key = (Type * 256 + Msb) * 256 + Lsb;
+        JZParamEvents& Param = mParams[Channel][Key];
+        Param.mpNumberMsb = Selection.mpNumberMsb;
+        Param.mpNumberLsb = Selection.mpNumberLsb;
+        if (Control == 0x06)
+        {
+          Param.mpDataMsb = pEvent;
+        }
+        else
+        {
+          Param.mpDataLsb = pEvent;
+        }
+      }
+      return;
+
+    case 0x62:
+    case 0x64:
+      // An NRPN number after an RPN number, or the other way round, starts
+      // a new selection.
+      if (
+        Selection.mpNumberMsb &&
+        Selection.mpNumberMsb->IsControl()->GetControl() != Control + 1)
+      {
+        Selection.mpNumberMsb = 0;
+      }
+      Selection.mpNumberLsb = pEvent;
+      return;
+
+    case 0x63:
+    case 0x65:
+      if (
+        Selection.mpNumberLsb &&
+        Selection.mpNumberLsb->IsControl()->GetControl() != Control - 1)
+      {
+        Selection.mpNumberLsb = 0;
+      }
+      Selection.mpNumberMsb = pEvent;
+      return;
+
+    case 0x60:
+    case 0x61:
+      // Data increment and decrement change the value relative to the
+      // current one, so they cannot be sent again.
+      return;
+
+    case 0x79:
+      for (int Slot = 0; Slot < eProgramSlot; ++Slot)
+      {
+        if (
+          Slot != eBankSelectSlot &&
+          Slot != eBankSelectLsbSlot &&
+          Slot != 0x07 &&
+          Slot != 0x0a)
+        {
+          ppEvents[Slot] = 0;
+        }
+      }
+      ppEvents[ePitchSlot] = 0;
+      ppEvents[eChannelPressureSlot] = 0;
+      Selection = JZParamEvents();
+      return;
+  }
+
+  // The other channel mode messages do not change the chased state.
+  if (Control < 0x78)
+  {
+    ppEvents[Control] = pEvent;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZChaseState::AppendParam(
+  const JZParamEvents& Param,
+  vector<JZEvent*>& Events)
+{
+  if (Param.mpNumberMsb)
+  {
+    Events.push_back(Param.mpNumberMsb);
+  }
+  if (Param.mpNumberLsb)
+  {
+    Events.push_back(Param.mpNumberLsb);
+  }
+  if (Param.mpDataMsb)
+  {
+    Events.push_back(Param.mpDataMsb);
+  }
+  if (Param.mpDataLsb)
+  {
+    Events.push_back(Param.mpDataLsb);
+  }
+}
@@ -0,0 +1,102 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+class JZEvent;
+
+//*****************************************************************************
+// Description:
+//   This is the chase state class declaration.  A chase state remembers the
+// last program change, controller, pitch bend and channel pressure event of
+// every MIDI channel, so the channel state at some position in a song can
+// be sent to the devices before playback starts there.  The events are not
+// owned by the chase state.
+//
+//   Data entry is remembered for every RPN and NRPN parameter, with the
+// controllers that selected the parameter.  Data increment and decrement
+// and the channel mode messages are not chased; reset all controllers
+// forgets the controllers it resets.
+//*****************************************************************************
+class JZChaseState
+{
+  public:
+
+    JZChaseState();
+
+    void Clear();
+
+    // Remember the event if it changes the channel state.
+    void Apply(JZEvent* pEvent);
+
+    // Append the remembered events in the order they should be sent: bank
+    // select, program change, the other controllers, the data entry of
+    // every parameter after the controllers that select it, the parameter
+    // selected last, pitch bend and channel pressure.  Applying them to a
+    // cleared chase state gives the same state again, except that a channel
+    // without a selected parameter then has the last one sent selected.
+    void GetEvents(std::vector<JZEvent*>& Events) const;
+
+  private:
+
+    enum TEChaseSlot
+    {
+      eBankSelectSlot = 0,
+      eBankSelectLsbSlot = 32,
+      eProgramSlot = 128,
+      ePitchSlot,
+      eChannelPressureSlot,
+      eSlotCount
+    };
+
+    // The controllers that select an RPN or NRPN parameter, and its data
+    // entry controllers.
+    struct JZParamEvents
+    {
+      JZParamEvents();
+
+      JZEvent* mpNumberMsb;
+      JZEvent* mpNumberLsb;
+      JZEvent* mpDataMsb;
+      JZEvent* mpDataLsb;
+    };
+
+    static const int mChannelCount = 16;
+
+    void ApplyControl(int Channel, JZEvent* pEvent);
+
+    static void AppendParam(
+      const JZParamEvents& Param,
+      std::vector<JZEvent*>& Events);
+
+    JZEvent* mpEvents[mChannelCount][eSlotCount];
+
+    // The parameter selected last by each channel.  Its data entry
+    // controllers are not used.
+    JZParamEvents mSelections[mChannelCount];
+
+    // The parameters by channel, keyed by type and parameter number.
+    std::map<int, JZParamEvents> mParams[mChannelCount];
+};
@@ -294,9 +294,63 @@ JZConfiguration::JZConfiguration()
   mNames[C_ThruInput] = new JZConfigurationEntry(".thru_input", 0);
   mNames[C_ThruOutput] = new JZConfigurationEntry(".thru_output", 0);
 
+  // SCHED_FIFO priority of the ALSA MIDI thru thread (0 = normal priority).
+  mNames[C_ThruPriority] = new JZConfigurationEntry(".thru_priority", 0);
+
   // Enable/disable splash dialog.
   mNames[C_EnableWelcome] = new JZConfigurationEntry(".enable_welcome", 1);
 
+  // How many milliseconds events are sent ahead of time during playback.
+  mNames[C_PlaybackLatency] = new JZConfigurationEntry(
+    ".playback_latency",
+    250);
+
+  // ALSA output device for MIDI clock and MTC (-1 = the output device).
+  mNames[C_SyncOutputDevice] = new JZConfigurationEntry(
+    ".sync_output_device",
+    -1);
+
+  // SCHED_FIFO priority of the ALSA sync thread (0 = normal priority).
+  mNames[C_SyncPriority] = new JZConfigurationEntry(".sync_priority", 0);
+
+  // Send all setup data when playback starts (0 = only what changed).
+  mNames[C_ResendSetup] = new JZConfigurationEntry(".resend_setup", 0);
+
+  // Pace SysEx output to this many bytes per second (0 = not paced) with
+  // at least this many milliseconds between two messages.
+  mNames[C_SysExRate] = new JZConfigurationEntry(".sysex_rate", 3125);
+  mNames[C_SysExGap] = new JZConfigurationEntry(".sysex_gap", 20);
+
+  // Wait at most this many milliseconds for the setup before playback
+  // starts (0 = until all of it was sent).
+  mNames[C_SysExSetupWait] = new JZConfigurationEntry(
+    ".sysex_setup_wait",
+    2000);
+
+  // Send the events of a track to the ALSA output device selected for the
+  // track, each device through a worker thread of its own (0 = send all
+  // events to the ALSA output device).
+  mNames[C_AlsaMultiPort] = new JZConfigurationEntry(".alsa_multi_port", 0);
+
+  // The host and UDP port of midinetd for the midinet driver.
+  mNames[C_MidiNetHost] = new JZConfigurationEntry(
+    ".midinet_host",
+    "127.0.0.1");
+  mNames[C_MidiNetPort] = new JZConfigurationEntry(".midinet_port", 5044);
+
+  // The SCHED_FIFO priority of the ALSA audio render thread (0 means normal
+  // priority).
+  mNames[C_AudioPriority] = new JZConfigurationEntry(".audio_priority", 0);
+
+  // The number of audio samples that may sound at once.
+  mNames[C_AudioPolyphony] = new JZConfigurationEntry(".audio_polyphony", 100);
+
+  // The size in kilobytes above which samples are streamed from the disk (0
+  // means never).
+  mNames[C_AudioStreamThreshold] = new JZConfigurationEntry(
+    ".audio_stream_threshold",
+    8192);
+
   // Other initialization.
 
   for (int i = 0; i < 130; ++i)
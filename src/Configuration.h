@@ -104,7 +104,21 @@ enum TEConfigurationNames
   C_DuplexAudio,
   C_ThruInput,
   C_ThruOutput,
+  C_ThruPriority,
   C_EnableWelcome,
+  C_PlaybackLatency,
+  C_SyncOutputDevice,
+  C_SyncPriority,
+  C_ResendSetup,
+  C_SysExRate,
+  C_SysExGap,
+  C_SysExSetupWait,
+  C_AlsaMultiPort,
+  C_MidiNetHost,
+  C_MidiNetPort,
+  C_AudioPriority,
+  C_AudioPolyphony,
+  C_AudioStreamThreshold,
   NumConfigNames
 };
 
@@ -125,7 +139,8 @@ enum TEMidiDriver
 {
   eMidiDriverJazz = 0, // C_DRV_JAZZ  0
   eMidiDriverOss = 1,  // C_DRV_OSS   1
-  eMidiDriverAlsa = 2  // C_DRV_ALSA  2
+  eMidiDriverAlsa = 2, // C_DRV_ALSA  2
+  eMidiDriverNet = 3   // midinetd over UDP
 };
 
 //*****************************************************************************
@@ -0,0 +1,311 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "DeviceStateCache.h"
+
+#include "Events.h"
+#include "Track.h"
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the device state cache class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZDeviceStateCache::JZDeviceState::JZDeviceState()
+  : mParams(),
+    mSysExData()
+{
+  for (int Channel = 0; Channel < 16; ++Channel)
+  {
+    for (int Control = 0; Control < 128; ++Control)
+    {
+      mControls[Channel][Control] = eUnknown;
+    }
+    mPrograms[Channel] = eUnknown;
+    mPitches[Channel] = eUnknown;
+    mPressures[Channel] = eUnknown;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZDeviceStateCache::JZDeviceStateCache()
+  : mStates()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZDeviceStateCache::Clear()
+{
+  mStates.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The parameter number and data entry controllers only take effect
+// together, so they are never shadowed on their own.  A bank select only
+// takes effect with the next program change, so a changed bank makes the
+// program unknown.
+//-----------------------------------------------------------------------------
+bool JZDeviceStateCache::Update(int Device, JZEvent* pEvent)
+{
+  JZChannelEvent* pChannelEvent = pEvent->IsChannelEvent();
+  if (pChannelEvent)
+  {
+    int Channel = pChannelEvent->GetChannel() & 0x0f;
+    switch (pEvent->GetStat())
+    {
+      case StatControl:
+        {
+          JZControlEvent* pControl = pEvent->IsControl();
+          JZDeviceState& State = GetState(Device);
+          if (pControl->GetControl() >= 0x78)
+          {
+            // Reset all controllers, the other channel mode messages do
+            // not change the shadowed state.
+            if (pControl->GetControl() == 0x79)
+            {
+              ForgetControls(State, Channel);
+            }
+            return true;
+          }
+          switch (pControl->GetControl())
+          {
+            case 0x06:
+            case 0x26:
+            case 0x60:
+            case 0x61:
+              ForgetParams(State, Channel);
+              return true;
+            case 0x62:
+            case 0x63:
+            case 0x64:
+            case 0x65:
+              return true;
+            case 0x00:
+            case 0x20:
+              if (
+                Set(
+                  State.mControls[Channel][pControl->GetControl()],
+                  pControl->GetControlValue()))
+              {
+                State.mPrograms[Channel] = eUnknown;
+                return true;
+              }
+              return false;
+          }
+          return Set(
+            State.mControls[Channel][pControl->GetControl() & 0x7f],
+            pControl->GetControlValue());
+        }
+
+      case StatProgram:
+        return Set(GetState(Device).mPrograms[Channel], pEvent->GetValue());
+
+      case StatPitch:
+        return Set(GetState(Device).mPitches[Channel], pEvent->GetValue());
+
+      case StatChnPressure:
+        return Set(GetState(Device).mPressures[Channel], pEvent->GetValue());
+    }
+    return true;
+  }
+
+  JZSysExEvent* pSysEx = pEvent->IsSysEx();
+  if (pSysEx)
+  {
+    return UpdateSysEx(
+      GetState(Device),
+      pSysEx->GetData(),
+      pSysEx->GetDataLength());
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZDeviceStateCache::Update(int Device, JZParam* pParam)
+{
+  int Channel = pParam->mMsb.GetChannel() & 0x0f;
+  int Key =
+    ((Channel * 128 + pParam->mMsb.GetControl()) * 128 +
+      pParam->mMsb.GetControlValue()) * 128 +
+    pParam->mLsb.GetControlValue();
+  int Value = pParam->mDataMsb.GetControlValue();
+
+  JZDeviceState& State = GetState(Device);
+  map<int, int>::iterator iParam = State.mParams.find(Key);
+  if (iParam != State.mParams.end() && iParam->second == Value)
+  {
+    return false;
+  }
+  State.mParams[Key] = Value;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZDeviceStateCache::JZDeviceState& JZDeviceStateCache::GetState(int Device)
+{
+  if (Device < 0)
+  {
+    Device = 0;
+  }
+  if (static_cast<unsigned>(Device) >= mStates.size())
+  {
+    mStates.resize(Device + 1);
+  }
+  return mStates[Device];
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZDeviceStateCache::Set(int& Shadow, int Value)
+{
+  if (Shadow == Value)
+  {
+    return false;
+  }
+  Shadow = Value;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The data passed excludes the leading 0xf0.  Roland data set messages
+// (41 dd mm 12 a1 a2 a3 ...) and Yamaha XG parameter changes
+// (43 1n 4c a1 a2 a3 ...) are keyed by everything up to the address.  The
+// GS reset and XG System On have the same form, but reset the device.
+//-----------------------------------------------------------------------------
+bool JZDeviceStateCache::UpdateSysEx(
+  JZDeviceState& State,
+  const unsigned char* pData,
+  int Length)
+{
+  if (IsReset(pData, Length))
+  {
+    State = JZDeviceState();
+    return true;
+  }
+
+  int KeyLength = 0;
+  if (Length > 7 && pData[0] == 0x41 && pData[3] == 0x12)
+  {
+    KeyLength = 7;
+  }
+  else if (
+    Length > 6 &&
+    pData[0] == 0x43 &&
+    (pData[1] & 0xf0) == 0x10 &&
+    pData[2] == 0x4c)
+  {
+    KeyLength = 6;
+  }
+
+  if (KeyLength == 0)
+  {
+    State = JZDeviceState();
+    return true;
+  }
+
+  string Key(reinterpret_cast<const char*>(pData), KeyLength);
+  string Data(
+    reinterpret_cast<const char*>(pData) + KeyLength,
+    Length - KeyLength);
+
+  map<string, string>::iterator iData = State.mSysExData.find(Key);
+  if (iData != State.mSysExData.end() && iData->second == Data)
+  {
+    return false;
+  }
+  State.mSysExData[Key] = Data;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The data passed excludes the leading 0xf0.  Recognizes GM System On and
+// Off and GM2 System On (7e dd 09 nn), the GS reset and system mode set of
+// the SC-88 (41 dd 42 12 40 00 7f and 41 dd 42 12 00 00 7f), and XG System
+// On and XG All Parameter Reset (43 1n 4c 00 00 7e and 43 1n 4c 00 00 7f).
+//-----------------------------------------------------------------------------
+bool JZDeviceStateCache::IsReset(const unsigned char* pData, int Length)
+{
+  if (Length >= 4 && pData[0] == 0x7e && pData[2] == 0x09)
+  {
+    return true;
+  }
+  if (
+    Length >= 7 &&
+    pData[0] == 0x41 &&
+    pData[2] == 0x42 &&
+    pData[3] == 0x12 &&
+    (pData[4] == 0x40 || pData[4] == 0x00) &&
+    pData[5] == 0x00 &&
+    pData[6] == 0x7f)
+  {
+    return true;
+  }
+  if (
+    Length >= 6 &&
+    pData[0] == 0x43 &&
+    (pData[1] & 0xf0) == 0x10 &&
+    pData[2] == 0x4c &&
+    pData[3] == 0x00 &&
+    pData[4] == 0x00 &&
+    (pData[5] == 0x7e || pData[5] == 0x7f))
+  {
+    return true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Which controllers a reset all controllers message resets depends on the
+// device, so all of them are forgotten, but not the program.
+//-----------------------------------------------------------------------------
+void JZDeviceStateCache::ForgetControls(JZDeviceState& State, int Channel)
+{
+  for (int Control = 0; Control < 128; ++Control)
+  {
+    State.mControls[Channel][Control] = eUnknown;
+  }
+  State.mPitches[Channel] = eUnknown;
+  State.mPressures[Channel] = eUnknown;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZDeviceStateCache::ForgetParams(JZDeviceState& State, int Channel)
+{
+  int First = Channel * 128 * 128 * 128;
+  int Last = (Channel + 1) * 128 * 128 * 128;
+  State.mParams.erase(
+    State.mParams.lower_bound(First),
+    State.mParams.lower_bound(Last));
+}
@@ -0,0 +1,106 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+class JZEvent;
+class JZParam;
+
+//*****************************************************************************
+// Description:
+//   This is the device state cache class declaration.  It shadows the state
+// last sent to every output device: controllers, programs, NRPN and RPN
+// values, pitch bend and channel pressure of each channel, and the data of
+// Roland and Yamaha XG parameter change SysEx messages.  StartPlay() uses it
+// to skip the setup data a device already has.
+//
+//   Everything sent to a device has to be passed to Update(), otherwise the
+// shadow goes stale.  Data entry controllers sent on their own forget the
+// NRPN and RPN values of their channel, reset all controllers forgets the
+// controllers of its channel, and a GM, GS or XG reset or any other SysEx
+// message forgets the whole device.  Changes the player does not send, by
+// hardware thru or at the device itself, are not seen; Clear() forgets
+// everything.
+//*****************************************************************************
+class JZDeviceStateCache
+{
+  public:
+
+    JZDeviceStateCache();
+
+    void Clear();
+
+    // Record an event sent to the passed device.  Returns false if the
+    // device already had the state the event sets.
+    bool Update(int Device, JZEvent* pEvent);
+
+    // Same as above for an NRPN or RPN value, which is sent as three
+    // controllers.
+    bool Update(int Device, JZParam* pParam);
+
+  private:
+
+    enum
+    {
+      eUnknown = -1
+    };
+
+    struct JZDeviceState
+    {
+      JZDeviceState();
+
+      int mControls[16][128];
+      int mPrograms[16];
+      int mPitches[16];
+      int mPressures[16];
+
+      // NRPN and RPN values by channel, type and parameter number.
+      std::map<int, int> mParams;
+
+      // SysEx data by manufacturer, device, model and address.
+      std::map<std::string, std::string> mSysExData;
+    };
+
+    JZDeviceState& GetState(int Device);
+
+    static bool Set(int& Shadow, int Value);
+
+    static bool UpdateSysEx(
+      JZDeviceState& State,
+      const unsigned char* pData,
+      int Length);
+
+    // Whether the SysEx data is a GM, GS or XG reset.
+    static bool IsReset(const unsigned char* pData, int Length);
+
+    static void ForgetControls(JZDeviceState& State, int Channel);
+
+    static void ForgetParams(JZDeviceState& State, int Channel);
+
+  private:
+
+    std::vector<JZDeviceState> mStates;
+};
@@ -23,8 +23,10 @@
 #include "../Events.h"
 #include "../Globals.h"
 #include "../Help.h"
+#include "../Player.h"
 #include "../Project.h"
 #include "../Resources.h"
+#include "../Synth.h"
 
 #include <wx/button.h>
 #include <wx/sizer.h>
@@ -32,6 +34,7 @@
 #include <wx/textctrl.h>
 
 #include <sstream>
+#include <vector>
 
 using namespace std;
 
@@ -41,6 +44,10 @@ using namespace std;
 //-----------------------------------------------------------------------------
 BEGIN_EVENT_TABLE(JZSysexDialog, wxDialog)
 
+  EVT_BUTTON(IDC_BN_SYSEX_SEND, JZSysexDialog::OnSend)
+
+  EVT_THREAD(wxID_ANY, JZSysexDialog::OnSent)
+
   EVT_BUTTON(wxID_HELP, JZSysexDialog::OnHelp)
 
 END_EVENT_TABLE()
@@ -53,13 +60,19 @@ JZSysexDialog::JZSysexDialog(
   wxWindow* pParent)
   : wxDialog(pParent, wxID_ANY, wxString("System Exclusive")),
     mpSysExEvent(pSysExEvent),
+    mpTrack(pTrack),
+    mPendingCount(0),
     mpSysExEdit(nullptr),
-    mpClockEdit(nullptr)
+    mpClockEdit(nullptr),
+    mpStatusText(nullptr)
 {
   mpSysExEdit = new wxTextCtrl(this, wxID_ANY);
 
   mpClockEdit = new wxTextCtrl(this, wxID_ANY);
 
+  mpStatusText = new wxStaticText(this, wxID_ANY, wxEmptyString);
+
+  wxButton* pSendButton = new wxButton(this, IDC_BN_SYSEX_SEND, "&Send");
   wxButton* pOkButton = new wxButton(this, wxID_OK, "&OK");
   wxButton* pCancelButton = new wxButton(this, wxID_CANCEL, "Cancel");
   wxButton* pHelpButton = new wxButton(this, wxID_HELP, "Help");
@@ -103,7 +116,10 @@ JZSysexDialog::JZSysexDialog(
 
   pTopSizer->Add(pFlexGridSizer, 0, wxCENTER | wxALL, 2);
 
+  pTopSizer->Add(mpStatusText, 0, wxEXPAND | wxALL, 5);
+
   wxBoxSizer* pButtonSizer = new wxBoxSizer(wxHORIZONTAL);
+  pButtonSizer->Add(pSendButton, 0, wxALL, 5);
   pButtonSizer->Add(pOkButton, 0, wxALL, 5);
   pButtonSizer->Add(pCancelButton, 0, wxALL, 5);
   pButtonSizer->Add(pHelpButton, 0, wxALL, 5);
@@ -117,6 +133,24 @@ JZSysexDialog::JZSysexDialog(
   pTopSizer->Fit(this);
 }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSysexDialog::~JZSysexDialog()
+{
+  gpMidiPlayer->RemoveSysExListener(this);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Hand the notification over to the GUI thread.
+//-----------------------------------------------------------------------------
+void JZSysexDialog::OnSysExSent(int Id)
+{
+  wxThreadEvent* pEvent = new wxThreadEvent();
+  pEvent->SetInt(Id);
+  wxQueueEvent(this, pEvent);
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 bool JZSysexDialog::TransferDataToWindow()
@@ -201,6 +235,77 @@ bool JZSysexDialog::TransferDataFromWindow()
   return true;
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Send the message in the edit control to the device of the track.  It is
+// sent in the background, so the dialog stays usable while a large message
+// goes out.
+//-----------------------------------------------------------------------------
+void JZSysexDialog::OnSend(wxCommandEvent& Event)
+{
+  istringstream Iss(mpSysExEdit->GetValue().ToStdString());
+  vector<unsigned char> Data;
+  unsigned Byte;
+  while (Iss >> hex >> Byte)
+  {
+    if (Byte > 0xFF)
+    {
+      break;
+    }
+    Data.push_back(Byte);
+  }
+
+  if (
+    !Iss.eof() ||
+    Data.size() < 2 ||
+    Data.front() != 0xF0 ||
+    Data.back() != 0xF7)
+  {
+    mpStatusText->SetLabel("Enter hex bytes from f0 to f7");
+    return;
+  }
+  for (size_t i = 1; i + 1 < Data.size(); ++i)
+  {
+    if (Data[i] & 0x80)
+    {
+      mpStatusText->SetLabel("Only the first and last byte may exceed 7f");
+      return;
+    }
+  }
+
+  // The event data starts after the 0xF0.
+  JZSysExEvent SysEx(0, &Data[1], Data.size() - 1);
+  if (SysEx.GetDataLength() >= 4)
+  {
+    gpSynth->FixSysexCheckSum(&SysEx);
+  }
+
+  ++mPendingCount;
+  mpStatusText->SetLabel("Sending...");
+  gpMidiPlayer->SendSysEx(mpTrack->GetDevice(), &SysEx, this);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSysexDialog::OnSent(wxThreadEvent& Event)
+{
+  if (mPendingCount > 0)
+  {
+    --mPendingCount;
+  }
+
+  if (mPendingCount > 0)
+  {
+    ostringstream Oss;
+    Oss << mPendingCount << " still waiting";
+    mpStatusText->SetLabel(Oss.str());
+  }
+  else
+  {
+    mpStatusText->SetLabel("Sent");
+  }
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void JZSysexDialog::OnHelp(wxCommandEvent& Event)
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "../SysExSender.h"
+
 #include <wx/dialog.h>
 
 class JZKnob;
@@ -31,7 +33,7 @@ class wxTextCtrl;
 
 //*****************************************************************************
 //*****************************************************************************
-class JZSysexDialog : public wxDialog
+class JZSysexDialog : public wxDialog, public JZSysExListener
 {
   public:
 
@@ -40,20 +42,36 @@ class JZSysexDialog : public wxDialog
       JZTrack* pTrack,
       wxWindow* pParent);
 
+    virtual ~JZSysexDialog();
+
+    // Called by the SysEx sender thread.
+    virtual void OnSysExSent(int Id);
+
   private:
 
     virtual bool TransferDataToWindow();
 
     virtual bool TransferDataFromWindow();
 
+    void OnSend(wxCommandEvent& Event);
+
+    void OnSent(wxThreadEvent& Event);
+
     void OnHelp(wxCommandEvent& Event);
 
   private:
 
     JZSysExEvent* mpSysExEvent;
 
+    JZTrack* mpTrack;
+
+    // The number of messages sent with the Send button that did not go out
+    // yet.
+    int mPendingCount;
+
     wxTextCtrl* mpSysExEdit;
     wxTextCtrl* mpClockEdit;
+    wxStaticText* mpStatusText;
 
   DECLARE_EVENT_TABLE();
 };
@@ -22,10 +22,13 @@
 
 #include "JazzPlusPlusApplication.h"
 
+#include "AudioMixer.h"
 #include "Globals.h"
 #include "Help.h"
+#include "OfflinePlayer.h"
 #include "Project.h"
 #include "ProjectManager.h"
+#include "StandardFile.h"
 #include "TrackFrame.h"
 
 #ifdef _MSC_VER
@@ -48,11 +51,16 @@
 
 #endif
 
+#include <wx/cmdline.h>
 #include <wx/stdpaths.h>
 #include <wx/fileconf.h>
 #include <wx/image.h>
 #include <wx/msgdlg.h>
+#include <wx/stopwatch.h>
 
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
 #include <vector>
 
 using namespace std;
@@ -76,7 +84,13 @@ IMPLEMENT_APP(JZJazzPlusPlusApplication)
 JZJazzPlusPlusApplication::JZJazzPlusPlusApplication()
   : wxApp(),
     mpProject(nullptr),
-    mpTrackFrame(nullptr)
+    mpTrackFrame(nullptr),
+    mRenderFileName(),
+    mRenderLogFileName(),
+    mRenderToClock(-1),
+    mRenderLoopClock(0),
+    mIsMixerBenchmark(false),
+    mExitCode(-1)
 {
   // When using the Microsoft C++ compiler in debug mode, each heap allocation
   // (i.e. calling new) is counted. The following line will cause the code to
@@ -131,10 +145,22 @@ bool JZJazzPlusPlusApplication::OnInit()
 
   InsureConfigurationFileExistence();
 
+  if (mIsMixerBenchmark)
+  {
+    mExitCode = BenchmarkMixer();
+    return true;
+  }
+
   // Create the one and only top-level Jazz++ project.
   mpProject = new JZProject;
   gpProject = mpProject;
 
+  if (!mRenderFileName.empty())
+  {
+    mExitCode = Render();
+    return true;
+  }
+
   // Create the main application window.
   mpTrackFrame = JZProjectManager::Instance().CreateTrackView();
 
@@ -148,6 +174,199 @@ bool JZJazzPlusPlusApplication::OnInit()
   return true;
 }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZJazzPlusPlusApplication::OnRun()
+{
+  if (mExitCode >= 0)
+  {
+    return mExitCode;
+  }
+  return wxApp::OnRun();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZJazzPlusPlusApplication::OnInitCmdLine(wxCmdLineParser& Parser)
+{
+  wxApp::OnInitCmdLine(Parser);
+
+  Parser.AddOption(
+    "",
+    "render",
+    "play a MIDI file offline as fast as possible and exit");
+  Parser.AddOption(
+    "",
+    "render-log",
+    "write the events played offline to this file");
+  Parser.AddOption(
+    "",
+    "render-to",
+    "stop playing offline at this clock",
+    wxCMD_LINE_VAL_NUMBER);
+  Parser.AddOption(
+    "",
+    "render-loop",
+    "loop from the start to this clock when playing offline",
+    wxCMD_LINE_VAL_NUMBER);
+  Parser.AddSwitch(
+    "",
+    "mixer-benchmark",
+    "time the audio mixer with every supported kernel and exit");
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZJazzPlusPlusApplication::OnCmdLineParsed(wxCmdLineParser& Parser)
+{
+  if (!wxApp::OnCmdLineParsed(Parser))
+  {
+    return false;
+  }
+
+  Parser.Found("render", &mRenderFileName);
+  Parser.Found("render-log", &mRenderLogFileName);
+  Parser.Found("render-to", &mRenderToClock);
+  Parser.Found("render-loop", &mRenderLoopClock);
+  mIsMixerBenchmark = Parser.Found("mixer-benchmark");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The song is read into the project, so the playback path sees the same
+// track settings (mute, solo, play tracks) as it would when playing
+// interactively.  The report goes to standard output in the same "name
+// value" format as the playback statistics.
+//-----------------------------------------------------------------------------
+int JZJazzPlusPlusApplication::Render()
+{
+  if (!wxFileExists(mRenderFileName))
+  {
+    cerr << "Unable to find \"" << mRenderFileName << '"' << endl;
+    return 1;
+  }
+
+  JZStandardRead Io;
+  mpProject->Clear();
+  mpProject->Read(Io, string(mRenderFileName.mb_str()));
+
+  int ToClock = mRenderToClock;
+  if (ToClock < 0)
+  {
+    ToClock = mpProject->GetLastClock() + 4 * mpProject->GetTicksPerQuarter();
+  }
+
+  JZOfflinePlayer Player(mpProject);
+
+  wxStopWatch StopWatch;
+  Player.Run(0, ToClock, mRenderLoopClock);
+  long Milliseconds = StopWatch.Time();
+
+  cout
+    << "clocks " << ToClock << '\n'
+    << "logged_events " << Player.GetLog().size() << '\n'
+    << "milliseconds " << Milliseconds << '\n';
+  Player.GetStatistics().Write(cout);
+  cout.flush();
+
+  if (!mRenderLogFileName.empty())
+  {
+    ofstream Ofs(mRenderLogFileName.mb_str());
+    Player.WriteLog(Ofs);
+    if (!Ofs)
+    {
+      cerr
+        << "Unable to write \"" << mRenderLogFileName << '"'
+        << endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Mix the same random voices with every kernel the processor supports,
+// once unscaled and once with the gains of a panned voice, and report the
+// time per buffer in the same "name value" format as Render().  The
+// checksums of the last buffer show whether the kernels mix identically.
+//-----------------------------------------------------------------------------
+int JZJazzPlusPlusApplication::BenchmarkMixer()
+{
+  const unsigned VoiceCount = 100;
+  const unsigned SampleCount = 4096;
+  const int BufferCount = 1000;
+  static const char* KernelNames[] = { "scalar", "sse2", "avx2" };
+
+  vector<short> Voices(VoiceCount * SampleCount);
+  srand(1);
+  for (unsigned i = 0; i < Voices.size(); ++i)
+  {
+    Voices[i] = static_cast<short>(rand() % 601 - 300);
+  }
+  vector<short> Buffer(SampleCount);
+
+  cout
+    << "mixer_voices " << VoiceCount << '\n'
+    << "mixer_samples " << SampleCount << '\n';
+
+  JZAudioMixer::TEKernel DefaultKernel = JZAudioMixer::GetKernel();
+  for (int Kernel = 0; Kernel < 3; ++Kernel)
+  {
+    if (!JZAudioMixer::SetKernel(static_cast<JZAudioMixer::TEKernel>(Kernel)))
+    {
+      continue;
+    }
+
+    for (int IsScaled = 0; IsScaled < 2; ++IsScaled)
+    {
+      JZAudioMixer Mixer;
+      wxStopWatch StopWatch;
+      for (int i = 0; i < BufferCount; ++i)
+      {
+        Mixer.Clear(SampleCount);
+        for (unsigned Voice = 0; Voice < VoiceCount; ++Voice)
+        {
+          const short* pData = &Voices[Voice * SampleCount];
+          if (IsScaled)
+          {
+            Mixer.AddScaled(pData, 0, SampleCount, 16384, 28377);
+          }
+          else
+          {
+            Mixer.Add(pData, 0, SampleCount);
+          }
+        }
+        Mixer.Render(&Buffer[0]);
+      }
+      long Milliseconds = StopWatch.Time();
+
+      unsigned Checksum = 0;
+      for (unsigned i = 0; i < SampleCount; ++i)
+      {
+        Checksum = Checksum * 31 + static_cast<unsigned short>(Buffer[i]);
+      }
+
+      string Name =
+        string("mixer_") + KernelNames[Kernel] + (IsScaled ? "_scaled" : "");
+      cout
+        << Name << "_microseconds " << 1000.0 * Milliseconds / BufferCount
+        << '\n'
+        << Name << "_clipped_buffers " << Mixer.GetClippedBufferCount()
+        << '\n'
+        << Name << "_checksum " << Checksum << '\n';
+    }
+  }
+  JZAudioMixer::SetKernel(DefaultKernel);
+
+  cout.flush();
+
+  return 0;
+}
+
 //-----------------------------------------------------------------------------
 // Description:
 //   This function checks to see if the user's Jazz++ configuration directory
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <wx/app.h>
+#include <wx/string.h>
 
 class JZProject;
 class JZTrackFrame;
@@ -48,6 +49,15 @@ class JZJazzPlusPlusApplication : public wxApp
 
     virtual int OnExit();
 
+    // Description:
+    //   Run the event loop, unless a song was played offline or the mixer
+    // was timed from the command line.
+    virtual int OnRun();
+
+    virtual void OnInitCmdLine(wxCmdLineParser& Parser);
+
+    virtual bool OnCmdLineParsed(wxCmdLineParser& Parser);
+
     // Description:
     //   This virtual function returns a pointer to the application's main
     // frame.
@@ -61,11 +71,33 @@ class JZJazzPlusPlusApplication : public wxApp
 
     void InsureConfigurationFileExistence() const;
 
+    // Description:
+    //   Play the song named on the command line with the offline player and
+    // report the time it took.  Returns the exit code of the application.
+    int Render();
+
+    // Description:
+    //   Time the audio mixer kernels for the --mixer-benchmark option.
+    // Returns the exit code of the application.
+    int BenchmarkMixer();
+
   private:
 
     JZProject* mpProject;
 
     JZTrackFrame* mpTrackFrame;
+
+    // Command line options for playing a song offline, without the user
+    // interface.
+    wxString mRenderFileName;
+    wxString mRenderLogFileName;
+    long mRenderToClock;
+    long mRenderLoopClock;
+
+    // Time the audio mixer instead of starting the user interface.
+    bool mIsMixerBenchmark;
+
+    int mExitCode;
 };
 
 //*****************************************************************************
@@ -97,7 +97,7 @@ JZKeyOnEvent* JZMetronomeInfo::CreateNormalEvent(int Clock) const
     gpConfig->GetValue(C_DrumChannel) - 1,
     mKeyNormal,
     mVelocity,
-    15);
+    GetClickLength());
 }
 
 //-----------------------------------------------------------------------------
@@ -109,7 +109,7 @@ JZKeyOnEvent* JZMetronomeInfo::CreateAccentedEvent(int Clock) const
     gpConfig->GetValue(C_DrumChannel) - 1,
     mKeyAccented,
     mVelocity,
-    15);
+    GetClickLength());
 }
 
 //-----------------------------------------------------------------------------
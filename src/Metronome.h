@@ -64,6 +64,9 @@ class JZMetronomeInfo
 
     JZKeyOnEvent* CreateAccentedEvent(int Clock) const;
 
+    // The length of the click key on events in ticks.
+    int GetClickLength() const;
+
   private:
 
     unsigned char mKeyNormal;
@@ -106,3 +109,9 @@ bool JZMetronomeInfo::IsAccented() const
 {
   return mIsAccented;
 }
+
+inline
+int JZMetronomeInfo::GetClickLength() const
+{
+  return 15;
+}
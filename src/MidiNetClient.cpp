@@ -0,0 +1,509 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "MidiNetClient.h"
+
+#include "midinet.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The time to wait for the answer of midinetd in Open().
+static const int HelloTimeoutMilliseconds = 1000;
+
+// The clock offset is the smallest one seen in a window of this length.
+static const long long OffsetWindowMicroseconds = 2000000;
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The client clock follows the system clock, because the kernel stamps
+// received packets with it.
+//-----------------------------------------------------------------------------
+static long long GetSystemMicroseconds()
+{
+  return chrono::duration_cast<chrono::microseconds>(
+    chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//*****************************************************************************
+// Description:
+//   This is the midinet client class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZMidiNetClient::JZMidiNetClient()
+  : mSocket(-1),
+    mStartTime(0),
+    mBundle(),
+    mBundleTime(0),
+    mSendSequence(0),
+    mHistory(),
+    mResendTime(0),
+    mResendCount(MIDINET_UDP_RESEND_COUNT),
+    mHasSequence(false),
+    mLastSequence(0),
+    mSeenSequences(0),
+    mHasOffset(false),
+    mOffset(0),
+    mWindowOffset(0),
+    mWindowStart(0),
+    mReceivedCount(0),
+    mRecoveredCount(0),
+    mLostCount(0),
+    mSentCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZMidiNetClient::~JZMidiNetClient()
+{
+  Close();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZMidiNetClient::Open(const string& Host, int Port)
+{
+  Close();
+
+  ostringstream Service;
+  Service << Port;
+
+  struct addrinfo Hints;
+  memset(&Hints, 0, sizeof(Hints));
+  Hints.ai_family = AF_INET;
+  Hints.ai_socktype = SOCK_DGRAM;
+
+  struct addrinfo* pAddress = 0;
+  int Error = getaddrinfo(Host.c_str(), Service.str().c_str(), &Hints, &pAddress);
+  if (Error != 0)
+  {
+    cerr << "midinet host " << Host << ": " << gai_strerror(Error) << endl;
+    return false;
+  }
+
+  mSocket = socket(pAddress->ai_family, pAddress->ai_socktype, 0);
+  if (mSocket < 0)
+  {
+    perror("midinet socket");
+    freeaddrinfo(pAddress);
+    return false;
+  }
+
+  // Only packets from midinetd are received on a connected socket.
+  if (connect(mSocket, pAddress->ai_addr, pAddress->ai_addrlen) < 0)
+  {
+    perror("midinet connect");
+    freeaddrinfo(pAddress);
+    close(mSocket);
+    mSocket = -1;
+    return false;
+  }
+  freeaddrinfo(pAddress);
+
+  fcntl(mSocket, F_SETFL, O_NONBLOCK);
+
+  // Let the kernel stamp the arrival time, so the clock offset does not
+  // depend on how often the player polls.
+  int On = 1;
+  setsockopt(mSocket, SOL_SOCKET, SO_TIMESTAMP, &On, sizeof(On));
+
+  mStartTime = GetSystemMicroseconds();
+  mBundle.clear();
+  mHistory.clear();
+  mResendCount = MIDINET_UDP_RESEND_COUNT;
+  mSendSequence = 0;
+  mHasSequence = false;
+  mHasOffset = false;
+  mReceivedCount = 0;
+  mRecoveredCount = 0;
+  mLostCount = 0;
+  mSentCount = 0;
+
+  SendPacket(MIDINET_UDP_HELLO);
+
+  struct pollfd PollDescriptor;
+  PollDescriptor.fd = mSocket;
+  PollDescriptor.events = POLLIN;
+  unsigned char Packet[MIDINET_UDP_MAX_PACKET];
+  if (
+    poll(&PollDescriptor, 1, HelloTimeoutMilliseconds) <= 0 ||
+    recv(mSocket, Packet, sizeof(Packet), 0) < MIDINET_UDP_HEADER_SIZE ||
+    Packet[3] != MIDINET_UDP_HELLO)
+  {
+    cerr
+      << "midinetd does not answer on " << Host << ':' << Port << endl;
+    close(mSocket);
+    mSocket = -1;
+    return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::Close()
+{
+  if (mSocket < 0)
+  {
+    return;
+  }
+
+  Flush();
+  SendPacket(MIDINET_UDP_BYE);
+  close(mSocket);
+  mSocket = -1;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+long long JZMidiNetClient::GetTime() const
+{
+  return GetSystemMicroseconds() - mStartTime;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Long messages are split into events of up to 255 bytes with the same
+// time.  A bundle ends when it is full or the delay of the next event does
+// not fit, including events older than the bundle.
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::Write(
+  long long Time,
+  const unsigned char* pData,
+  int Length)
+{
+  unsigned WireTime = (unsigned)Time;
+
+  while (Length > 0)
+  {
+    int Count = Length > 255 ? 255 : Length;
+    unsigned Delay = WireTime - mBundleTime;
+    if (
+      !mBundle.empty() &&
+      (Delay > MIDINET_UDP_MAX_DELAY ||
+       mBundle.size() + MIDINET_UDP_EVENT_HEADER_SIZE + Count >
+         MIDINET_UDP_MAX_BUNDLE_DATA))
+    {
+      CloseBundle();
+    }
+    if (mBundle.empty())
+    {
+      mBundleTime = WireTime;
+      Delay = 0;
+    }
+
+    unsigned char Header[MIDINET_UDP_EVENT_HEADER_SIZE];
+    MIDINET_PUT16(Header, Delay);
+    Header[2] = Count;
+    mBundle.insert(mBundle.end(), Header, Header + sizeof(Header));
+    mBundle.insert(mBundle.end(), pData, pData + Count);
+
+    pData += Count;
+    Length -= Count;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   midinetd drops the repeated bundles it already has.
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::Flush()
+{
+  if (!mBundle.empty())
+  {
+    CloseBundle();
+  }
+  else if (mResendCount < MIDINET_UDP_RESEND_COUNT && GetTime() >= mResendTime)
+  {
+    SendPacket(MIDINET_UDP_BUNDLES);
+    mResendTime = GetTime() + MIDINET_UDP_RESEND_INTERVAL;
+    ++mResendCount;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::Receive(vector<JZMidiNetEvent>& Events)
+{
+  if (mSocket < 0)
+  {
+    return;
+  }
+
+  unsigned char Packet[MIDINET_UDP_MAX_PACKET];
+  char Control[CMSG_SPACE(sizeof(struct timeval))];
+  for (;;)
+  {
+    struct iovec Vector;
+    Vector.iov_base = Packet;
+    Vector.iov_len = sizeof(Packet);
+
+    struct msghdr Message;
+    memset(&Message, 0, sizeof(Message));
+    Message.msg_iov = &Vector;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = sizeof(Control);
+
+    int Length = recvmsg(mSocket, &Message, 0);
+    if (Length <= 0)
+    {
+      break;
+    }
+
+    long long Arrival = GetTime();
+    for (
+      struct cmsghdr* pControl = CMSG_FIRSTHDR(&Message);
+      pControl;
+      pControl = CMSG_NXTHDR(&Message, pControl))
+    {
+      if (
+        pControl->cmsg_level == SOL_SOCKET &&
+        pControl->cmsg_type == SCM_TIMESTAMP)
+      {
+        struct timeval Stamp;
+        memcpy(&Stamp, CMSG_DATA(pControl), sizeof(Stamp));
+        Arrival =
+          (long long)Stamp.tv_sec * 1000000 + Stamp.tv_usec - mStartTime;
+      }
+    }
+
+    HandlePacket(Packet, Length, Arrival, Events);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::SendPacket(int Type)
+{
+  unsigned char Packet[MIDINET_UDP_MAX_PACKET];
+  Packet[0] = MIDINET_UDP_MAGIC0;
+  Packet[1] = MIDINET_UDP_MAGIC1;
+  Packet[2] = MIDINET_UDP_VERSION;
+  Packet[3] = Type;
+  MIDINET_PUT32(Packet + 4, (unsigned)GetTime());
+  Packet[8] = 0;
+  Packet[9] = 0;
+
+  int Length = MIDINET_UDP_HEADER_SIZE;
+  if (Type == MIDINET_UDP_BUNDLES)
+  {
+    for (
+      vector<vector<unsigned char> >::const_iterator iBundle = mHistory.begin();
+      iBundle != mHistory.end();
+      ++iBundle)
+    {
+      memcpy(Packet + Length, &(*iBundle)[0], iBundle->size());
+      Length += iBundle->size();
+      ++Packet[8];
+    }
+  }
+
+  // A lost packet is recovered from the next one, so a full socket buffer
+  // or a missing midinetd is not reported here.
+  send(mSocket, Packet, Length, 0);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::CloseBundle()
+{
+  vector<unsigned char> Bundle(MIDINET_UDP_BUNDLE_HEADER_SIZE);
+  MIDINET_PUT16(&Bundle[0], mSendSequence);
+  MIDINET_PUT32(&Bundle[2], mBundleTime);
+  MIDINET_PUT16(&Bundle[6], mBundle.size());
+  Bundle.insert(Bundle.end(), mBundle.begin(), mBundle.end());
+
+  if (mHistory.size() == MIDINET_UDP_REDUNDANCY + 1)
+  {
+    mHistory.erase(mHistory.begin());
+  }
+  mHistory.push_back(Bundle);
+
+  ++mSendSequence;
+  ++mSentCount;
+  mBundle.clear();
+
+  SendPacket(MIDINET_UDP_BUNDLES);
+  mResendTime = GetTime() + MIDINET_UDP_RESEND_INTERVAL;
+  mResendCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The smallest difference between the arrival time and the send time is
+// the clock offset plus the shortest transit time.  It is renewed every
+// window, so it follows clocks that drift apart.
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::UpdateOffset(long long Arrival, unsigned SendTime)
+{
+  unsigned Offset = (unsigned)Arrival - SendTime;
+
+  if (!mHasOffset)
+  {
+    mHasOffset = true;
+    mOffset = mWindowOffset = Offset;
+    mWindowStart = Arrival;
+    return;
+  }
+
+  if ((int)(Offset - mOffset) < 0)
+  {
+    mOffset = Offset;
+  }
+  if ((int)(Offset - mWindowOffset) < 0)
+  {
+    mWindowOffset = Offset;
+  }
+  if (Arrival - mWindowStart >= OffsetWindowMicroseconds)
+  {
+    mOffset = mWindowOffset;
+    mWindowOffset = Offset;
+    mWindowStart = Arrival;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Remember the last 64 sequence numbers to drop repeated bundles.  A gap
+// counts as lost until a later packet repeats the missing bundles.
+//-----------------------------------------------------------------------------
+bool JZMidiNetClient::AcceptSequence(unsigned short Sequence, bool IsPrimary)
+{
+  if (!mHasSequence)
+  {
+    mHasSequence = true;
+    mLastSequence = Sequence;
+    mSeenSequences = 1;
+    ++mReceivedCount;
+    return true;
+  }
+
+  int Difference = (short)(Sequence - mLastSequence);
+  if (Difference > 0)
+  {
+    mSeenSequences = Difference >= 64 ? 0 : mSeenSequences << Difference;
+    mSeenSequences |= 1;
+    mLostCount += Difference - 1;
+    mLastSequence = Sequence;
+    ++mReceivedCount;
+    if (!IsPrimary)
+    {
+      ++mRecoveredCount;
+    }
+    return true;
+  }
+
+  Difference = -Difference;
+  if (Difference >= 64 || (mSeenSequences >> Difference) & 1)
+  {
+    return false;
+  }
+  mSeenSequences |= 1ULL << Difference;
+  --mLostCount;
+  ++mReceivedCount;
+  ++mRecoveredCount;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetClient::HandlePacket(
+  const unsigned char* pPacket,
+  int Length,
+  long long Arrival,
+  vector<JZMidiNetEvent>& Events)
+{
+  if (
+    Length < MIDINET_UDP_HEADER_SIZE ||
+    pPacket[0] != MIDINET_UDP_MAGIC0 ||
+    pPacket[1] != MIDINET_UDP_MAGIC1 ||
+    pPacket[2] != MIDINET_UDP_VERSION ||
+    pPacket[3] != MIDINET_UDP_BUNDLES)
+  {
+    return;
+  }
+
+  UpdateOffset(Arrival, MIDINET_GET32(pPacket + 4));
+
+  int Count = pPacket[8];
+  int Position = MIDINET_UDP_HEADER_SIZE;
+  for (int i = 0; i < Count; ++i)
+  {
+    if (Position + MIDINET_UDP_BUNDLE_HEADER_SIZE > Length)
+    {
+      break;
+    }
+    const unsigned char* pBundle = pPacket + Position;
+    int DataLength = MIDINET_GET16(pBundle + 6);
+    Position += MIDINET_UDP_BUNDLE_HEADER_SIZE + DataLength;
+    if (Position > Length)
+    {
+      break;
+    }
+    if (!AcceptSequence(MIDINET_GET16(pBundle), i == Count - 1))
+    {
+      continue;
+    }
+
+    unsigned BundleTime = MIDINET_GET32(pBundle + 2);
+    const unsigned char* pData = pBundle + MIDINET_UDP_BUNDLE_HEADER_SIZE;
+    int EventPosition = 0;
+    while (EventPosition + MIDINET_UDP_EVENT_HEADER_SIZE <= DataLength)
+    {
+      const unsigned char* pEvent = pData + EventPosition;
+      int EventLength = pEvent[2];
+      EventPosition += MIDINET_UDP_EVENT_HEADER_SIZE + EventLength;
+      if (EventPosition > DataLength)
+      {
+        break;
+      }
+
+      // Convert the midinetd time into the client clock.
+      unsigned Time = BundleTime + MIDINET_GET16(pEvent) + mOffset;
+
+      JZMidiNetEvent Event;
+      Event.mTime = Arrival + (int)(Time - (unsigned)Arrival);
+      Event.mData.assign(
+        pEvent + MIDINET_UDP_EVENT_HEADER_SIZE,
+        pEvent + MIDINET_UDP_EVENT_HEADER_SIZE + EventLength);
+      Events.push_back(Event);
+    }
+  }
+}
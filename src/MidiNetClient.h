@@ -0,0 +1,188 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   MIDI bytes received from midinetd with the local time they were played
+// or captured at, in microseconds of the client clock.
+//*****************************************************************************
+struct JZMidiNetEvent
+{
+  long long mTime;
+  std::vector<unsigned char> mData;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the midinet client class declaration.  It talks to midinetd
+// with the datagram protocol described in midinet.h.  Written MIDI bytes
+// are collected in bundles that are sent by Flush(), each packet repeating
+// the bundles sent before it, so midinetd recovers isolated lost packets.
+// The times of all written bytes are in microseconds of the client clock;
+// midinetd plays them at the same distance from each other, delayed by the
+// smallest transit time seen and its jitter allowance.
+//*****************************************************************************
+class JZMidiNetClient
+{
+  public:
+
+    JZMidiNetClient();
+
+    ~JZMidiNetClient();
+
+    // Say hello to midinetd on the passed host and wait for its answer.
+    bool Open(const std::string& Host, int Port);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    // The client clock in microseconds since Open().
+    long long GetTime() const;
+
+    // Add MIDI bytes to be played at the passed client time.
+    void Write(long long Time, const unsigned char* pData, int Length);
+
+    // Send the bytes written since the last call.  If there are none, repeat
+    // the last packet when it is due, so midinetd gets the last bundles even
+    // if that packet was lost.
+    void Flush();
+
+    // Append the bytes received from midinetd since the last call.
+    void Receive(std::vector<JZMidiNetEvent>& Events);
+
+    // The number of bundles received, including recovered ones.
+    unsigned GetReceivedCount() const;
+
+    // The number of bundles received only as a repeat in a later packet.
+    unsigned GetRecoveredCount() const;
+
+    // The number of bundles that were never received.
+    int GetLostCount() const;
+
+    // The number of bundles sent.
+    unsigned GetSentCount() const;
+
+  private:
+
+    void SendPacket(int Type);
+
+    void CloseBundle();
+
+    void UpdateOffset(long long Arrival, unsigned SendTime);
+
+    // Returns true if the bundle was not received before.
+    bool AcceptSequence(unsigned short Sequence, bool IsPrimary);
+
+    void HandlePacket(
+      const unsigned char* pPacket,
+      int Length,
+      long long Arrival,
+      std::vector<JZMidiNetEvent>& Events);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZMidiNetClient(const JZMidiNetClient&);
+    JZMidiNetClient& operator = (const JZMidiNetClient&);
+
+  private:
+
+    int mSocket;
+
+    long long mStartTime;
+
+    // The bundle under construction.
+    std::vector<unsigned char> mBundle;
+    unsigned mBundleTime;
+    unsigned short mSendSequence;
+
+    // The last bundles sent, including their headers, oldest first.
+    std::vector<std::vector<unsigned char> > mHistory;
+
+    // When to repeat the last packet, and how often it was repeated.
+    long long mResendTime;
+    int mResendCount;
+
+    // Receive state.
+    bool mHasSequence;
+    unsigned short mLastSequence;
+    unsigned long long mSeenSequences;
+    bool mHasOffset;
+    unsigned mOffset;
+    unsigned mWindowOffset;
+    long long mWindowStart;
+
+    unsigned mReceivedCount;
+    unsigned mRecoveredCount;
+    int mLostCount;
+    unsigned mSentCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the midinet client class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZMidiNetClient::IsOpen() const
+{
+  return mSocket >= 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZMidiNetClient::GetReceivedCount() const
+{
+  return mReceivedCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZMidiNetClient::GetRecoveredCount() const
+{
+  return mRecoveredCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+int JZMidiNetClient::GetLostCount() const
+{
+  return mLostCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZMidiNetClient::GetSentCount() const
+{
+  return mSentCount;
+}
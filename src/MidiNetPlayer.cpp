@@ -0,0 +1,334 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "MidiNetPlayer.h"
+
+#include "Configuration.h"
+#include "Globals.h"
+#include "ProjectManager.h"
+
+#include <iostream>
+
+using namespace std;
+
+// The first events are sent this long before they are played, so they
+// reach midinetd in time.
+static const int StartDelayMilliseconds = 20;
+
+//*****************************************************************************
+// Description:
+//   This is the midinet player class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZMidiNetPlayer::JZMidiNetPlayer(JZSong* pSong)
+  : JZPlayer(pSong),
+    mClient(),
+    mIsInstalled(false),
+    mStartTime(0),
+    mStartClock(0),
+    mTicksPerMinute(100),
+    mInputStatus(0),
+    mInputCount(0),
+    mIsInSysEx(false),
+    mInputSysEx(),
+    mReceived()
+{
+  mIsInstalled = mClient.Open(
+    gpConfig->GetStrValue(C_MidiNetHost),
+    gpConfig->GetValue(C_MidiNetPort));
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZMidiNetPlayer::~JZMidiNetPlayer()
+{
+  mClient.Close();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZMidiNetPlayer::IsInstalled()
+{
+  return mIsInstalled;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZMidiNetPlayer::Clock2Time(int Clock)
+{
+  if (Clock < mStartClock)
+  {
+    return mStartTime;
+  }
+
+  return (int)(
+    (double)(Clock - mStartClock) * 60000.0 / (double)mTicksPerMinute +
+    mStartTime);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZMidiNetPlayer::Time2Clock(int Time)
+{
+  if (Time < mStartTime)
+  {
+    return mStartClock;
+  }
+
+  return (int)(
+    (double)(Time - mStartTime) * (double)mTicksPerMinute / 60000.0 +
+    mStartClock);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::SetTempo(int BeatsPerMinute, int Clock)
+{
+  int t1 = Clock2Time(Clock);
+  mTicksPerMinute = BeatsPerMinute * mpSong->GetTicksPerQuarter();
+  int t2 = Clock2Time(Clock);
+  mStartTime += (t1 - t2);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The events only go into the bundle under construction; OutBreak() sends
+// them together.
+//-----------------------------------------------------------------------------
+int JZMidiNetPlayer::OutEvent(JZEvent* pEvent, bool Now)
+{
+  long long Time;
+  if (Now)
+  {
+    Time = mClient.GetTime();
+  }
+  else
+  {
+    Time = (long long)Clock2Time(pEvent->GetClock()) * 1000;
+  }
+
+  if (pEvent->GetStat() == StatSetTempo)
+  {
+    JZSetTempoEvent* pSetTempo = pEvent->IsSetTempo();
+    if (pSetTempo->GetClock() > 0)
+    {
+      SetTempo(pSetTempo->GetBPM(), pSetTempo->GetClock());
+    }
+    return 0;
+  }
+
+  if (pEvent->GetStat() == StatSysEx)
+  {
+    vector<unsigned char> SysEx;
+    GetSysExMessage(pEvent->IsSysEx(), SysEx);
+    mClient.Write(Time, &SysEx[0], SysEx.size());
+    return 0;
+  }
+
+  unsigned char Message[3];
+  int Length = GetChannelMessage(pEvent, Message);
+  if (Length > 0)
+  {
+    mClient.Write(Time, Message, Length);
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZMidiNetPlayer::OutEvent(JZEvent* pEvent)
+{
+  return OutEvent(pEvent, false);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::OutNow(JZEvent* pEvent)
+{
+  OutEvent(pEvent, true);
+  mClient.Flush();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::OutBreak()
+{
+  mClient.Flush();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::StartPlay(int Clock, int LoopClock, int Continue)
+{
+  mStartTime = (int)(mClient.GetTime() / 1000) + StartDelayMilliseconds;
+  mStartClock = Clock;
+  mTicksPerMinute = mpSong->GetTicksPerQuarter() * mpSong->Speed();
+
+  mInputStatus = 0;
+  mInputCount = 0;
+  mIsInSysEx = false;
+
+  JZPlayer::StartPlay(Clock, LoopClock, Continue);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::StopPlay()
+{
+  JZPlayer::StopPlay();
+  mClient.Flush();
+  GetRealTimeClock();
+  JZProjectManager::Instance().NewPlayPosition(-1);
+  mRecordRing.MoveTo(mRecdBuffer);
+  mRecdBuffer.Keyoff2Length();
+
+#ifdef DEBUG_MIDINET
+  cout
+    << "JZMidiNetPlayer::StopPlay " << mClient.GetSentCount()
+    << " bundles sent, " << mClient.GetReceivedCount() << " received, "
+    << mClient.GetRecoveredCount() << " recovered, "
+    << mClient.GetLostCount() << " lost"
+    << endl;
+#endif // DEBUG_MIDINET
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZMidiNetPlayer::GetRealTimeClock()
+{
+  mReceived.clear();
+  mClient.Receive(mReceived);
+  for (
+    vector<JZMidiNetEvent>::const_iterator iEvent = mReceived.begin();
+    iEvent != mReceived.end();
+    ++iEvent)
+  {
+    RecordBytes(*iEvent);
+  }
+
+  // Convert a long recording in bulk before the ring fills up.
+  if (mRecordRing.GetCount() >= JZRecordRing::eCapacity / 2)
+  {
+    mRecordRing.MoveTo(mRecdBuffer);
+  }
+
+  int Clock = Time2Clock((int)(mClient.GetTime() / 1000));
+  JZProjectManager::Instance().NewPlayPosition(
+    mpPlayLoop->Ext2IntClock(Clock / 48 * 48));
+  return Clock;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   midinetd forwards the raw bytes of the device, so messages may use
+// running status and may be split across events.  Real time messages are
+// not recorded.
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::RecordBytes(const JZMidiNetEvent& Event)
+{
+  int Clock = mpPlayLoop->Ext2IntClock(
+    Time2Clock((int)(Event.mTime / 1000)));
+
+  for (
+    vector<unsigned char>::const_iterator iByte = Event.mData.begin();
+    iByte != Event.mData.end();
+    ++iByte)
+  {
+    unsigned char Byte = *iByte;
+
+    if (Byte >= 0xF8)
+    {
+      continue;
+    }
+
+    if (mIsInSysEx)
+    {
+      mInputSysEx.push_back(Byte);
+      if (Byte == 0xF7)
+      {
+        RecordSysEx(Clock);
+        continue;
+      }
+      if (Byte < 0x80)
+      {
+        continue;
+      }
+
+      // A status byte ends an unterminated message.
+      mInputSysEx.pop_back();
+      RecordSysEx(Clock);
+    }
+
+    if (Byte == 0xF0)
+    {
+      mIsInSysEx = true;
+      mInputSysEx.assign(1, Byte);
+      mInputStatus = 0;
+      continue;
+    }
+
+    if (Byte >= 0x80)
+    {
+      // System common messages cancel the running status.
+      mInputStatus = Byte < 0xF0 ? Byte : 0;
+      mInputCount = 0;
+      continue;
+    }
+
+    if (mInputStatus == 0)
+    {
+      continue;
+    }
+
+    mInputData[mInputCount++] = Byte;
+
+    unsigned char Type = mInputStatus & 0xF0;
+    int DataLength = (Type == 0xC0 || Type == 0xD0) ? 1 : 2;
+    if (mInputCount == DataLength)
+    {
+      mRecordRing.Put(
+        Clock,
+        mInputStatus,
+        mInputData[0],
+        DataLength == 2 ? mInputData[1] : 0);
+      mInputCount = 0;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   System exclusive messages do not fit into the ring.  Convert the
+// captured messages first to keep the events in arrival order.
+//-----------------------------------------------------------------------------
+void JZMidiNetPlayer::RecordSysEx(int Clock)
+{
+  mIsInSysEx = false;
+  mRecordRing.MoveTo(mRecdBuffer);
+  JZEvent* pEvent = new JZSysExEvent(
+    0,
+    &mInputSysEx[1],
+    mInputSysEx.size() - 1);
+  pEvent->SetClock(Clock);
+  mRecdBuffer.Put(pEvent);
+}
@@ -0,0 +1,95 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include "MidiNetClient.h"
+#include "Player.h"
+
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   This is the midinet player class declaration.  It plays and records
+// through midinetd on another host, using the datagram protocol instead of
+// the RPC and TCP connections of the MPU-401 player.  The events are sent
+// ahead of time with their play times, so the network jitter is absorbed
+// by the jitter buffer of midinetd instead of delaying single events.
+//*****************************************************************************
+class JZMidiNetPlayer : public JZPlayer
+{
+  public:
+
+    JZMidiNetPlayer(JZSong* pSong);
+
+    virtual ~JZMidiNetPlayer();
+
+    virtual bool IsInstalled();
+
+    int OutEvent(JZEvent* pEvent, bool Now);
+    virtual int OutEvent(JZEvent* pEvent);
+    virtual void OutNow(JZEvent* pEvent);
+    virtual void OutBreak();
+
+    virtual void StartPlay(int Clock, int LoopClock = 0, int Continue = 0);
+    virtual void StopPlay();
+
+    virtual int GetRealTimeClock();
+
+  private:
+
+    int Clock2Time(int Clock);
+    int Time2Clock(int Time);
+    void SetTempo(int BeatsPerMinute, int Clock);
+
+    // Split the received bytes into messages and record them.
+    void RecordBytes(const JZMidiNetEvent& Event);
+
+    void RecordSysEx(int Clock);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZMidiNetPlayer(const JZMidiNetPlayer&);
+    JZMidiNetPlayer& operator = (const JZMidiNetPlayer&);
+
+  private:
+
+    JZMidiNetClient mClient;
+
+    bool mIsInstalled;
+
+    // The client time in milliseconds at the start clock.
+    int mStartTime;
+    int mStartClock;
+    int mTicksPerMinute;
+
+    // The state of the received byte stream.
+    unsigned char mInputStatus;
+    unsigned char mInputData[2];
+    int mInputCount;
+    bool mIsInSysEx;
+    std::vector<unsigned char> mInputSysEx;
+
+    std::vector<JZMidiNetEvent> mReceived;
+};
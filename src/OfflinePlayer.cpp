@@ -0,0 +1,223 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "OfflinePlayer.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the offline player class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZOfflinePlayer::JZOfflinePlayer(JZSong* pSong)
+  : JZPlayer(pSong),
+    mClock(0),
+    mStep(pSong->GetTicksPerQuarter() / 8),
+    mEndClock(0),
+    mLog()
+{
+  if (mStep < 1)
+  {
+    mStep = 1;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZOfflinePlayer::~JZOfflinePlayer()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZOfflinePlayer::IsInstalled()
+{
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZOfflinePlayer::OutEvent(JZEvent* pEvent)
+{
+  Log(pEvent, pEvent->GetClock());
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::OutNow(JZEvent* pEvent)
+{
+  Log(pEvent, mClock);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::OutBreak()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The base class starts the wxTimer, but the virtual clock is advanced by
+// Run() and not by a timer.
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::StartPlay(int Clock, int LoopClock, int Continue)
+{
+  mClock = Clock;
+  JZPlayer::StartPlay(Clock, LoopClock, Continue);
+  Stop();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZOfflinePlayer::GetRealTimeClock()
+{
+  return mClock;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::SetStep(int Ticks)
+{
+  mStep = Ticks > 0 ? Ticks : 1;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::Run(int FromClock, int ToClock, int LoopClock)
+{
+  mLog.clear();
+  mEndClock = ToClock;
+
+  StartPlay(FromClock, LoopClock);
+  while (mClock < ToClock)
+  {
+    mClock += mStep;
+    if (mClock > ToClock)
+    {
+      mClock = ToClock;
+    }
+    Notify();
+  }
+  StopPlay();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::WriteLog(ostream& Os) const
+{
+  for (
+    vector<JZOfflineLogEntry>::const_iterator iEntry = mLog.begin();
+    iEntry != mLog.end();
+    ++iEntry)
+  {
+    Os
+      << iEntry->mClock << ' ' << (int)iEntry->mDevice << hex << setfill('0')
+      << ' ' << setw(2) << (int)iEntry->mStatus
+      << ' ' << setw(2) << (int)iEntry->mData1
+      << ' ' << setw(2) << (int)iEntry->mData2
+      << dec << setfill(' ') << '\n';
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZOfflinePlayer::Log(JZEvent* pEvent, int Clock)
+{
+  if (Clock >= mEndClock)
+  {
+    return;
+  }
+
+  JZOfflineLogEntry Entry;
+  Entry.mClock = Clock;
+  Entry.mDevice = pEvent->GetDevice();
+  Entry.mStatus = pEvent->GetStat();
+  Entry.mData1 = 0;
+  Entry.mData2 = 0;
+
+  JZChannelEvent* pChannelEvent = pEvent->IsChannelEvent();
+  if (pChannelEvent)
+  {
+    Entry.mStatus |= pChannelEvent->GetChannel();
+  }
+
+  int Value = 0;
+  switch (pEvent->GetStat())
+  {
+    case StatKeyOn:
+      Entry.mData1 = pEvent->IsKeyOn()->GetKey();
+      Entry.mData2 = pEvent->IsKeyOn()->GetVelocity();
+      break;
+
+    case StatKeyOff:
+      Entry.mData1 = pEvent->IsKeyOff()->GetKey();
+      Entry.mData2 = pEvent->IsKeyOff()->GetOffVelocity();
+      break;
+
+    case StatKeyPressure:
+      Entry.mData1 = pEvent->IsKeyPressure()->GetKey();
+      Entry.mData2 = pEvent->IsKeyPressure()->GetPressureValue();
+      break;
+
+    case StatControl:
+      Entry.mData1 = pEvent->IsControl()->GetControl();
+      Entry.mData2 = pEvent->IsControl()->GetControlValue();
+      break;
+
+    case StatProgram:
+      Entry.mData1 = pEvent->IsProgram()->GetProgram();
+      break;
+
+    case StatChnPressure:
+      Entry.mData1 = pEvent->IsChnPressure()->Value;
+      break;
+
+    case StatPitch:
+      Value = pEvent->IsPitch()->Value + 8192;
+      break;
+
+    case StatSetTempo:
+      Value = pEvent->IsSetTempo()->GetBPM();
+      break;
+
+    default:
+      if (pEvent->IsMetaEvent())
+      {
+        Value = pEvent->IsMetaEvent()->GetDataLength();
+      }
+      break;
+  }
+
+  if (Value)
+  {
+    Entry.mData1 = Value & 0x7f;
+    Entry.mData2 = (Value >> 7) & 0x7f;
+  }
+
+  mLog.push_back(Entry);
+}
@@ -0,0 +1,115 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include "Player.h"
+
+#include <iosfwd>
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   One event sent by the offline player.  Channel messages are kept as
+// their MIDI bytes.  For other events mStatus is the event status and the
+// data bytes hold the low and high seven bits of the tempo in beats per
+// minute or of the data length.
+//*****************************************************************************
+struct JZOfflineLogEntry
+{
+  int mClock;
+  unsigned char mDevice;
+  unsigned char mStatus;
+  unsigned char mData1;
+  unsigned char mData2;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the offline player class declaration.  It runs the complete
+// playback path, Notify(), PrepareOutput() and FlushToDevice(), against a
+// virtual clock that is advanced as fast as possible instead of a device
+// clock, and logs every event it is asked to send.  This allows benchmarks
+// and regression checks of the playback path without MIDI hardware.
+//
+//   Only the events before the end of a run are logged, so the log does not
+// depend on how far ahead the player happened to prepare the output.
+//*****************************************************************************
+class JZOfflinePlayer : public JZPlayer
+{
+  public:
+
+    JZOfflinePlayer(JZSong* pSong);
+
+    virtual ~JZOfflinePlayer();
+
+    virtual bool IsInstalled();
+
+    virtual int OutEvent(JZEvent* pEvent);
+
+    virtual void OutNow(JZEvent* pEvent);
+
+    virtual void OutBreak();
+
+    virtual void StartPlay(int Clock, int LoopClock = 0, int Continue = 0);
+
+    virtual int GetRealTimeClock();
+
+    // The virtual clock advances this many ticks between Notify() calls.
+    void SetStep(int Ticks);
+
+    // Play from FromClock until the virtual clock reaches ToClock.  With a
+    // loop clock, the range from FromClock to LoopClock is repeated.
+    void Run(int FromClock, int ToClock, int LoopClock = 0);
+
+    const std::vector<JZOfflineLogEntry>& GetLog() const;
+
+    // One line per event with the clock, the device and the bytes in hex.
+    void WriteLog(std::ostream& Os) const;
+
+  private:
+
+    void Log(JZEvent* pEvent, int Clock);
+
+  private:
+
+    int mClock;
+
+    int mStep;
+
+    // Events at or after this clock are not logged.
+    int mEndClock;
+
+    std::vector<JZOfflineLogEntry> mLog;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the offline player class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const std::vector<JZOfflineLogEntry>& JZOfflinePlayer::GetLog() const
+{
+  return mLog;
+}
@@ -0,0 +1,100 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "PlayBuffer.h"
+
+#include <algorithm>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the play buffer class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlayBuffer::JZPlayBuffer()
+  : mRecords(256),
+    mHead(0),
+    mCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayBuffer::Clear()
+{
+  mHead = 0;
+  mCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Records with the same clock stay in the order they were inserted.  The
+// record is appended and moved towards the head, which is cheap because
+// inserted records (like MIDI clocks) are usually close to the end.
+//-----------------------------------------------------------------------------
+void JZPlayBuffer::Insert(
+  int Clock,
+  int Device,
+  JZEvent* pEvent,
+  unsigned Epoch)
+{
+  Put(Clock, Device, pEvent, Epoch);
+
+  size_t Mask = mRecords.size() - 1;
+  for (int Index = mCount - 1; Index > 0; --Index)
+  {
+    JZPlayRecord& Previous = mRecords[(mHead + Index - 1) & Mask];
+    if (Previous.mClock <= Clock)
+    {
+      break;
+    }
+    swap(Previous, mRecords[(mHead + Index) & Mask]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZPlayBuffer::GetLastClock() const
+{
+  if (mCount == 0)
+  {
+    return 0;
+  }
+  return GetRecord(mCount - 1).mClock;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Double the ring size and move the records to the start of the new ring.
+//-----------------------------------------------------------------------------
+void JZPlayBuffer::Grow()
+{
+  vector<JZPlayRecord> Records(mRecords.size() * 2);
+  for (int Index = 0; Index < mCount; ++Index)
+  {
+    Records[Index] = GetRecord(Index);
+  }
+  mRecords.swap(Records);
+  mHead = 0;
+}
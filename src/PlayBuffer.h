@@ -0,0 +1,152 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <vector>
+
+class JZEvent;
+
+//*****************************************************************************
+// Description:
+//   One event waiting in the play buffer.  The event is not owned by the
+// record; it usually belongs to the playback schedule and is shared by every
+// pass through a loop, so the clock and device of the output are kept in the
+// record.  mEpoch is the playback schedule epoch in which the record was
+// created, see JZPlaybackSchedule::Reclaim().
+//*****************************************************************************
+struct JZPlayRecord
+{
+  int mClock;
+  int mDevice;
+  JZEvent* mpEvent;
+  unsigned mEpoch;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the play buffer class declaration.  It holds the records of the
+// events that are about to be sent to a MIDI device in clock order.  The
+// records are kept in a ring, so records that have been sent are dropped by
+// moving the head index instead of compacting or sorting the buffer.  The
+// ring grows by doubling when it is full.
+//*****************************************************************************
+class JZPlayBuffer
+{
+  public:
+
+    JZPlayBuffer();
+
+    void Clear();
+
+    bool IsEmpty() const;
+
+    int GetCount() const;
+
+    const JZPlayRecord& GetRecord(int Index) const;
+
+    // Append a record.  The clock must not be less than the clock of the
+    // last record.
+    void Put(int Clock, int Device, JZEvent* pEvent, unsigned Epoch);
+
+    // Insert a record at its clock position.
+    void Insert(int Clock, int Device, JZEvent* pEvent, unsigned Epoch);
+
+    // Remove the first Count records.
+    void RemoveFirst(int Count);
+
+    int GetLastClock() const;
+
+  private:
+
+    void Grow();
+
+  private:
+
+    // The ring size is always a power of two, so an index wraps with a mask.
+    std::vector<JZPlayRecord> mRecords;
+
+    int mHead;
+
+    int mCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the play buffer class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZPlayBuffer::IsEmpty() const
+{
+  return mCount == 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+int JZPlayBuffer::GetCount() const
+{
+  return mCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZPlayRecord& JZPlayBuffer::GetRecord(int Index) const
+{
+  return mRecords[(mHead + Index) & (mRecords.size() - 1)];
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlayBuffer::Put(int Clock, int Device, JZEvent* pEvent, unsigned Epoch)
+{
+  if (mCount == static_cast<int>(mRecords.size()))
+  {
+    Grow();
+  }
+  JZPlayRecord& Record = mRecords[(mHead + mCount) & (mRecords.size() - 1)];
+  Record.mClock = Clock;
+  Record.mDevice = Device;
+  Record.mpEvent = pEvent;
+  Record.mEpoch = Epoch;
+  ++mCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlayBuffer::RemoveFirst(int Count)
+{
+  if (Count >= mCount)
+  {
+    Clear();
+  }
+  else
+  {
+    mHead = (mHead + Count) & (mRecords.size() - 1);
+    mCount -= Count;
+  }
+}
@@ -0,0 +1,837 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "PlaybackSchedule.h"
+
+#include "Events.h"
+#include "Song.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// The number of bars between two chase checkpoints.
+static const int ChaseCheckpointBars = 8;
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Order schedule entries by clock.  At the same clock key off events come
+// first, so a note that is struck again exactly where the previous one ends
+// is not cut off by the old key off.
+//-----------------------------------------------------------------------------
+static bool IsEntryBefore(const JZScheduleEntry& Lhs, const JZScheduleEntry& Rhs)
+{
+  if (Lhs.mClock != Rhs.mClock)
+  {
+    return Lhs.mClock < Rhs.mClock;
+  }
+  return Lhs.mpEvent->IsKeyOff() != 0 && Rhs.mpEvent->IsKeyOff() == 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+static bool IsEntryClockBefore(
+  const JZScheduleEntry& Lhs,
+  const JZScheduleEntry& Rhs)
+{
+  return Lhs.mClock < Rhs.mClock;
+}
+
+//*****************************************************************************
+// Description:
+//   This is the playback schedule class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackSchedule::JZTrackCache::JZTrackCache()
+  : mIsValid(false),
+    mRevision(0),
+    mDevice(0),
+    mAudioMode(false),
+    mDependencies(),
+    mEvents(),
+    mEntries(),
+    mChaseIsValid(false),
+    mChaseCheckpoints()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackSchedule::JZPatternCache::JZPatternCache()
+  : mIsValid(false),
+    mIsBuilding(false),
+    mRevision(0),
+    mDevice(0),
+    mLength(0),
+    mDependencies(),
+    mEvents()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackSchedule::JZPlaybackSchedule(JZSong& Song)
+  : mSong(Song),
+    mEpoch(0),
+    mGeneration(0),
+    mRetiredEvents(),
+    mChaseState(),
+    mTempoMap()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackSchedule::~JZPlaybackSchedule()
+{
+  Reclaim(mEpoch + 1);
+  for (int TrackIndex = 0; TrackIndex < eMaxTrackCount; ++TrackIndex)
+  {
+    ClearPattern(mPatternCaches[TrackIndex]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::Invalidate(int TrackIndex)
+{
+  if (TrackIndex >= 0 && TrackIndex < eMaxTrackCount)
+  {
+    mTrackCaches[TrackIndex].mIsValid = false;
+    mPatternCaches[TrackIndex].mIsValid = false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::InvalidateAll()
+{
+  for (int TrackIndex = 0; TrackIndex < eMaxTrackCount; ++TrackIndex)
+  {
+    mTrackCaches[TrackIndex].mIsValid = false;
+    mPatternCaches[TrackIndex].mIsValid = false;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::Update()
+{
+  // The events of rebuilt tracks are retired in the epoch that ends here.
+  for (int TrackIndex = 0; TrackIndex < mSong.GetTrackCount(); ++TrackIndex)
+  {
+    if (!IsTrackValid(TrackIndex))
+    {
+      BuildTrack(TrackIndex);
+    }
+  }
+  ++mEpoch;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::Retire(JZEvent* pEvent)
+{
+  JZRetiredEvent RetiredEvent;
+  RetiredEvent.mEpoch = mEpoch;
+  RetiredEvent.mpEvent = pEvent;
+  mRetiredEvents.push_back(RetiredEvent);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::Reclaim(unsigned OldestEpochInUse)
+{
+  while (
+    !mRetiredEvents.empty() &&
+    mRetiredEvents.front().mEpoch < OldestEpochInUse)
+  {
+    delete mRetiredEvents.front().mpEvent;
+    mRetiredEvents.pop_front();
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZPlaybackSchedule::Find(
+  const vector<JZScheduleEntry>& Entries,
+  int Clock)
+{
+  JZScheduleEntry Key;
+  Key.mClock = Clock;
+
+  vector<JZScheduleEntry>::const_iterator iEntry = lower_bound(
+    Entries.begin(),
+    Entries.end(),
+    Key,
+    IsEntryClockBefore);
+
+  return static_cast<int>(iEntry - Entries.begin());
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZPlaybackSchedule::FindTempoChange(int Clock) const
+{
+  vector<JZTempoChange>::const_iterator iTempoChange = upper_bound(
+    mTempoMap.begin(),
+    mTempoMap.end(),
+    Clock,
+    IsClockBeforeTempoChange);
+
+  return static_cast<int>(iTempoChange - mTempoMap.begin());
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::Sort(vector<JZScheduleEntry>& Entries)
+{
+  stable_sort(Entries.begin(), Entries.end(), IsEntryBefore);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Start with the state of the last checkpoint at or before the clock and
+// apply the entries between the checkpoint and the clock.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::GetChaseEvents(
+  int TrackIndex,
+  int Clock,
+  vector<JZEvent*>& Events)
+{
+  JZTrackCache& Cache = mTrackCaches[TrackIndex];
+  if (!Cache.mChaseIsValid)
+  {
+    BuildChaseCheckpoints(TrackIndex);
+  }
+
+  vector<JZChaseCheckpoint>::const_iterator iCheckpoint = upper_bound(
+    Cache.mChaseCheckpoints.begin(),
+    Cache.mChaseCheckpoints.end(),
+    Clock,
+    IsClockBeforeCheckpoint);
+  if (iCheckpoint == Cache.mChaseCheckpoints.begin())
+  {
+    return;
+  }
+  --iCheckpoint;
+
+  mChaseState.Clear();
+  for (
+    vector<JZEvent*>::const_iterator iEvent = iCheckpoint->mEvents.begin();
+    iEvent != iCheckpoint->mEvents.end();
+    ++iEvent)
+  {
+    mChaseState.Apply(*iEvent);
+  }
+
+  const vector<JZScheduleEntry>& Entries = Cache.mEntries;
+  int EntryCount = static_cast<int>(Entries.size());
+  for (
+    int EntryIndex = iCheckpoint->mEntryIndex;
+    EntryIndex < EntryCount && Entries[EntryIndex].mClock < Clock;
+    ++EntryIndex)
+  {
+    mChaseState.Apply(Entries[EntryIndex].mpEvent);
+  }
+
+  mChaseState.GetEvents(Events);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   A track cache is valid if neither the track nor any track it plays
+// through play track events has been cleaned up or moved to a different
+// device since the cache was built.
+//-----------------------------------------------------------------------------
+bool JZPlaybackSchedule::IsTrackValid(int TrackIndex) const
+{
+  const JZTrackCache& Cache = mTrackCaches[TrackIndex];
+  const JZTrack& Track = mSong.mTracks[TrackIndex];
+
+  if (
+    !Cache.mIsValid ||
+    Cache.mRevision != Track.GetRevision() ||
+    Cache.mDevice != Track.GetDevice() ||
+    Cache.mAudioMode != Track.GetAudioMode())
+  {
+    return false;
+  }
+
+  return AreDependenciesValid(mSong, Cache.mDependencies);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Copy the events of one track into its cache and create the schedule
+// entries for them.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::BuildTrack(int TrackIndex)
+{
+  JZTrack* pTrack = mSong.GetTrack(TrackIndex);
+  JZTrackCache& Cache = mTrackCaches[TrackIndex];
+
+  // Play buffer records may still reference the old events.
+  for (
+    int EventIndex = 0;
+    EventIndex < Cache.mEvents.mEventCount;
+    ++EventIndex)
+  {
+    Retire(Cache.mEvents.mppEvents[EventIndex]);
+  }
+  Cache.mEvents.mEventCount = 0;
+  Cache.mEntries.clear();
+  Cache.mDependencies.clear();
+  Cache.mChaseIsValid = false;
+  Cache.mChaseCheckpoints.clear();
+  ++mGeneration;
+
+  Cache.mIsValid = true;
+  Cache.mRevision = pTrack->GetRevision();
+  Cache.mDevice = pTrack->GetDevice();
+  Cache.mAudioMode = pTrack->GetAudioMode();
+
+  for (int EventIndex = 0; EventIndex < pTrack->mEventCount; ++EventIndex)
+  {
+    JZEvent* pEvent = pTrack->mppEvents[EventIndex];
+    if (pEvent->IsKilled() || pEvent->IsEndOfTrack())
+    {
+      continue;
+    }
+
+    if (pEvent->IsPlayTrack())
+    {
+      ExpandPlayTrack(Cache, pEvent->IsPlayTrack());
+      continue;
+    }
+
+    JZEvent* pEventCopy = pEvent->Copy();
+    pEventCopy->SetDevice(pTrack->GetDevice());
+    Cache.mEvents.Put(pEventCopy);
+  }
+
+  // The expanded play tracks and the created key off events are merged into
+  // the track entries here, when the track is built, so they need no extra
+  // work during playback.
+  //
+  // Key on events keep their length, it is needed by the audio player and
+  // to end notes that are still sounding at the end of a loop.
+  int EventCount = Cache.mEvents.mEventCount;
+  for (int EventIndex = 0; EventIndex < EventCount; ++EventIndex)
+  {
+    JZEvent* pEvent = Cache.mEvents.mppEvents[EventIndex];
+
+    JZScheduleEntry Entry;
+    Entry.mClock = pEvent->GetClock();
+    Entry.mOnClock = Entry.mClock;
+    Entry.mTrackIndex = TrackIndex;
+    Entry.mpEvent = pEvent;
+    Cache.mEntries.push_back(Entry);
+
+    JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
+    if (!Cache.mAudioMode && pKeyOn && pKeyOn->GetEventLength() != 0)
+    {
+      JZKeyOffEvent* pKeyOff = new JZKeyOffEvent(
+        pKeyOn->GetClock() + pKeyOn->GetEventLength(),
+        pKeyOn->GetChannel(),
+        pKeyOn->GetKey(),
+        pKeyOn->GetOffVelocity());
+      pKeyOff->SetDevice(pKeyOn->GetDevice());
+      Cache.mEvents.Put(pKeyOff);
+
+      Entry.mClock = pKeyOff->GetClock();
+      Entry.mpEvent = pKeyOff;
+      Cache.mEntries.push_back(Entry);
+    }
+  }
+
+  Sort(Cache.mEntries);
+
+  if (TrackIndex == 0)
+  {
+    BuildTempoMap();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Copy the pattern events played by a play track event into a track
+// cache.
+//
+//   If playback starts in the middle of a play track event, the events
+// before the start position are not played.  Play tracks that are not an
+// even number of bars long are not handled.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::ExpandPlayTrack(
+  JZTrackCache& Cache,
+  JZPlayTrackEvent* pPlayTrack)
+{
+  const JZPatternCache* pPattern = GetPattern(pPlayTrack->track);
+  if (!pPattern)
+  {
+    return;
+  }
+
+  AddDependencies(
+    Cache.mDependencies,
+    mSong.mTracks[pPlayTrack->track],
+    pPlayTrack->track,
+    pPattern);
+
+  vector<JZEvent*> Events;
+  InstantiatePattern(*pPattern, pPlayTrack, Events);
+  for (
+    vector<JZEvent*>::const_iterator iEvent = Events.begin();
+    iEvent != Events.end();
+    ++iEvent)
+  {
+    Cache.mEvents.Put(*iEvent);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZPlaybackSchedule::IsPatternValid(int TrackIndex) const
+{
+  const JZPatternCache& Pattern = mPatternCaches[TrackIndex];
+  const JZTrack& Track = mSong.mTracks[TrackIndex];
+
+  return
+    Pattern.mIsValid &&
+    Pattern.mRevision == Track.GetRevision() &&
+    Pattern.mDevice == Track.GetDevice() &&
+    AreDependenciesValid(mSong, Pattern.mDependencies);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+const JZPlaybackSchedule::JZPatternCache* JZPlaybackSchedule::GetPattern(
+  int TrackIndex)
+{
+  if (TrackIndex < 0 || TrackIndex >= mSong.GetTrackCount())
+  {
+    return 0;
+  }
+
+  if (mPatternCaches[TrackIndex].mIsBuilding)
+  {
+    return 0;
+  }
+
+  if (!IsPatternValid(TrackIndex))
+  {
+    BuildPattern(TrackIndex);
+  }
+  return &mPatternCaches[TrackIndex];
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Flatten the events of a track that is played by play track events.  The
+// patterns it plays itself are built first, so every pattern is expanded
+// only once however often and however deeply it is referenced.
+//
+//   A reference to a pattern that is still being built closes a cycle.  It
+// is dropped, but still recorded as a dependency, so the pattern is rebuilt
+// when the cycle is broken.  Which reference of a cycle is dropped depends
+// on the pattern the expansion started with.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::BuildPattern(int TrackIndex)
+{
+  JZTrack& Track = mSong.mTracks[TrackIndex];
+  JZPatternCache& Pattern = mPatternCaches[TrackIndex];
+
+  ClearPattern(Pattern);
+  Pattern.mIsBuilding = true;
+  Pattern.mRevision = Track.GetRevision();
+  Pattern.mDevice = Track.GetDevice();
+  Pattern.mLength = Track.GetLastClock();
+
+  // The track events are in clock order, so the anchor clocks are too.
+  vector<JZEvent*> Events;
+  for (int EventIndex = 0; EventIndex < Track.mEventCount; ++EventIndex)
+  {
+    JZEvent* pEvent = Track.mppEvents[EventIndex];
+    if (pEvent->IsKilled() || pEvent->IsEndOfTrack())
+    {
+      continue;
+    }
+
+    JZPatternEvent PatternEvent;
+    PatternEvent.mAnchorClock = pEvent->GetClock();
+
+    JZPlayTrackEvent* pPlayTrack = pEvent->IsPlayTrack();
+    if (pPlayTrack)
+    {
+      int PlayedIndex = pPlayTrack->track;
+      if (PlayedIndex < 0 || PlayedIndex >= mSong.GetTrackCount())
+      {
+        continue;
+      }
+
+      const JZPatternCache* pPlayed = GetPattern(PlayedIndex);
+      AddDependencies(
+        Pattern.mDependencies,
+        mSong.mTracks[PlayedIndex],
+        PlayedIndex,
+        pPlayed);
+      if (!pPlayed)
+      {
+        continue;
+      }
+
+      Events.clear();
+      InstantiatePattern(*pPlayed, pPlayTrack, Events);
+      PatternEvent.mIsDirect = false;
+      for (
+        vector<JZEvent*>::const_iterator iEvent = Events.begin();
+        iEvent != Events.end();
+        ++iEvent)
+      {
+        PatternEvent.mpEvent = *iEvent;
+        Pattern.mEvents.push_back(PatternEvent);
+      }
+    }
+    else
+    {
+      PatternEvent.mpEvent = pEvent->Copy();
+      PatternEvent.mpEvent->SetDevice(Track.GetDevice());
+      PatternEvent.mIsDirect = true;
+      Pattern.mEvents.push_back(PatternEvent);
+    }
+  }
+
+  Pattern.mIsBuilding = false;
+  Pattern.mIsValid = true;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The pattern events are only copied into track caches, never referenced
+// by the play buffer, so they can be deleted right away.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::ClearPattern(JZPatternCache& Pattern)
+{
+  for (
+    vector<JZPatternEvent>::const_iterator iPatternEvent =
+      Pattern.mEvents.begin();
+    iPatternEvent != Pattern.mEvents.end();
+    ++iPatternEvent)
+  {
+    delete iPatternEvent->mpEvent;
+  }
+  Pattern.mEvents.clear();
+  Pattern.mDependencies.clear();
+  Pattern.mIsValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The pattern is looped for the duration of the play track event.  The
+// last pass only plays the events anchored before the end of the play track
+// event.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::InstantiatePattern(
+  const JZPatternCache& Pattern,
+  const JZPlayTrackEvent* pPlayTrack,
+  vector<JZEvent*>& Events)
+{
+  if (Pattern.mLength <= 0)
+  {
+    return;
+  }
+
+  for (
+    int LoopOffset = 0;
+    LoopOffset < pPlayTrack->eventlength;
+    LoopOffset += Pattern.mLength)
+  {
+    int Offset = pPlayTrack->GetClock() + LoopOffset;
+    int EndClock = pPlayTrack->eventlength - LoopOffset;
+    for (
+      vector<JZPatternEvent>::const_iterator iPatternEvent =
+        Pattern.mEvents.begin();
+      iPatternEvent != Pattern.mEvents.end() &&
+        iPatternEvent->mAnchorClock < EndClock;
+      ++iPatternEvent)
+    {
+      JZEvent* pEventCopy = iPatternEvent->mpEvent->Copy();
+      pEventCopy->SetClock(pEventCopy->GetClock() + Offset);
+
+      JZKeyOnEvent* pKeyOn = pEventCopy->IsKeyOn();
+      if (pKeyOn && iPatternEvent->mIsDirect)
+      {
+        pKeyOn->SetKey(pKeyOn->GetKey() + pPlayTrack->transpose);
+      }
+
+      Events.push_back(pEventCopy);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZPlaybackSchedule::AreDependenciesValid(
+  const JZSong& Song,
+  const vector<JZDependency>& Dependencies)
+{
+  for (
+    vector<JZDependency>::const_iterator iDependency = Dependencies.begin();
+    iDependency != Dependencies.end();
+    ++iDependency)
+  {
+    const JZTrack& Played = Song.mTracks[iDependency->mTrackIndex];
+    if (
+      iDependency->mRevision != Played.GetRevision() ||
+      iDependency->mDevice != Played.GetDevice())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::AddDependencies(
+  vector<JZDependency>& Dependencies,
+  const JZTrack& Track,
+  int TrackIndex,
+  const JZPatternCache* pPattern)
+{
+  JZDependency Dependency;
+  Dependency.mTrackIndex = TrackIndex;
+  Dependency.mRevision = Track.GetRevision();
+  Dependency.mDevice = Track.GetDevice();
+
+  vector<JZDependency> Added(1, Dependency);
+  if (pPattern)
+  {
+    Added.insert(
+      Added.end(),
+      pPattern->mDependencies.begin(),
+      pPattern->mDependencies.end());
+  }
+
+  for (
+    vector<JZDependency>::const_iterator iAdded = Added.begin();
+    iAdded != Added.end();
+    ++iAdded)
+  {
+    bool IsKnown = false;
+    for (
+      vector<JZDependency>::const_iterator iDependency = Dependencies.begin();
+      iDependency != Dependencies.end();
+      ++iDependency)
+    {
+      if (iDependency->mTrackIndex == iAdded->mTrackIndex)
+      {
+        IsKnown = true;
+        break;
+      }
+    }
+    if (!IsKnown)
+    {
+      Dependencies.push_back(*iAdded);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Walk the entries of a track once and save the chase state at the start
+// of every ChaseCheckpointBars bars.  The first checkpoint is at clock 0 and
+// the last one follows the last entry.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::BuildChaseCheckpoints(int TrackIndex)
+{
+  JZTrackCache& Cache = mTrackCaches[TrackIndex];
+  const vector<JZScheduleEntry>& Entries = Cache.mEntries;
+  int EntryCount = static_cast<int>(Entries.size());
+
+  Cache.mChaseIsValid = true;
+  Cache.mChaseCheckpoints.clear();
+  mChaseState.Clear();
+
+  JZBarInfo BarInfo(mSong);
+  BarInfo.SetBar(0);
+  int EntryIndex = 0;
+  while (true)
+  {
+    int Clock = BarInfo.GetClock();
+    while (EntryIndex < EntryCount && Entries[EntryIndex].mClock < Clock)
+    {
+      mChaseState.Apply(Entries[EntryIndex].mpEvent);
+      ++EntryIndex;
+    }
+
+    Cache.mChaseCheckpoints.push_back(JZChaseCheckpoint());
+    JZChaseCheckpoint& Checkpoint = Cache.mChaseCheckpoints.back();
+    Checkpoint.mClock = Clock;
+    Checkpoint.mEntryIndex = EntryIndex;
+    mChaseState.GetEvents(Checkpoint.mEvents);
+
+    if (EntryIndex == EntryCount)
+    {
+      break;
+    }
+
+    for (int Bar = 0; Bar < ChaseCheckpointBars; ++Bar)
+    {
+      BarInfo.Next();
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZPlaybackSchedule::IsClockBeforeCheckpoint(
+  int Clock,
+  const JZChaseCheckpoint& Checkpoint)
+{
+  return Clock < Checkpoint.mClock;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Set tempo events without a tempo are skipped.  Of several tempo changes
+// at the same clock the last one counts.
+//-----------------------------------------------------------------------------
+void JZPlaybackSchedule::BuildTempoMap()
+{
+  mTempoMap.clear();
+
+  const vector<JZScheduleEntry>& Entries = mTrackCaches[0].mEntries;
+  for (
+    vector<JZScheduleEntry>::const_iterator iEntry = Entries.begin();
+    iEntry != Entries.end();
+    ++iEntry)
+  {
+    JZSetTempoEvent* pSetTempo = iEntry->mpEvent->IsSetTempo();
+    if (!pSetTempo || pSetTempo->GetBPM() <= 0)
+    {
+      continue;
+    }
+
+    JZTempoChange TempoChange;
+    TempoChange.mClock = iEntry->mClock;
+    TempoChange.mBpm = pSetTempo->GetBPM();
+    if (!mTempoMap.empty() && mTempoMap.back().mClock == TempoChange.mClock)
+    {
+      mTempoMap.back() = TempoChange;
+    }
+    else
+    {
+      mTempoMap.push_back(TempoChange);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZPlaybackSchedule::IsClockBeforeTempoChange(
+  int Clock,
+  const JZTempoChange& TempoChange)
+{
+  return Clock < TempoChange.mClock;
+}
+
+//*****************************************************************************
+// Description:
+//   This is the schedule merger class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZScheduleMerger::JZScheduleMerger()
+  : mHeap(),
+    mRunCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZScheduleMerger::Clear()
+{
+  mHeap.clear();
+  mRunCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZScheduleMerger::AddRun(
+  const vector<JZScheduleEntry>& Entries,
+  int Begin,
+  int End)
+{
+  if (Begin < End)
+  {
+    JZRun Run;
+    Run.mpNext = &Entries[0] + Begin;
+    Run.mpEnd = &Entries[0] + End;
+    Run.mRunIndex = mRunCount;
+    mHeap.push_back(Run);
+    push_heap(mHeap.begin(), mHeap.end(), IsRunAfter);
+  }
+  ++mRunCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+const JZScheduleEntry* JZScheduleMerger::Next()
+{
+  if (mHeap.empty())
+  {
+    return 0;
+  }
+
+  pop_heap(mHeap.begin(), mHeap.end(), IsRunAfter);
+  JZRun& Run = mHeap.back();
+  const JZScheduleEntry* pEntry = Run.mpNext++;
+  if (Run.mpNext == Run.mpEnd)
+  {
+    mHeap.pop_back();
+  }
+  else
+  {
+    push_heap(mHeap.begin(), mHeap.end(), IsRunAfter);
+  }
+  return pEntry;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The heap functions build a max-heap, so the run whose next entry comes
+// later compares less.
+//-----------------------------------------------------------------------------
+bool JZScheduleMerger::IsRunAfter(const JZRun& Lhs, const JZRun& Rhs)
+{
+  if (IsEntryBefore(*Rhs.mpNext, *Lhs.mpNext))
+  {
+    return true;
+  }
+  if (IsEntryBefore(*Lhs.mpNext, *Rhs.mpNext))
+  {
+    return false;
+  }
+  return Lhs.mRunIndex > Rhs.mRunIndex;
+}
@@ -0,0 +1,378 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include "ChaseState.h"
+#include "Globals.h"
+#include "Track.h"
+
+#include <deque>
+#include <vector>
+
+class JZPlayTrackEvent;
+class JZSong;
+
+//*****************************************************************************
+// Description:
+//   One event of the playback schedule.  The event is owned by the schedule.
+// For key off events that were created from the length of a key on event,
+// mOnClock is the clock of that key on event, otherwise it equals mClock.
+//*****************************************************************************
+struct JZScheduleEntry
+{
+  int mClock;
+  int mOnClock;
+  int mTrackIndex;
+  JZEvent* mpEvent;
+};
+
+//*****************************************************************************
+// Description:
+//   A tempo change of the playback schedule, taken from a set tempo event of
+// track 0.
+//*****************************************************************************
+struct JZTempoChange
+{
+  int mClock;
+  int mBpm;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the playback schedule class declaration.  The schedule holds a
+// flattened copy of every track in a song with the track device resolved,
+// key on lengths turned into key off events (except on audio tracks) and
+// play track events expanded.  Each flattened track is in clock order, so
+// the player can find the events of a time window with a binary search and
+// merge the playing tracks with a JZScheduleMerger instead of copying and
+// sorting them on every timer tick.  A flattened track is only rebuilt
+// after the track, or a track it plays, has been edited.
+//
+//   The play buffer references the schedule events instead of copying them.
+// Events that are no longer part of the schedule, because their track was
+// rebuilt or because they were only created for one output window, are
+// retired instead of deleted.  Every update starts a new epoch, play buffer
+// records remember the epoch they were created in, and the player reclaims
+// retired events once no record of their epoch is left.
+//
+//   For starting playback in the middle of a song, the schedule also keeps
+// chase checkpoints for every track: the channel state (see JZChaseState)
+// every few bars.  They are built the first time they are needed after the
+// track was rebuilt, so the state at any clock is found with a binary search
+// and the events since the preceding checkpoint.
+//
+//   The tempo changes of track 0 are kept in a tempo map that is rebuilt
+// with the track, so the tempo at any clock is found with a binary search.
+//
+//   Play track events are expanded from patterns: the flattened events of a
+// track that is played by play track events, with its own play track events
+// already expanded.  A pattern is built once and shared by all play track
+// events that reference it, until the track or one of the tracks it plays is
+// edited.  References form a graph; a reference back to a pattern that is
+// still being built would be a cycle and is dropped.
+//*****************************************************************************
+class JZPlaybackSchedule
+{
+  public:
+
+    JZPlaybackSchedule(JZSong& Song);
+
+    ~JZPlaybackSchedule();
+
+    // Force a rebuild of one track or of all tracks on the next update.
+    // Only needed for edits that bypass JZEventArray::Cleanup().
+    void Invalidate(int TrackIndex);
+    void InvalidateAll();
+
+    // Rebuild the tracks that changed since the last update and start a new
+    // epoch.
+    void Update();
+
+    unsigned GetEpoch() const;
+
+    // The generation changes whenever a track is rebuilt, so anything
+    // derived from the schedule can tell if it is out of date.
+    unsigned GetGeneration() const;
+
+    // Take ownership of an event that may still be referenced by play buffer
+    // records of the current epoch.
+    void Retire(JZEvent* pEvent);
+
+    // Delete the retired events that can only be referenced by records older
+    // than the passed epoch.
+    void Reclaim(unsigned OldestEpochInUse);
+
+    // The clock ordered entries of one track.
+    const std::vector<JZScheduleEntry>& GetEntries(int TrackIndex) const;
+
+    // Return the index of the first entry at or after the passed clock.
+    static int Find(const std::vector<JZScheduleEntry>& Entries, int Clock);
+
+    // The tempo changes of track 0 in clock order, one per clock.
+    const std::vector<JZTempoChange>& GetTempoMap() const;
+
+    // Return the index of the first tempo change after the passed clock.
+    int FindTempoChange(int Clock) const;
+
+    // Put entries into schedule order, key offs first at the same clock.
+    static void Sort(std::vector<JZScheduleEntry>& Entries);
+
+    // Append the events that set the channel state of a track at the passed
+    // clock, in the order they should be sent.  The events belong to the
+    // schedule, so Update() must have been called after the last edit.
+    void GetChaseEvents(
+      int TrackIndex,
+      int Clock,
+      std::vector<JZEvent*>& Events);
+
+  private:
+
+    struct JZRetiredEvent
+    {
+      unsigned mEpoch;
+      JZEvent* mpEvent;
+    };
+
+    struct JZDependency
+    {
+      int mTrackIndex;
+      unsigned mRevision;
+      int mDevice;
+    };
+
+    struct JZPatternEvent
+    {
+      // Owned by the pattern, with the clock relative to the pattern start.
+      JZEvent* mpEvent;
+
+      // The clock of the event in the pattern track, or of the play track
+      // event it was expanded from.  A reference that is shorter than the
+      // pattern only plays the events with an anchor clock before its end.
+      int mAnchorClock;
+
+      // Only the events of the pattern track itself are transposed by the
+      // play track events that reference the pattern.
+      bool mIsDirect;
+    };
+
+    struct JZPatternCache
+    {
+      JZPatternCache();
+
+      bool mIsValid;
+      bool mIsBuilding;
+      unsigned mRevision;
+      int mDevice;
+
+      // The pattern repeats after this number of ticks.
+      int mLength;
+
+      // Tracks played through play track events, directly or indirectly.
+      std::vector<JZDependency> mDependencies;
+
+      // In anchor clock order.
+      std::vector<JZPatternEvent> mEvents;
+    };
+
+    struct JZChaseCheckpoint
+    {
+      int mClock;
+
+      // The index of the first entry at or after mClock.
+      int mEntryIndex;
+
+      // The chase state of the entries before mClock.
+      std::vector<JZEvent*> mEvents;
+    };
+
+    struct JZTrackCache
+    {
+      JZTrackCache();
+
+      bool mIsValid;
+      unsigned mRevision;
+      int mDevice;
+      bool mAudioMode;
+
+      // Tracks referenced by play track events.
+      std::vector<JZDependency> mDependencies;
+
+      // Owns the copied events.
+      JZSimpleEventArray mEvents;
+
+      std::vector<JZScheduleEntry> mEntries;
+
+      bool mChaseIsValid;
+      std::vector<JZChaseCheckpoint> mChaseCheckpoints;
+    };
+
+    bool IsTrackValid(int TrackIndex) const;
+
+    void BuildTrack(int TrackIndex);
+
+    void ExpandPlayTrack(JZTrackCache& Cache, JZPlayTrackEvent* pPlayTrack);
+
+    bool IsPatternValid(int TrackIndex) const;
+
+    // Returns 0 for an invalid track index or if the pattern is being built,
+    // that is the reference is part of a cycle.
+    const JZPatternCache* GetPattern(int TrackIndex);
+
+    void BuildPattern(int TrackIndex);
+
+    void ClearPattern(JZPatternCache& Pattern);
+
+    // Append copies of the pattern events played by a play track event.
+    static void InstantiatePattern(
+      const JZPatternCache& Pattern,
+      const JZPlayTrackEvent* pPlayTrack,
+      std::vector<JZEvent*>& Events);
+
+    static bool AreDependenciesValid(
+      const JZSong& Song,
+      const std::vector<JZDependency>& Dependencies);
+
+    // Add a dependency on a track and on everything its pattern depends on.
+    static void AddDependencies(
+      std::vector<JZDependency>& Dependencies,
+      const JZTrack& Track,
+      int TrackIndex,
+      const JZPatternCache* pPattern);
+
+    void BuildChaseCheckpoints(int TrackIndex);
+
+    static bool IsClockBeforeCheckpoint(
+      int Clock,
+      const JZChaseCheckpoint& Checkpoint);
+
+    void BuildTempoMap();
+
+    static bool IsClockBeforeTempoChange(
+      int Clock,
+      const JZTempoChange& TempoChange);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZPlaybackSchedule(const JZPlaybackSchedule&);
+    JZPlaybackSchedule& operator = (const JZPlaybackSchedule&);
+
+  private:
+
+    JZSong& mSong;
+
+    JZTrackCache mTrackCaches[eMaxTrackCount];
+
+    JZPatternCache mPatternCaches[eMaxTrackCount];
+
+    unsigned mEpoch;
+
+    unsigned mGeneration;
+
+    // In epoch order.
+    std::deque<JZRetiredEvent> mRetiredEvents;
+
+    // Scratch state for building and searching chase checkpoints.
+    JZChaseState mChaseState;
+
+    std::vector<JZTempoChange> mTempoMap;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the schedule merger class declaration.  It merges several clock
+// ordered runs of schedule entries with a min-heap, so the output is in
+// clock order without sorting.  Entries with the same clock come out key
+// offs first and otherwise in the order the runs were added.
+//*****************************************************************************
+class JZScheduleMerger
+{
+  public:
+
+    JZScheduleMerger();
+
+    void Clear();
+
+    // Add the entries [Begin, End) of the passed clock ordered list.
+    void AddRun(
+      const std::vector<JZScheduleEntry>& Entries,
+      int Begin,
+      int End);
+
+    // Return the next entry in clock order, or 0 if all runs are exhausted.
+    const JZScheduleEntry* Next();
+
+  private:
+
+    struct JZRun
+    {
+      const JZScheduleEntry* mpNext;
+      const JZScheduleEntry* mpEnd;
+      int mRunIndex;
+    };
+
+    static bool IsRunAfter(const JZRun& Lhs, const JZRun& Rhs);
+
+  private:
+
+    std::vector<JZRun> mHeap;
+
+    int mRunCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the playback schedule class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZPlaybackSchedule::GetEpoch() const
+{
+  return mEpoch;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZPlaybackSchedule::GetGeneration() const
+{
+  return mGeneration;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const std::vector<JZScheduleEntry>& JZPlaybackSchedule::GetEntries(
+  int TrackIndex) const
+{
+  return mTrackCaches[TrackIndex].mEntries;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const std::vector<JZTempoChange>& JZPlaybackSchedule::GetTempoMap() const
+{
+  return mTempoMap;
+}
@@ -0,0 +1,165 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "PlaybackStatistics.h"
+
+#include <ostream>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the histogram class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZHistogram::JZHistogram()
+{
+  Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Counts added while clearing may survive, which does not matter for
+// statistics.
+//-----------------------------------------------------------------------------
+void JZHistogram::Clear()
+{
+  for (int Bucket = 0; Bucket < eBucketCount; ++Bucket)
+  {
+    mBuckets[Bucket].store(0, memory_order_relaxed);
+  }
+  mCount.store(0, memory_order_relaxed);
+  mMaximum.store(0, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZHistogram::Add(unsigned Value)
+{
+  mBuckets[GetBucket(Value)].fetch_add(1, memory_order_relaxed);
+  mCount.fetch_add(1, memory_order_relaxed);
+
+  unsigned Maximum = mMaximum.load(memory_order_relaxed);
+  while (
+    Value > Maximum &&
+    !mMaximum.compare_exchange_weak(Maximum, Value, memory_order_relaxed))
+  {
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+unsigned JZHistogram::GetBucketMinimum(int Bucket)
+{
+  if (Bucket == 0)
+  {
+    return 0;
+  }
+  return 1u << (Bucket - 1);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZHistogram::GetBucket(unsigned Value)
+{
+  int Bucket = 0;
+  while (Value != 0 && Bucket < eBucketCount - 1)
+  {
+    Value >>= 1;
+    ++Bucket;
+  }
+  return Bucket;
+}
+
+//*****************************************************************************
+// Description:
+//   This is the playback statistics class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackStatistics::JZPlaybackStatistics()
+  : mHandOffLeadHistogram(),
+    mHandOffLatenessHistogram(),
+    mDispatchLatenessHistogram(),
+    mNotifyTimeHistogram(),
+    mThruLatencyHistogram(),
+    mSyncJitterHistogram(),
+    mUnderrunCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatistics::Clear()
+{
+  mHandOffLeadHistogram.Clear();
+  mHandOffLatenessHistogram.Clear();
+  mDispatchLatenessHistogram.Clear();
+  mNotifyTimeHistogram.Clear();
+  mThruLatencyHistogram.Clear();
+  mSyncJitterHistogram.Clear();
+  mUnderrunCount.store(0, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatistics::Write(ostream& Os) const
+{
+  unsigned OnTimeCount = mHandOffLeadHistogram.GetCount();
+  unsigned LateCount = mHandOffLatenessHistogram.GetCount();
+
+  Os
+    << "handoffs " << OnTimeCount + LateCount << '\n'
+    << "late_handoffs " << LateCount << '\n'
+    << "dispatch_samples " << mDispatchLatenessHistogram.GetCount() << '\n'
+    << "underruns " << GetUnderrunCount() << '\n'
+    << "notify_calls " << mNotifyTimeHistogram.GetCount() << '\n'
+    << "thru_events " << mThruLatencyHistogram.GetCount() << '\n'
+    << "sync_messages " << mSyncJitterHistogram.GetCount() << '\n';
+
+  WriteHistogram(Os, "handoff_lead_ticks", mHandOffLeadHistogram);
+  WriteHistogram(Os, "handoff_late_ticks", mHandOffLatenessHistogram);
+  WriteHistogram(Os, "dispatch_late_us", mDispatchLatenessHistogram);
+  WriteHistogram(Os, "notify_us", mNotifyTimeHistogram);
+  WriteHistogram(Os, "thru_us", mThruLatencyHistogram);
+  WriteHistogram(Os, "sync_jitter_us", mSyncJitterHistogram);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Write the maximum and one line per bucket, named after the smallest
+// value in the bucket.
+//-----------------------------------------------------------------------------
+void JZPlaybackStatistics::WriteHistogram(
+  ostream& Os,
+  const string& Name,
+  const JZHistogram& Histogram)
+{
+  Os << Name << "_max " << Histogram.GetMaximum() << '\n';
+  for (int Bucket = 0; Bucket < JZHistogram::eBucketCount; ++Bucket)
+  {
+    Os
+      << Name << "_from_" << JZHistogram::GetBucketMinimum(Bucket) << ' '
+      << Histogram.GetBucketCount(Bucket) << '\n';
+  }
+}
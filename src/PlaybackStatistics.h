@@ -0,0 +1,307 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+
+//*****************************************************************************
+// Description:
+//   This is the histogram class declaration.  Values are counted in buckets
+// of powers of two: bucket 0 counts the value 0, bucket n counts the values
+// from 2^(n-1) to 2^n - 1 and the last bucket counts everything above.  The
+// counters are atomic, so the player can add values while the user
+// interface reads them without a lock.
+//*****************************************************************************
+class JZHistogram
+{
+  public:
+
+    enum
+    {
+      eBucketCount = 16
+    };
+
+    JZHistogram();
+
+    void Clear();
+
+    void Add(unsigned Value);
+
+    unsigned GetCount() const;
+
+    unsigned GetBucketCount(int Bucket) const;
+
+    unsigned GetMaximum() const;
+
+    // The smallest value counted in a bucket.
+    static unsigned GetBucketMinimum(int Bucket);
+
+  private:
+
+    static int GetBucket(unsigned Value);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZHistogram(const JZHistogram&);
+    JZHistogram& operator = (const JZHistogram&);
+
+  private:
+
+    std::atomic<unsigned> mBuckets[eBucketCount];
+
+    std::atomic<unsigned> mCount;
+
+    std::atomic<unsigned> mMaximum;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the playback statistics class declaration.  Every player keeps
+// these statistics about the events it hands to its driver: how many clock
+// ticks ahead of their clock (lead) or behind it (lateness) the events were
+// handed off, how long the Notify() calls took and how often the play buffer
+// ran dry, that is the first event of a flush was already due.  The hand-off
+// lead only tells how far ahead the player fills the driver queue.  Drivers
+// that can tell when an event actually left add how many microseconds after
+// its scheduled time that was (dispatch lateness).  A MIDI thru running in
+// its own thread adds the time from the arrival of each event to its output,
+// and a sync generator adds how late it sent each MIDI clock or MTC quarter
+// frame message.
+//
+//   The report written by Write() has one "name value" pair per line, so
+// reports of different builds or settings can be compared with diff.
+//*****************************************************************************
+class JZPlaybackStatistics
+{
+  public:
+
+    JZPlaybackStatistics();
+
+    void Clear();
+
+    // An event was handed to the driver LeadTicks clock ticks before its
+    // clock.  A negative lead means the event was late.
+    void AddHandOff(int LeadTicks);
+
+    // An event left the driver Microseconds after its scheduled time.
+    void AddDispatchLateness(unsigned Microseconds);
+
+    void AddNotifyTime(unsigned Microseconds);
+
+    void AddUnderrun();
+
+    void AddThruLatency(unsigned Microseconds);
+
+    void AddSyncJitter(unsigned Microseconds);
+
+    const JZHistogram& GetHandOffLeadHistogram() const;
+
+    const JZHistogram& GetHandOffLatenessHistogram() const;
+
+    const JZHistogram& GetDispatchLatenessHistogram() const;
+
+    const JZHistogram& GetNotifyTimeHistogram() const;
+
+    const JZHistogram& GetThruLatencyHistogram() const;
+
+    const JZHistogram& GetSyncJitterHistogram() const;
+
+    unsigned GetUnderrunCount() const;
+
+    void Write(std::ostream& Os) const;
+
+  private:
+
+    static void WriteHistogram(
+      std::ostream& Os,
+      const std::string& Name,
+      const JZHistogram& Histogram);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZPlaybackStatistics(const JZPlaybackStatistics&);
+    JZPlaybackStatistics& operator = (const JZPlaybackStatistics&);
+
+  private:
+
+    JZHistogram mHandOffLeadHistogram;
+
+    JZHistogram mHandOffLatenessHistogram;
+
+    JZHistogram mDispatchLatenessHistogram;
+
+    JZHistogram mNotifyTimeHistogram;
+
+    JZHistogram mThruLatencyHistogram;
+
+    JZHistogram mSyncJitterHistogram;
+
+    std::atomic<unsigned> mUnderrunCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the histogram class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZHistogram::GetCount() const
+{
+  return mCount.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZHistogram::GetBucketCount(int Bucket) const
+{
+  return mBuckets[Bucket].load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZHistogram::GetMaximum() const
+{
+  return mMaximum.load(std::memory_order_relaxed);
+}
+
+//*****************************************************************************
+// Description:
+//   These are the playback statistics class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddHandOff(int LeadTicks)
+{
+  if (LeadTicks < 0)
+  {
+    mHandOffLatenessHistogram.Add(-LeadTicks);
+  }
+  else
+  {
+    mHandOffLeadHistogram.Add(LeadTicks);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddDispatchLateness(unsigned Microseconds)
+{
+  mDispatchLatenessHistogram.Add(Microseconds);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddNotifyTime(unsigned Microseconds)
+{
+  mNotifyTimeHistogram.Add(Microseconds);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddUnderrun()
+{
+  mUnderrunCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddThruLatency(unsigned Microseconds)
+{
+  mThruLatencyHistogram.Add(Microseconds);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+void JZPlaybackStatistics::AddSyncJitter(unsigned Microseconds)
+{
+  mSyncJitterHistogram.Add(Microseconds);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetHandOffLeadHistogram() const
+{
+  return mHandOffLeadHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetHandOffLatenessHistogram() const
+{
+  return mHandOffLatenessHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetDispatchLatenessHistogram() const
+{
+  return mDispatchLatenessHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetNotifyTimeHistogram() const
+{
+  return mNotifyTimeHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetThruLatencyHistogram() const
+{
+  return mThruLatencyHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+const JZHistogram& JZPlaybackStatistics::GetSyncJitterHistogram() const
+{
+  return mSyncJitterHistogram;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZPlaybackStatistics::GetUnderrunCount() const
+{
+  return mUnderrunCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,145 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "PlaybackStatisticsDialog.h"
+
+#include "Player.h"
+
+#include <wx/button.h>
+#include <wx/filedlg.h>
+#include <wx/msgdlg.h>
+#include <wx/sizer.h>
+#include <wx/textctrl.h>
+
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the playback statistics dialog class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+BEGIN_EVENT_TABLE(JZPlaybackStatisticsDialog, wxDialog)
+  EVT_BUTTON(wxID_REFRESH, JZPlaybackStatisticsDialog::OnRefresh)
+  EVT_BUTTON(wxID_CLEAR, JZPlaybackStatisticsDialog::OnClear)
+  EVT_BUTTON(wxID_SAVE, JZPlaybackStatisticsDialog::OnSave)
+END_EVENT_TABLE()
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlaybackStatisticsDialog::JZPlaybackStatisticsDialog(
+  wxWindow* pParent,
+  JZPlayer& Player)
+  : wxDialog(pParent, wxID_ANY, "Playback Statistics"),
+    mPlayer(Player),
+    mpReportTextCtrl(nullptr)
+{
+  mpReportTextCtrl = new wxTextCtrl(
+    this,
+    wxID_ANY,
+    wxEmptyString,
+    wxDefaultPosition,
+    wxSize(300, 400),
+    wxTE_MULTILINE | wxTE_READONLY);
+
+  wxButton* pRefreshButton = new wxButton(this, wxID_REFRESH, "&Refresh");
+  wxButton* pClearButton = new wxButton(this, wxID_CLEAR, "&Clear");
+  wxButton* pSaveButton = new wxButton(this, wxID_SAVE, "&Save...");
+  wxButton* pCloseButton = new wxButton(this, wxID_OK, "Close");
+  pCloseButton->SetDefault();
+
+  wxBoxSizer* pTopSizer = new wxBoxSizer(wxVERTICAL);
+  wxBoxSizer* pButtonSizer = new wxBoxSizer(wxHORIZONTAL);
+
+  pTopSizer->Add(mpReportTextCtrl, 1, wxEXPAND | wxALL, 6);
+
+  pButtonSizer->Add(pRefreshButton, 0, wxALL, 5);
+  pButtonSizer->Add(pClearButton, 0, wxALL, 5);
+  pButtonSizer->Add(pSaveButton, 0, wxALL, 5);
+  pButtonSizer->Add(pCloseButton, 0, wxALL, 5);
+
+  pTopSizer->Add(pButtonSizer, 0, wxALIGN_CENTER | wxBOTTOM, 6);
+
+  SetAutoLayout(true);
+  SetSizer(pTopSizer);
+
+  pTopSizer->SetSizeHints(this);
+  pTopSizer->Fit(this);
+
+  ShowStatistics();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatisticsDialog::ShowStatistics()
+{
+  ostringstream Oss;
+  mPlayer.WriteStatistics(Oss);
+  mpReportTextCtrl->SetValue(Oss.str());
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatisticsDialog::OnRefresh(wxCommandEvent& Event)
+{
+  ShowStatistics();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatisticsDialog::OnClear(wxCommandEvent& Event)
+{
+  mPlayer.GetStatistics().Clear();
+  ShowStatistics();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlaybackStatisticsDialog::OnSave(wxCommandEvent& Event)
+{
+  wxFileDialog SaveAsDialog(
+    this,
+    "Save Playback Statistics",
+    "",
+    "",
+    "Text files (txt)|*.txt|All files (*.*)|*.*",
+    wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+  if (SaveAsDialog.ShowModal() == wxID_OK)
+  {
+    wxString FileName = SaveAsDialog.GetPath();
+    ofstream Ofs(FileName.mb_str());
+    if (Ofs)
+    {
+      mPlayer.WriteStatistics(Ofs);
+    }
+    if (!Ofs)
+    {
+      ::wxMessageBox(
+        "Unable to write " + FileName,
+        "Error",
+        wxOK | wxICON_ERROR);
+    }
+  }
+}
@@ -0,0 +1,59 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <wx/dialog.h>
+
+class JZPlayer;
+class wxTextCtrl;
+
+//*****************************************************************************
+// Description:
+//   This is the playback statistics dialog class declaration.  It shows the
+// timing statistics of the MIDI player and its driver and can save them to a
+// file.
+//*****************************************************************************
+class JZPlaybackStatisticsDialog : public wxDialog
+{
+  public:
+
+    JZPlaybackStatisticsDialog(wxWindow* pParent, JZPlayer& Player);
+
+  private:
+
+    void ShowStatistics();
+
+    void OnRefresh(wxCommandEvent& Event);
+
+    void OnClear(wxCommandEvent& Event);
+
+    void OnSave(wxCommandEvent& Event);
+
+  private:
+
+    JZPlayer& mPlayer;
+
+    wxTextCtrl* mpReportTextCtrl;
+
+  DECLARE_EVENT_TABLE()
+};
@@ -24,6 +24,7 @@
 
 #include "ProjectManager.h"
 #include "Synth.h"
+#include "SysExSender.h"
 #include "TrackFrame.h"
 #include "TrackWindow.h"
 #include "EventWindow.h"
@@ -33,8 +34,10 @@
 
 #include <wx/choicdlg.h>
 #include <wx/msgdlg.h>
+#include <wx/stopwatch.h>
 
 //#include <unistd.h>
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -49,22 +52,6 @@
                                 // information every 15'th
                                 // tick
 
-#define FIRST_DELTACLOCK 720    // First time send events up to
-                                // 720 ticks ahead in time
-                                // (often 6 quarter
-                                // notes)
-
-#define DELTACLOCK 960          // Later send events up to
-                                // 960 ticks ahead in time
-                                // (often 8 quarter
-                                // notes)
-
-#define ADVANCE_PLAY 480        // Send more events to midinetd
-                                // 480 ticks in time ahead of last
-                                // written events (often 4
-                                // quarternotes, which is also
-                                // often one bar).
-
 char *midinethost = NULL;
 char *midinetservice = NULL;
 
@@ -90,12 +77,42 @@ JZDeviceList::~JZDeviceList()
 
 //*****************************************************************************
 //*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlayLoop::JZLoopCache::JZLoopCache()
+  : mIsValid(false),
+    mGeneration(0),
+    mMetronomeInfo(),
+    mIsTrackPlaying(),
+    mRecords()
+{
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 JZPlayLoop::JZPlayLoop()
   : mStartClock(0),
-    mStopClock(0)
+    mStopClock(0),
+    mRestartClock(0),
+    mIsTrackPlaying()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZPlayLoop::~JZPlayLoop()
 {
+  for (int CacheIndex = 0; CacheIndex < 2; ++CacheIndex)
+  {
+    vector<JZPlayRecord>& Records = mLoopCaches[CacheIndex].mRecords;
+    for (
+      vector<JZPlayRecord>::iterator iRecord = Records.begin();
+      iRecord != Records.end();
+      ++iRecord)
+    {
+      delete iRecord->mpEvent;
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -103,6 +120,16 @@ JZPlayLoop::JZPlayLoop()
 void JZPlayLoop::Reset()
 {
   mStartClock = mStopClock = 0;
+  mRestartClock = 0;
+  mLoopCaches[0].mIsValid = false;
+  mLoopCaches[1].mIsValid = false;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayLoop::Restart(int Clock)
+{
+  mRestartClock = Clock;
 }
 
 //-----------------------------------------------------------------------------
@@ -111,6 +138,8 @@ void JZPlayLoop::Set(int Start, int Stop)
 {
   mStartClock = Start;
   mStopClock = Stop;
+  mLoopCaches[0].mIsValid = false;
+  mLoopCaches[1].mIsValid = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -136,13 +165,13 @@ int JZPlayLoop::Int2ExtClock(int Clock)
 //   Copy events from the passed song to output buffer.
 //-----------------------------------------------------------------------------
 void JZPlayLoop::PrepareOutput(
-  JZEventArray* pEventArray,
+  JZPlayBuffer* pPlayBuffer,
   JZSong* pSong,
   int ExtFr,
   int ExtTo,
   bool AudioMode)
 {
-  if (pEventArray == 0)
+  if (pPlayBuffer == 0)
   {
     return;
   }
@@ -150,33 +179,197 @@ void JZPlayLoop::PrepareOutput(
   int From = Ext2IntClock(ExtFr);
   int Delta = ExtFr - From;
   int Size = ExtTo - ExtFr;
+
+  // The song position where the current pass through the song (or loop)
+  // started.  Later passes through a loop always start at mStartClock.
+  int PassClock = mRestartClock - Delta;
+  if (PassClock < mStartClock)
+  {
+    PassClock = mStartClock;
+  }
+
   while (mStopClock && From + Size > mStopClock)
   {
-    pSong->MergeTracks(
+    MergeSegment(
+      pPlayBuffer,
+      pSong,
       From,
       mStopClock,
-      pEventArray,
-      gpProject->GetMetronomeInfo(),
       Delta,
-      AudioMode);
+      AudioMode,
+      PassClock,
+      true);
 
     Size  -= mStopClock - From;
     From   = mStartClock;
     Delta += mStopClock - mStartClock;
+    PassClock = mStartClock;
   }
 
   if (Size > 0)
   {
-    pSong->MergeTracks(
+    MergeSegment(
+      pPlayBuffer,
+      pSong,
       From,
       From + Size,
-      pEventArray,
+      Delta,
+      AudioMode,
+      PassClock,
+      false);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayLoop::PrepareOutput(
+  JZEventArray* pEventArray,
+  JZSong* pSong,
+  int ExtFr,
+  int ExtTo,
+  bool AudioMode)
+{
+  if (pEventArray == 0)
+  {
+    return;
+  }
+
+  JZPlayBuffer PlayBuffer;
+  PrepareOutput(&PlayBuffer, pSong, ExtFr, ExtTo, AudioMode);
+
+  for (int i = 0; i < PlayBuffer.GetCount(); ++i)
+  {
+    const JZPlayRecord& Record = PlayBuffer.GetRecord(i);
+    JZEvent* pEvent = Record.mpEvent->Copy();
+    pEvent->SetClock(Record.mClock);
+    pEvent->SetDevice(Record.mDevice);
+    pEventArray->Put(pEvent);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Merge the song events in [From, To).  Complete passes through the loop
+// are replayed from the loop cache.  The first pass, which may start in the
+// middle of the loop, and playback without a loop are merged from the song.
+//-----------------------------------------------------------------------------
+void JZPlayLoop::MergeSegment(
+  JZPlayBuffer* pPlayBuffer,
+  JZSong* pSong,
+  int From,
+  int To,
+  int Delta,
+  bool AudioMode,
+  int PassClock,
+  bool CloseNotes)
+{
+  if (
+    !mStopClock ||
+    PassClock != mStartClock ||
+    From < mStartClock ||
+    To > mStopClock)
+  {
+    pSong->MergeTracks(
+      From,
+      To,
+      pPlayBuffer,
       gpProject->GetMetronomeInfo(),
       Delta,
-      AudioMode);
+      AudioMode,
+      PassClock,
+      CloseNotes);
+    return;
+  }
+
+  JZLoopCache& Cache = mLoopCaches[AudioMode ? 1 : 0];
+  UpdateLoopCache(Cache, pSong, AudioMode);
+
+  unsigned Epoch = pSong->GetPlaybackSchedule().GetEpoch();
+  vector<JZPlayRecord>::const_iterator iRecord = lower_bound(
+    Cache.mRecords.begin(),
+    Cache.mRecords.end(),
+    From - mStartClock,
+    IsRecordClockBefore);
+  for (
+    ;
+    iRecord != Cache.mRecords.end() && iRecord->mClock < To - mStartClock;
+    ++iRecord)
+  {
+    pPlayBuffer->Put(
+      iRecord->mClock + mStartClock + Delta,
+      iRecord->mDevice,
+      iRecord->mpEvent,
+      Epoch);
   }
 }
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Rebuild the loop cache if the song schedule, the metronome settings or
+// the muted and solo tracks changed since it was built.  The old events may
+// still be referenced by the play buffer, so they are retired to the
+// schedule instead of deleted.
+//-----------------------------------------------------------------------------
+void JZPlayLoop::UpdateLoopCache(
+  JZLoopCache& Cache,
+  JZSong* pSong,
+  bool AudioMode)
+{
+  JZPlaybackSchedule& Schedule = pSong->GetPlaybackSchedule();
+  Schedule.Update();
+
+  const JZMetronomeInfo& MetronomeInfo = gpProject->GetMetronomeInfo();
+  pSong->GetPlayingTracks(mIsTrackPlaying, AudioMode);
+
+  if (
+    Cache.mIsValid &&
+    Cache.mGeneration == Schedule.GetGeneration() &&
+    Cache.mMetronomeInfo == MetronomeInfo &&
+    Cache.mIsTrackPlaying == mIsTrackPlaying)
+  {
+    return;
+  }
+
+  for (
+    vector<JZPlayRecord>::iterator iRecord = Cache.mRecords.begin();
+    iRecord != Cache.mRecords.end();
+    ++iRecord)
+  {
+    Schedule.Retire(iRecord->mpEvent);
+  }
+  Cache.mRecords.clear();
+
+  JZPlayBuffer Pass;
+  pSong->MergeTracks(
+    mStartClock,
+    mStopClock,
+    &Pass,
+    MetronomeInfo,
+    -mStartClock,
+    AudioMode,
+    mStartClock,
+    true);
+
+  for (int i = 0; i < Pass.GetCount(); ++i)
+  {
+    JZPlayRecord Record = Pass.GetRecord(i);
+    Record.mpEvent = Record.mpEvent->Copy();
+    Cache.mRecords.push_back(Record);
+  }
+
+  Cache.mIsValid = true;
+  Cache.mGeneration = Schedule.GetGeneration();
+  Cache.mMetronomeInfo = MetronomeInfo;
+  Cache.mIsTrackPlaying = mIsTrackPlaying;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZPlayLoop::IsRecordClockBefore(const JZPlayRecord& Record, int Clock)
+{
+  return Record.mClock < Clock;
+}
+
 //*****************************************************************************
 //*****************************************************************************
 //-----------------------------------------------------------------------------
@@ -189,7 +382,18 @@ JZPlayer::JZPlayer(JZSong* pSong)
     mPlaying(false),
     mpSong(pSong),
     mpAudioBuffer(nullptr),
-    mSamples(pSong->GetTicksPerQuarter() * pSong->Speed())
+    mSamples(pSong->GetTicksPerQuarter() * pSong->Speed()),
+    mNotifyClock(0),
+    mLookaheadClock(0),
+    mNotifyStopWatch(),
+    mLastNotifyTime(0),
+    mNotifyGapPeak(0),
+    mStatistics(),
+    mDeviceState(),
+    mActiveNotes(),
+    mIsSetupForced(false),
+    mpSysExSender(nullptr),
+    mIsSetupPaced(false)
 {
   DummyDeviceList.Add("default");
   mpPlayLoop = new JZPlayLoop();
@@ -208,6 +412,8 @@ JZPlayer::~JZPlayer()
 //-----------------------------------------------------------------------------
 void JZPlayer::Notify()
 {
+  wxStopWatch NotifyStopWatch;
+
   // called by timer
   int Now = GetRealTimeClock();
 
@@ -218,19 +424,23 @@ void JZPlayer::Notify()
   {
     return;
   }
+  mNotifyClock = Now;
+  MeasureNotifyGap();
 
   // time to put more events
-  if (Now >= (mOutClock - ADVANCE_PLAY))
+  if (Now >= mOutClock - mLookaheadClock / 2)
   {
 #ifdef DEBUG_PLAYER_NOTIFY
     cout << "*** Notify: more events to playbuffer" << endl;
 #endif // DEBUG_PLAYER_NOTIFY
 
+    UpdateLookahead(Now);
+
     mpPlayLoop->PrepareOutput(
       &mPlayBuffer,
       mpSong,
       mOutClock,
-      Now + DELTACLOCK,
+      Now + mLookaheadClock,
       false);
     if (mpAudioBuffer)
     {
@@ -238,11 +448,10 @@ void JZPlayer::Notify()
         mpAudioBuffer,
         mpSong,
         mOutClock,
-        Now + DELTACLOCK,
+        Now + mLookaheadClock,
         true);
     }
-    mOutClock = Now + DELTACLOCK;
-    mPlayBuffer.Length2Keyoff();
+    mOutClock = Now + mLookaheadClock;
   }
 
   // optimization:
@@ -251,8 +460,12 @@ void JZPlayer::Notify()
   //   send them to driver
   // else
   //   tell the driver that there is nothing to do at the moment
-  if (mPlayBuffer.mEventCount && mPlayBuffer.mppEvents[0]->GetClock() < mOutClock)
+  if (!mPlayBuffer.IsEmpty() && mPlayBuffer.GetRecord(0).mClock < mOutClock)
   {
+    if (mPlayBuffer.GetRecord(0).mClock < Now)
+    {
+      mStatistics.AddUnderrun();
+    }
     FlushToDevice();
   }
   else
@@ -260,6 +473,8 @@ void JZPlayer::Notify()
     // Does nothing unless mOutClock has changed.
     OutBreak();
   }
+
+  mStatistics.AddNotifyTime(NotifyStopWatch.TimeInMicro().ToLong());
 }
 
 //-----------------------------------------------------------------------------
@@ -270,22 +485,132 @@ void JZPlayer::FlushToDevice()
 {
   int BufferFull = 0;
 
-  JZEventIterator Iterator(&mPlayBuffer);
-  JZEvent* pEvent = Iterator.Range(0, mOutClock);
-  while (!BufferFull && pEvent)
+  int Count = 0;
+  while (
+    !BufferFull &&
+    Count < mPlayBuffer.GetCount() &&
+    mPlayBuffer.GetRecord(Count).mClock < mOutClock)
   {
-    if (OutEvent(pEvent) != 0)
+    if (OutRecord(mPlayBuffer.GetRecord(Count)) != 0)
       BufferFull = 1;
     else
-    {
-      pEvent->Kill();
-      pEvent = Iterator.Next();
-    }
+      ++Count;
   }
 
   if (!BufferFull)
     OutBreak();
-  mPlayBuffer.Cleanup(0);
+  mPlayBuffer.RemoveFirst(Count);
+  ReclaimPlayedEvents();
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The play buffer is in the order the records were created, so the first
+// record is the oldest one.
+//-----------------------------------------------------------------------------
+void JZPlayer::ReclaimPlayedEvents()
+{
+  JZPlaybackSchedule& Schedule = mpSong->GetPlaybackSchedule();
+  if (mPlayBuffer.IsEmpty())
+  {
+    Schedule.Reclaim(Schedule.GetEpoch() + 1);
+  }
+  else
+  {
+    Schedule.Reclaim(mPlayBuffer.GetRecord(0).mEpoch);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::MeasureNotifyGap()
+{
+  long Time = mNotifyStopWatch.Time();
+  int Gap = Time - mLastNotifyTime;
+  mLastNotifyTime = Time;
+
+  mNotifyGapPeak -= mNotifyGapPeak / 16;
+  if (Gap > mNotifyGapPeak)
+  {
+    mNotifyGapPeak = Gap;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The window is refilled when half of it is left, so half of the window
+// has to last until the next Notify() call, even a late one.  Three times the
+// longest gap leaves some room for the time spent preparing the output.
+//-----------------------------------------------------------------------------
+void JZPlayer::UpdateLookahead(int Clock)
+{
+  int Milliseconds = gpConfig->GetValue(C_PlaybackLatency);
+  if (Milliseconds < 3 * mNotifyGapPeak)
+  {
+    Milliseconds = 3 * mNotifyGapPeak;
+  }
+
+  mLookaheadClock = Milliseconds2Ticks(
+    mpPlayLoop->Ext2IntClock(Clock),
+    Milliseconds);
+  if (mLookaheadClock < 2)
+  {
+    mLookaheadClock = 2;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The remaining time is kept in microseconds times ticks per quarter, so
+// that a tempo segment of n ticks costs exactly n * 60000000 / bpm.  When the
+// window wraps around a loop, the tempo after the loop end is used instead of
+// the one at the loop start, which is close enough for a lookahead.
+//-----------------------------------------------------------------------------
+int JZPlayer::Milliseconds2Ticks(int Clock, int Milliseconds)
+{
+  JZPlaybackSchedule& Schedule = mpSong->GetPlaybackSchedule();
+  Schedule.Update();
+  const vector<JZTempoChange>& TempoMap = Schedule.GetTempoMap();
+
+  // Find the tempo at the passed clock.
+  int Index = Schedule.FindTempoChange(Clock);
+  int Bpm = Index > 0 ? TempoMap[Index - 1].mBpm : mpSong->Speed();
+  if (Bpm <= 0)
+  {
+    Bpm = 120;
+  }
+
+  long long Remaining =
+    (long long)Milliseconds * 1000 * mpSong->GetTicksPerQuarter();
+  int SegmentClock = Clock;
+  int Ticks = 0;
+
+  for (
+    vector<JZTempoChange>::size_type i = Index;
+    i < TempoMap.size();
+    ++i)
+  {
+    long long Cost =
+      (long long)(TempoMap[i].mClock - SegmentClock) * 60000000 / Bpm;
+    if (Cost >= Remaining)
+    {
+      break;
+    }
+
+    Remaining -= Cost;
+    Ticks += TempoMap[i].mClock - SegmentClock;
+    SegmentClock = TempoMap[i].mClock;
+    Bpm = TempoMap[i].mBpm;
+  }
+
+  return Ticks + (int)(Remaining * Bpm / 60000000);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::WriteStatistics(ostream& Os) const
+{
+  mStatistics.Write(Os);
 }
 
 //-----------------------------------------------------------------------------
@@ -297,6 +622,225 @@ void JZPlayer::OutNow(JZTrack* pTrack, JZParam *r)
   OutNow(pTrack, &r->mDataMsb);
   OutNow(pTrack, &r->mResetMsb);
   OutNow(pTrack, &r->mResetLsb);
+  mDeviceState.Update(pTrack->GetDevice(), r);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::OutSetup(JZTrack* pTrack, JZEvent* pEvent)
+{
+  pEvent->SetDevice(pTrack->GetDevice());
+  OutSetup(pEvent);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   All controllers of the parameter are sent even if only the value
+// changed, because the device needs the parameter number for the data entry.
+//-----------------------------------------------------------------------------
+void JZPlayer::OutSetup(JZTrack* pTrack, JZParam* pParam)
+{
+  if (mDeviceState.Update(pTrack->GetDevice(), pParam) || mIsSetupForced)
+  {
+    OutNow(pTrack, pParam);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::OutSetup(JZEvent* pEvent)
+{
+  if (mDeviceState.Update(pEvent->GetDevice(), pEvent) || mIsSetupForced)
+  {
+    mActiveNotes.Update(pEvent->GetDevice(), pEvent);
+    if (mIsSetupPaced)
+    {
+      OutPaced(pEvent);
+    }
+    else
+    {
+      OutNow(pEvent);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The SysEx event data lacks the leading 0xF0 of the MIDI message.
+//-----------------------------------------------------------------------------
+void JZPlayer::GetSysExMessage(
+  JZSysExEvent* pSysEx,
+  vector<unsigned char>& Message)
+{
+  Message.resize(pSysEx->GetDataLength() + 1);
+  Message[0] = 0xF0;
+  copy(
+    pSysEx->GetData(),
+    pSysEx->GetData() + pSysEx->GetDataLength(),
+    Message.begin() + 1);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZPlayer::GetChannelMessage(JZEvent* pEvent, unsigned char* pMessage)
+{
+  int Length = 0;
+
+  switch (pEvent->GetStat())
+  {
+    case StatKeyOn:
+      {
+        JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
+        pMessage[0] = 0x90 | pKeyOn->GetChannel();
+        pMessage[1] = pKeyOn->GetKey();
+        pMessage[2] = pKeyOn->GetVelocity();
+        Length = 3;
+      }
+      break;
+
+    case StatKeyOff:
+      {
+        JZKeyOffEvent* pKeyOff = pEvent->IsKeyOff();
+        pMessage[0] = 0x80 | pKeyOff->GetChannel();
+        pMessage[1] = pKeyOff->GetKey();
+        pMessage[2] = pKeyOff->GetOffVelocity();
+        Length = 3;
+      }
+      break;
+
+    case StatKeyPressure:
+      {
+        JZKeyPressureEvent* pKeyPressure = pEvent->IsKeyPressure();
+        pMessage[0] = 0xA0 | pKeyPressure->GetChannel();
+        pMessage[1] = pKeyPressure->GetKey();
+        pMessage[2] = pKeyPressure->GetPressureValue();
+        Length = 3;
+      }
+      break;
+
+    case StatControl:
+      {
+        JZControlEvent* pControl = pEvent->IsControl();
+        pMessage[0] = 0xB0 | pControl->GetChannel();
+        pMessage[1] = pControl->GetControl();
+        pMessage[2] = pControl->GetControlValue();
+        Length = 3;
+      }
+      break;
+
+    case StatProgram:
+      {
+        JZProgramEvent* pProgram = pEvent->IsProgram();
+        pMessage[0] = 0xC0 | pProgram->GetChannel();
+        pMessage[1] = pProgram->GetProgram();
+        Length = 2;
+      }
+      break;
+
+    case StatChnPressure:
+      {
+        JZChnPressureEvent* pChnPressure = pEvent->IsChnPressure();
+        pMessage[0] = 0xD0 | pChnPressure->GetChannel();
+        pMessage[1] = pChnPressure->Value;
+        Length = 2;
+      }
+      break;
+
+    case StatPitch:
+      {
+        JZPitchEvent* pPitch = pEvent->IsPitch();
+        int Value = pPitch->Value + 8192;
+        pMessage[0] = 0xE0 | pPitch->GetChannel();
+        pMessage[1] = Value & 0x7F;
+        pMessage[2] = (Value >> 7) & 0x7F;
+        Length = 3;
+      }
+      break;
+  }
+
+  return Length;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Only SysEx messages need pacing.  Channel messages are sent at once,
+// unless the device still has SysEx messages to get, like a reset that
+// would wipe them.  Then they are queued behind them, without a pause.
+//-----------------------------------------------------------------------------
+void JZPlayer::OutPaced(JZEvent* pEvent)
+{
+  if (pEvent->GetStat() == StatSysEx)
+  {
+    JZSysExEvent* pSysEx = pEvent->IsSysEx();
+    vector<unsigned char> SysEx;
+    GetSysExMessage(pSysEx, SysEx);
+    mpSysExSender->Send(pEvent->GetDevice(), &SysEx[0], SysEx.size());
+    return;
+  }
+
+  unsigned char Message[3];
+  int Length = GetChannelMessage(pEvent, Message);
+  if (Length == 0 || !mpSysExSender->IsBusy(pEvent->GetDevice()))
+  {
+    OutNow(pEvent);
+    return;
+  }
+  mpSysExSender->Send(pEvent->GetDevice(), Message, Length);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZPlayer::SendSysEx(
+  int Device,
+  JZSysExEvent* pSysEx,
+  JZSysExListener* pListener)
+{
+  if (!mpSysExSender)
+  {
+    OutNow(Device, pSysEx);
+    if (pListener)
+    {
+      pListener->OnSysExSent(0);
+    }
+    return 0;
+  }
+
+  mpSysExSender->SetPacing(
+    gpConfig->GetValue(C_SysExRate),
+    gpConfig->GetValue(C_SysExGap));
+
+  pSysEx->SetDevice(Device);
+  mDeviceState.Update(Device, pSysEx);
+
+  vector<unsigned char> SysEx;
+  GetSysExMessage(pSysEx, SysEx);
+  return mpSysExSender->Send(Device, &SysEx[0], SysEx.size(), pListener);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::RemoveSysExListener(JZSysExListener* pListener)
+{
+  if (mpSysExSender)
+  {
+    mpSysExSender->RemoveListener(pListener);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZPlayer::ReleaseNotes(int Clock)
+{
+  vector<JZEvent*> Events;
+  mActiveNotes.Release(Clock, Events);
+  for (
+    vector<JZEvent*>::iterator iEvent = Events.begin();
+    iEvent != Events.end();
+    ++iEvent)
+  {
+    OutNow((*iEvent)->GetDevice(), *iEvent);
+    delete *iEvent;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -319,8 +863,10 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
   }
 
   Clock = mpPlayLoop->Int2ExtClock(Clock);
+  mpPlayLoop->Restart(Clock);
   mPlayBuffer.Clear();
   mRecdBuffer.Clear();
+  mRecordRing.Clear();
   if (mpAudioBuffer)
   {
     mpAudioBuffer->Clear();
@@ -330,6 +876,20 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
 
   if (!Continue)
   {
+    // Setup data the devices already have is skipped, unless it is forced
+    // by the configuration.
+    mIsSetupForced = gpConfig->GetValue(C_ResendSetup) != 0;
+
+    // The SysEx messages of the setup are paced, so a large SysEx dump
+    // does not overflow a slow MIDI interface.
+    if (mpSysExSender)
+    {
+      mpSysExSender->SetPacing(
+        gpConfig->GetValue(C_SysExRate),
+        gpConfig->GetValue(C_SysExGap));
+      mIsSetupPaced = true;
+    }
+
     if (
       gpConfig->GetValue(C_SendSynthReset) == 2 ||
       ((Clock == 0) && (gpConfig->GetValue(C_SendSynthReset) == 1)))
@@ -347,63 +907,63 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       pTrack = mpSong->GetTrack(i);
       if (pTrack->mpBank)
       {
-        OutNow(pTrack, pTrack->mpBank);
+        OutSetup(pTrack, pTrack->mpBank);
       }
       if (pTrack->mpBank2)
       {
-        OutNow(pTrack, pTrack->mpBank2);
+        OutSetup(pTrack, pTrack->mpBank2);
       }
       if (pTrack->mpPatch)
       {
-        OutNow(pTrack, pTrack->mpPatch);
+        OutSetup(pTrack, pTrack->mpPatch);
       }
       if (pTrack->mpVolume)
       {
-        OutNow(pTrack, pTrack->mpVolume);
+        OutSetup(pTrack, pTrack->mpVolume);
       }
       if (pTrack->mpPan)
       {
-        OutNow(pTrack, pTrack->mpPan);
+        OutSetup(pTrack, pTrack->mpPan);
       }
       if (pTrack->mpReverb)
       {
-        OutNow(pTrack, pTrack->mpReverb);
+        OutSetup(pTrack, pTrack->mpReverb);
       }
       if (pTrack->mpChorus)
       {
-        OutNow(pTrack, pTrack->mpChorus);
+        OutSetup(pTrack, pTrack->mpChorus);
       }
       if (pTrack->mpVibRate)
       {
-        OutNow(pTrack, pTrack->mpVibRate);
+        OutSetup(pTrack, pTrack->mpVibRate);
       }
       if (pTrack->mpVibDepth)
       {
-        OutNow(pTrack, pTrack->mpVibDepth);
+        OutSetup(pTrack, pTrack->mpVibDepth);
       }
       if (pTrack->mpVibDelay)
       {
-        OutNow(pTrack, pTrack->mpVibDelay);
+        OutSetup(pTrack, pTrack->mpVibDelay);
       }
       if (pTrack->mpCutoff)
       {
-        OutNow(pTrack, pTrack->mpCutoff);
+        OutSetup(pTrack, pTrack->mpCutoff);
       }
       if (pTrack->mpResonance)
       {
-        OutNow(pTrack, pTrack->mpResonance);
+        OutSetup(pTrack, pTrack->mpResonance);
       }
       if (pTrack->mpEnvAttack)
       {
-        OutNow(pTrack, pTrack->mpEnvAttack);
+        OutSetup(pTrack, pTrack->mpEnvAttack);
       }
       if (pTrack->mpEnvDecay)
       {
-        OutNow(pTrack, pTrack->mpEnvDecay);
+        OutSetup(pTrack, pTrack->mpEnvDecay);
       }
       if (pTrack->mpEnvRelease)
       {
-        OutNow(pTrack, pTrack->mpEnvRelease);
+        OutSetup(pTrack, pTrack->mpEnvRelease);
       }
 
       int j;
@@ -416,7 +976,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
           {
             if (dpar->Get(j))
             {
-              OutNow(pTrack, dpar->Get(j));
+              OutSetup(pTrack, dpar->Get(j));
             }
           }
           dpar = pTrack->mDrumParams.NextElem( dpar );
@@ -425,14 +985,14 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
 
       if (pTrack->mpBendPitchSens)
       {
-        OutNow(pTrack, pTrack->mpBendPitchSens);
+        OutSetup(pTrack, pTrack->mpBendPitchSens);
       }
 
       for (j = mspModPitchControl; j < mspModulationSysexParameters; ++j)
       {
         if (pTrack->mpModulationSettings[j])
         {
-          OutNow(pTrack, pTrack->mpModulationSettings[j]);
+          OutSetup(pTrack, pTrack->mpModulationSettings[j]);
         }
       }
 
@@ -440,7 +1000,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpBenderSettings[j])
         {
-          OutNow(pTrack, pTrack->mpBenderSettings[j]);
+          OutSetup(pTrack, pTrack->mpBenderSettings[j]);
         }
       }
 
@@ -448,7 +1008,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpCAfSettings[j])
         {
-          OutNow(pTrack, pTrack->mpCAfSettings[j]);
+          OutSetup(pTrack, pTrack->mpCAfSettings[j]);
         }
       }
 
@@ -456,7 +1016,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpPAfSettings[j])
         {
-          OutNow(pTrack, pTrack->mpPAfSettings[j]);
+          OutSetup(pTrack, pTrack->mpPAfSettings[j]);
         }
       }
 
@@ -464,7 +1024,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpCC1Settings[j])
         {
-          OutNow(pTrack, pTrack->mpCC1Settings[j]);
+          OutSetup(pTrack, pTrack->mpCC1Settings[j]);
         }
       }
 
@@ -472,25 +1032,25 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpCC2Settings[j])
         {
-          OutNow(pTrack, pTrack->mpCC2Settings[j]);
+          OutSetup(pTrack, pTrack->mpCC2Settings[j]);
         }
       }
 
       if (pTrack->mpCC1ControllerNr)
       {
-        OutNow(pTrack, pTrack->mpCC1ControllerNr);
+        OutSetup(pTrack, pTrack->mpCC1ControllerNr);
       }
 
       if (pTrack->mpCC2ControllerNr)
       {
-        OutNow(pTrack, pTrack->mpCC2ControllerNr);
+        OutSetup(pTrack, pTrack->mpCC2ControllerNr);
       }
 
       if (gpConfig->GetValue(C_UseReverbMacro))
       {
         if (pTrack->mpReverbType)
         {
-          OutNow(pTrack, pTrack->mpReverbType);
+          OutSetup(pTrack, pTrack->mpReverbType);
         }
       }
       else
@@ -499,7 +1059,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
         {
           if (pTrack->mpReverbSettings[j])
           {
-            OutNow(pTrack, pTrack->mpReverbSettings[j]);
+            OutSetup(pTrack, pTrack->mpReverbSettings[j]);
           }
         }
       }
@@ -507,7 +1067,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       {
         if (pTrack->mpChorusType)
         {
-          OutNow(pTrack, pTrack->mpChorusType);
+          OutSetup(pTrack, pTrack->mpChorusType);
         }
       }
       else
@@ -516,36 +1076,75 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
         {
           if (pTrack->mpChorusSettings[j])
           {
-            OutNow(pTrack, pTrack->mpChorusSettings[j]);
+            OutSetup(pTrack, pTrack->mpChorusSettings[j]);
           }
         }
       }
 
       if (pTrack->mpEqualizerType)
       {
-        OutNow(pTrack, pTrack->mpEqualizerType);
+        OutSetup(pTrack, pTrack->mpEqualizerType);
       }
       if (pTrack->mpPartialReserve)
       {
-        OutNow(pTrack, pTrack->mpPartialReserve);
+        OutSetup(pTrack, pTrack->mpPartialReserve);
       }
       if (pTrack->mpMasterVol)
       {
-        OutNow(pTrack, pTrack->mpMasterVol);
+        OutSetup(pTrack, pTrack->mpMasterVol);
       }
       if (pTrack->mpMasterPan)
       {
-        OutNow(pTrack, pTrack->mpMasterPan);
+        OutSetup(pTrack, pTrack->mpMasterPan);
       }
       if (pTrack->mpRxChannel)
       {
-        OutNow(pTrack, pTrack->mpRxChannel);
+        OutSetup(pTrack, pTrack->mpRxChannel);
       }
       if (pTrack->mpUseForRhythm && *gpSynth->GetSysexValPtr(pTrack->mpUseForRhythm ))
       {
-        OutNow(pTrack, pTrack->mpUseForRhythm );
+        OutSetup(pTrack, pTrack->mpUseForRhythm );
       }
     } // for
+
+    // Send the program, controller, pitch bend and pressure changes that
+    // were played before the start position.
+    JZPlaybackSchedule& Schedule = mpSong->GetPlaybackSchedule();
+    Schedule.Update();
+    vector<JZEvent*> ChaseEvents;
+    for (i = 0; i < mpSong->GetTrackCount(); ++i)
+    {
+      if (!mpSong->GetTrack(i)->GetAudioMode())
+      {
+        Schedule.GetChaseEvents(
+          i,
+          mpPlayLoop->Ext2IntClock(Clock),
+          ChaseEvents);
+      }
+    }
+    for (
+      vector<JZEvent*>::iterator iEvent = ChaseEvents.begin();
+      iEvent != ChaseEvents.end();
+      ++iEvent)
+    {
+      OutSetup(*iEvent);
+    }
+
+    // Playback starts when the devices got the setup, but the GUI waits no
+    // longer than configured.  The rest of a large dump keeps going out in
+    // the background, which is reported.
+    if (mIsSetupPaced)
+    {
+      mIsSetupPaced = false;
+      if (!mpSysExSender->WaitUntilIdle(gpConfig->GetValue(C_SysExSetupWait)))
+      {
+        cerr
+          << "Playback starts with "
+          << mpSysExSender->GetQueuedByteCount()
+          << " bytes of setup not sent yet, see .sysex_setup_wait"
+          << endl;
+      }
+    }
   } // if !Continue
 
   pTrack = mpSong->GetTrack(0);
@@ -555,8 +1154,8 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
     OutNow(pEvent);
   }
 
-  // Send songpointer?
-  if (gpConfig->GetValue(C_RealTimeOut))
+  // Send songpointer?  A sync generator sends its own.
+  if (gpConfig->GetValue(C_RealTimeOut) && !HasSyncGenerator())
   {
     unsigned char s[2];
     s[0] = Clock & 0x7f;
@@ -570,7 +1169,14 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
     gpConfig->GetValue(C_ThruInput),
     gpConfig->GetValue(C_ThruOutput));
 
-  mOutClock = Clock + FIRST_DELTACLOCK;
+  mNotifyStopWatch.Start();
+  mLastNotifyTime = 0;
+  mNotifyGapPeak = mPollMillisec;
+  UpdateLookahead(Clock);
+
+  // The first window is a bit shorter than the regular one, so less output
+  // has to be prepared before playback starts.
+  mOutClock = Clock + mLookaheadClock * 3 / 4;
 
   JZProjectManager::Instance().NewPlayPosition(
     mpPlayLoop->Ext2IntClock(Clock));
@@ -579,7 +1185,7 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
     &mPlayBuffer,
     mpSong,
     Clock,
-    Clock + FIRST_DELTACLOCK,
+    mOutClock,
     false);
 
   if (mpAudioBuffer)
@@ -588,10 +1194,9 @@ void JZPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       mpAudioBuffer,
       mpSong,
       Clock,
-      Clock + FIRST_DELTACLOCK,
+      mOutClock,
       true);
   }
-  mPlayBuffer.Length2Keyoff();
 
   // Notify() has to be called very often because voxware
   // midi thru is done there
@@ -610,33 +1215,9 @@ void JZPlayer::StopPlay()
 
   int Clock = GetRealTimeClock();
 
-  // SN++ Patch: Notes off for not GM/GS devices
-  int ii;
-  JZKeyOffEvent pKeyOff(0, 0, 0);
-
-  for (ii = 0; ii < mpSong->GetTrackCount(); ++ii)
-  {
-    JZTrack *Track = mpSong->GetTrack(ii);
-    if (Track)
-    {
-      JZEventIterator Iterator(Track);
-      JZEvent* pEvent = Iterator.First();
-      while (pEvent && pEvent->GetClock() < Clock + 100)
-      {
-        JZKeyOnEvent* pKeyOn = pEvent->IsKeyOn();
-        if (pKeyOn)
-        {
-          if (pKeyOn->GetClock() + pKeyOn->GetEventLength() >= Clock - 100)
-          {
-            pKeyOff.SetChannel(pKeyOn->GetChannel());
-            pKeyOff.SetKey(pKeyOn->GetKey());
-            OutNow(&pKeyOff);
-          }
-        }
-        pEvent = Iterator.Next();
-      }
-    }
-  }
+  // Send note offs for the notes that are still sounding, which also stops
+  // devices that ignore the all notes off controller.
+  ReleaseNotes(Clock);
 
   JZProjectManager::Instance().NewPlayPosition(-1);
 }
@@ -655,25 +1236,24 @@ void JZPlayer::AllNotesOff(bool Reset)
     for (int c = 0; c < 16; ++c)
     {
       NoteOff.SetChannel(c);
-      NoteOff.SetDevice(dev);
-      OutNow(&NoteOff);
+      OutNow(dev, &NoteOff);
 
       Pitch.SetChannel(c);
-      Pitch.SetDevice(dev);
-      OutNow(&Pitch);
+      OutNow(dev, &Pitch);
 
       CtrlRes.SetChannel(c);
-      CtrlRes.SetDevice(dev);
-      OutNow(&CtrlRes);
+      OutNow(dev, &CtrlRes);
     }
   }
 
   if (Reset)
   {
     JZEvent* mpResetEvent = gpSynth->CreateResetEvent();
-    OutNow(mpResetEvent);
+    OutNow(JZEvent::BROADCAST_DEVICE, mpResetEvent);
     delete mpResetEvent;
   }
+
+  mActiveNotes.Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -2003,18 +2583,18 @@ void JZSeq2Player::StopPlay()
 //-----------------------------------------------------------------------------
 void JZSeq2Player::FlushToDevice()
 {
-  JZEventIterator Iterator(&mPlayBuffer);
-  JZEvent* pEvent = Iterator.Range(0, mOutClock);
-  if (pEvent)
+  int Count = 0;
+  while (
+    Count < mPlayBuffer.GetCount() &&
+    mPlayBuffer.GetRecord(Count).mClock < mOutClock)
   {
-    do
-    {
-      OutEvent(pEvent);
-      pEvent->Kill();
-      pEvent = Iterator.Next();
-    } while (pEvent);
-
-    mPlayBuffer.Cleanup(0);
+    OutRecord(mPlayBuffer.GetRecord(Count));
+    ++Count;
+  }
+  if (Count > 0)
+  {
+    mPlayBuffer.RemoveFirst(Count);
+    ReclaimPlayedEvents();
   }
   OutBreak(mOutClock);
   seqbuf_dump();
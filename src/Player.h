@@ -23,18 +23,27 @@
 #pragma once
 
 #include "config.h"
+#include "ActiveNotes.h"
+#include "DeviceStateCache.h"
 #include "Events.h"
 #include "Track.h"
 #include "Song.h"
 //#include "midinet.h"
 #include "Audio.h"
+#include "Metronome.h"
+#include "PlayBuffer.h"
+#include "PlaybackStatistics.h"
+#include "RecordRing.h"
 
+#include <wx/stopwatch.h>
 #include <wx/timer.h>
 
 #include <sys/types.h>
 #include <time.h>
 
 class JZRecordingInfo;
+class JZSysExListener;
+class JZSysExSender;
 
 //*****************************************************************************
 //*****************************************************************************
@@ -101,10 +110,16 @@ class JZPlayLoop
 
     JZPlayLoop();
 
+    ~JZPlayLoop();
+
     void Set(int Start, int Stop);
 
     void Reset();
 
+    // Output (re)starts at the passed external clock, so notes started
+    // before it are not sounding.
+    void Restart(int Clock);
+
     // external clock -> internal clock where
     //   external clock == physical clock
     //   internal clock == song position
@@ -113,6 +128,15 @@ class JZPlayLoop
     // the other way round
     int Int2ExtClock(int Clock);
 
+    void PrepareOutput(
+      JZPlayBuffer* pPlayBuffer,
+      JZSong* pSong,
+      int ExtFr,
+      int ExtTo,
+      bool AudioMode = false);
+
+    // Same as above for consumers that need their own event copies, like
+    // the sample player.
     void PrepareOutput(
       JZEventArray* pEventArray,
       JZSong* pSong,
@@ -120,11 +144,56 @@ class JZPlayLoop
       int ExtTo,
       bool AudioMode = false);
 
+  private:
+
+    // One pass through the loop, merged once and replayed on every later
+    // pass.  The record clocks are relative to mStartClock and the record
+    // events are copies owned by the cache.
+    struct JZLoopCache
+    {
+      JZLoopCache();
+
+      bool mIsValid;
+      unsigned mGeneration;
+      JZMetronomeInfo mMetronomeInfo;
+      std::vector<bool> mIsTrackPlaying;
+      std::vector<JZPlayRecord> mRecords;
+    };
+
+    void MergeSegment(
+      JZPlayBuffer* pPlayBuffer,
+      JZSong* pSong,
+      int From,
+      int To,
+      int Delta,
+      bool AudioMode,
+      int PassClock,
+      bool CloseNotes);
+
+    void UpdateLoopCache(JZLoopCache& Cache, JZSong* pSong, bool AudioMode);
+
+    static bool IsRecordClockBefore(
+      const JZPlayRecord& Record,
+      int Clock);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZPlayLoop(const JZPlayLoop&);
+    JZPlayLoop& operator = (const JZPlayLoop&);
+
   private:
 
     int mStartClock;
 
     int mStopClock;
+
+    int mRestartClock;
+
+    // One cache for MIDI and one for audio output.
+    JZLoopCache mLoopCaches[2];
+
+    std::vector<bool> mIsTrackPlaying;
 };
 
 //*****************************************************************************
@@ -144,28 +213,74 @@ class JZPlayer : public wxTimer
     // return 0 = ok, 1 = buffer full, try again later
     virtual int OutEvent(JZEvent* pEvent) = 0;
 
+    // Send a play buffer record, same return values as OutEvent().
+    int OutRecord(const JZPlayRecord& Record)
+    {
+      // The referenced events are shared by all records and only read by
+      // the player, so they are stamped with the record clock and device
+      // just before they are sent.
+      Record.mpEvent->SetClock(Record.mClock);
+      Record.mpEvent->SetDevice(Record.mDevice);
+      int Result = OutEvent(Record.mpEvent);
+      if (Result == 0)
+      {
+        mStatistics.AddHandOff(Record.mClock - mNotifyClock);
+        mDeviceState.Update(Record.mDevice, Record.mpEvent);
+        mActiveNotes.Update(Record.mDevice, Record.mpEvent, Record.mClock);
+      }
+      return Result;
+    }
+
     virtual void OutBreak() = 0;
 
     // Send event immediately ignoring the clock.
     void OutNow(JZTrack *t, JZEvent* pEvent)
     {
-      pEvent->SetDevice(t->GetDevice());
-      OutNow(pEvent);
+      OutNow(t->GetDevice(), pEvent);
     }
 
     void OutNow(int device, JZEvent* pEvent)
     {
       pEvent->SetDevice(device);
-      OutNow(pEvent);
+      mDeviceState.Update(device, pEvent);
+      mActiveNotes.Update(device, pEvent);
+      if (mIsSetupPaced)
+      {
+        OutPaced(pEvent);
+      }
+      else
+      {
+        OutNow(pEvent);
+      }
     }
 
     void OutNow(JZTrack* t, JZParam* r);
 
+    // Send a SysEx message in the background, paced as configured, if the
+    // driver supports it, and return its ID.  Otherwise it is sent at once.
+    // The listener is called when the message went out.
+    int SendSysEx(
+      int Device,
+      JZSysExEvent* pSysEx,
+      JZSysExListener* pListener = nullptr);
+
+    // Stop calling the passed listener.
+    void RemoveSysExListener(JZSysExListener* pListener);
+
+    // The SysEx sender of the driver or null.
+    const JZSysExSender* GetSysExSender() const
+    {
+      return mpSysExSender;
+    }
+
     // what's played right now?
     virtual int GetRealTimeClock() = 0;
 
     virtual void StartPlay(int Clock, int LoopClock = 0, int Continue = 0);
     virtual void StopPlay();
+
+    // Panic: end all notes and reset the controllers on all channels of all
+    // devices.
     virtual void AllNotesOff(bool Reset = false);
 
     virtual void SetSoftThru(int on, int idev, int odev)
@@ -220,6 +335,13 @@ class JZPlayer : public wxTimer
     {
       return 0;
     }
+
+    // True if the driver sends the song position, MIDI clock and MTC
+    // configured by C_RealTimeOut itself.
+    virtual bool HasSyncGenerator() const
+    {
+      return false;
+    }
     virtual JZDeviceList& GetOutputDevices()
     {
       return DummyDeviceList;
@@ -290,6 +412,22 @@ class JZPlayer : public wxTimer
       mSamples.Edit(key);
     }
 
+    JZPlaybackStatistics& GetStatistics()
+    {
+      return mStatistics;
+    }
+
+    // Write the playback statistics followed by the statistics the driver
+    // keeps, in the format of JZPlaybackStatistics::Write().
+    virtual void WriteStatistics(std::ostream& Os) const;
+
+    // Forget what was sent to the devices, so the next StartPlay() sends
+    // all setup data again, for example after a device was switched off.
+    void ClearDeviceState()
+    {
+      mDeviceState.Clear();
+    }
+
     virtual int GetListenerPlayPosition()
     {
       return -1;
@@ -304,6 +442,43 @@ class JZPlayer : public wxTimer
 
     virtual void OutNow(JZEvent* pEvent) = 0;
 
+    // End the notes, pedals and pitch bends still sounding at the passed
+    // clock.
+    void ReleaseNotes(int Clock);
+
+    // Queue a SysEx event in the SysEx sender.  Any other event is sent at
+    // once, unless SysEx messages for its device are still queued.
+    void OutPaced(JZEvent* pEvent);
+
+    // Encode the SysEx event as a complete MIDI message.
+    static void GetSysExMessage(
+      JZSysExEvent* pSysEx,
+      std::vector<unsigned char>& Message);
+
+    // Encode a channel event as a MIDI message of up to three bytes and
+    // return its length, or zero for all other events.
+    static int GetChannelMessage(JZEvent* pEvent, unsigned char* pMessage);
+
+    // Send setup data, unless the device already has it.
+    void OutSetup(JZTrack* pTrack, JZEvent* pEvent);
+    void OutSetup(JZTrack* pTrack, JZParam* pParam);
+    void OutSetup(JZEvent* pEvent);
+
+    // Let the playback schedule delete retired events that are no longer
+    // referenced by the play buffer.
+    void ReclaimPlayedEvents();
+
+    // Track the longest time between Notify() calls.
+    void MeasureNotifyGap();
+
+    // Recompute the lookahead window from the configured latency, the
+    // measured Notify() gaps and the tempo at the passed clock.
+    void UpdateLookahead(int Clock);
+
+    // Convert a duration starting at the passed song clock into ticks,
+    // following the tempo changes in the first track.
+    int Milliseconds2Ticks(int Clock, int Milliseconds);
+
   protected:
 
     int mOutClock;
@@ -320,13 +495,50 @@ class JZPlayer : public wxTimer
 
     JZSong* mpSong;
 
-    JZEventArray mPlayBuffer;
+    JZPlayBuffer mPlayBuffer;
     JZEventArray mRecdBuffer;
 
+    // Recorded channel messages that have not been converted into events
+    // for mRecdBuffer yet.
+    JZRecordRing mRecordRing;
+
     JZEventArray* mpAudioBuffer;
 
     JZSampleSet mSamples;
 
+    // The real time clock of the last Notify() call.
+    int mNotifyClock;
+
+    // The number of ticks events are sent ahead of the real time clock.
+    // The play buffer is refilled when less than half of it is left.
+    int mLookaheadClock;
+
+    wxStopWatch mNotifyStopWatch;
+    long mLastNotifyTime;
+
+    // The longest gap between Notify() calls in milliseconds, slowly
+    // decaying so a single hiccup does not stick forever.
+    int mNotifyGapPeak;
+
+    JZPlaybackStatistics mStatistics;
+
+    // The state last sent to the output devices.
+    JZDeviceStateCache mDeviceState;
+
+    // The notes sent to the devices that may still be sounding.
+    JZActiveNotes mActiveNotes;
+
+    // Send all setup data in StartPlay(), even if a device already has it.
+    bool mIsSetupForced;
+
+    // Sends SysEx messages in the background.  Set by drivers that support
+    // it, which own it.
+    JZSysExSender* mpSysExSender;
+
+    // Queue the SysEx messages in the SysEx sender while StartPlay() sends
+    // the setup.
+    bool mIsSetupPaced;
+
   private:
 
     JZDeviceList DummyDeviceList;
@@ -11,6 +11,9 @@
 
 using namespace std;
 
+// PortMidi sends each event this many milliseconds after its time stamp.
+static const int OutputLatency = 100;
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 JZPortMidiPlayer::JZPortMidiPlayer(JZSong* pSong)
@@ -247,6 +250,14 @@ int JZPortMidiPlayer::OutEvent(JZEvent* pEvent, int now)
 
   t = Clock2Time(t);
 
+  // An event written after its output time is sent right away, so it is
+  // late by the difference.
+  if (!now)
+  {
+    PmTimestamp Lateness = Pt_Time() - (t + OutputLatency);
+    mStatistics.AddDispatchLateness(Lateness > 0 ? Lateness * 1000 : 0);
+  }
+
 #define WSHORT(a, b) \
   rc = Pm_WriteShort(mpStream, t, Pm_Message(pEvent->GetStat() | k->GetChannel(), a, b))
 
@@ -371,10 +382,9 @@ void JZPortMidiPlayer::StartPlay(int clock, int loopClock, int cont)
     return;
   }
 
-  cout
-    << "rc = " << Pm_OpenOutput(&mpStream, id, NULL, 0, NULL, NULL, 100)
-    << ' ' << id
-    << endl;
+  PmError rc =
+    Pm_OpenOutput(&mpStream, id, NULL, 0, NULL, NULL, OutputLatency);
+  cout << "rc = " << rc << ' ' << id << endl;
 
   mStartTime = Pt_Time() + 500;
   mStartClock = clock;
@@ -45,6 +45,7 @@
 #ifdef DEV_ALSA
 #include "AlsaPlayer.h"
 #include "AlsaDriver.h"
+#include "MidiNetPlayer.h"
 #endif
 
 #include <wx/config.h>
@@ -244,6 +245,28 @@ JZProject::JZProject()
     cerr << "This programm lacks JAZZ/MPU401 driver support" << endl;
     cerr << "Jazz will start with no play/record ability." << endl;
     mpMidiPlayer = new JZNullPlayer(this);
+#endif
+  }
+  else if (gpConfig->GetValue(C_MidiDriver) == eMidiDriverNet)
+  {
+#ifdef DEV_ALSA
+    mpMidiPlayer = new JZMidiNetPlayer(this);
+    if (!mpMidiPlayer->IsInstalled())
+    {
+      cerr << "JZMidiNetPlayer didn't install." << endl;
+
+      cerr
+        << "Could not reach midinetd at host \""
+        << gpConfig->GetStrValue(C_MidiNetHost) << "\"\n"
+        << "Jazz will start with no play/record ability."
+        << endl;
+      delete mpMidiPlayer;
+      mpMidiPlayer = new JZNullPlayer(this);
+    }
+#else
+    cerr << "This programm lacks midinet driver support" << endl;
+    cerr << "Jazz will start with no play/record ability." << endl;
+    mpMidiPlayer = new JZNullPlayer(this);
 #endif
   }
   else
@@ -0,0 +1,141 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "RecordRing.h"
+
+#include "Events.h"
+#include "Track.h"
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the record ring class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZRecordRing::JZRecordRing()
+  : mMessages(eCapacity),
+    mWriteIndex(0),
+    mReadIndex(0),
+    mDroppedCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZRecordRing::Clear()
+{
+  mWriteIndex.store(0, memory_order_relaxed);
+  mReadIndex.store(0, memory_order_relaxed);
+  mDroppedCount.store(0, memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The read index is only advanced after all messages have been converted,
+// so the producer can not overwrite them while they are being read.
+//-----------------------------------------------------------------------------
+void JZRecordRing::MoveTo(JZEventArray& Events)
+{
+  unsigned ReadIndex = mReadIndex.load(memory_order_relaxed);
+  unsigned WriteIndex = mWriteIndex.load(memory_order_acquire);
+
+  for (unsigned Index = ReadIndex; Index != WriteIndex; ++Index)
+  {
+    const JZRecordedMessage& Message = mMessages[Index & (eCapacity - 1)];
+    int Channel = Message.mStatus & 0x0f;
+
+    JZEvent* pEvent = 0;
+    switch (Message.mStatus & 0xf0)
+    {
+      case StatKeyOff:
+        pEvent = new JZKeyOffEvent(
+          Message.mClock,
+          Channel,
+          Message.mData1,
+          Message.mData2);
+        break;
+
+      case StatKeyOn:
+        if (Message.mData2 > 0)
+        {
+          pEvent = new JZKeyOnEvent(
+            Message.mClock,
+            Channel,
+            Message.mData1,
+            Message.mData2);
+        }
+        else
+        {
+          pEvent = new JZKeyOffEvent(
+            Message.mClock,
+            Channel,
+            Message.mData1,
+            0);
+        }
+        break;
+
+      case StatKeyPressure:
+        pEvent = new JZKeyPressureEvent(
+          Message.mClock,
+          Channel,
+          Message.mData1,
+          Message.mData2);
+        break;
+
+      case StatControl:
+        pEvent = new JZControlEvent(
+          Message.mClock,
+          Channel,
+          Message.mData1,
+          Message.mData2);
+        break;
+
+      case StatProgram:
+        pEvent = new JZProgramEvent(Message.mClock, Channel, Message.mData1);
+        break;
+
+      case StatChnPressure:
+        pEvent = new JZChnPressureEvent(
+          Message.mClock,
+          Channel,
+          Message.mData1);
+        break;
+
+      case StatPitch:
+        pEvent = new JZPitchEvent(
+          Message.mClock,
+          Channel,
+          Message.mData1,
+          Message.mData2);
+        break;
+    }
+
+    if (pEvent)
+    {
+      Events.Put(pEvent);
+    }
+  }
+
+  mReadIndex.store(WriteIndex, memory_order_release);
+}
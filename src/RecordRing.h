@@ -0,0 +1,160 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+class JZEventArray;
+
+//*****************************************************************************
+// Description:
+//   One captured MIDI channel message.  The clock is the song clock the
+// message arrived at and the bytes are those of the MIDI message, so a
+// pitch bend value is split into its low and high seven bits.
+//*****************************************************************************
+struct JZRecordedMessage
+{
+  int mClock;
+  unsigned char mStatus;
+  unsigned char mData1;
+  unsigned char mData2;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the record ring class declaration.  Incoming channel messages
+// are captured into a preallocated ring of compact messages instead of
+// allocating an event for every message, and are converted into events in
+// bulk.  The ring is lock-free for one producer, the code that reads the
+// MIDI input, and one consumer, the code that converts the messages.  When
+// the ring is full, further messages are dropped and counted.
+//*****************************************************************************
+class JZRecordRing
+{
+  public:
+
+    enum
+    {
+      eCapacity = 1 << 16
+    };
+
+    JZRecordRing();
+
+    // Only call this when neither producer nor consumer are active.
+    void Clear();
+
+    // Producer side.  Returns false if the message was dropped.
+    bool Put(
+      int Clock,
+      unsigned char Status,
+      unsigned char Data1,
+      unsigned char Data2);
+
+    // Consumer side.
+    unsigned GetCount() const;
+
+    bool IsEmpty() const;
+
+    // Convert all captured messages into events and append them to the
+    // passed event array.
+    void MoveTo(JZEventArray& Events);
+
+    unsigned GetDroppedCount() const;
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZRecordRing(const JZRecordRing&);
+    JZRecordRing& operator = (const JZRecordRing&);
+
+  private:
+
+    std::vector<JZRecordedMessage> mMessages;
+
+    // Both indices count up and wrap around at the integer size.  Only the
+    // producer writes mWriteIndex and only the consumer writes mReadIndex.
+    std::atomic<unsigned> mWriteIndex;
+    std::atomic<unsigned> mReadIndex;
+
+    std::atomic<unsigned> mDroppedCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the record ring class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+// Description:
+//   The message is written before the write index is published, so the
+// consumer never sees a partially written message.
+//-----------------------------------------------------------------------------
+inline
+bool JZRecordRing::Put(
+  int Clock,
+  unsigned char Status,
+  unsigned char Data1,
+  unsigned char Data2)
+{
+  unsigned WriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+  if (WriteIndex - mReadIndex.load(std::memory_order_acquire) >= eCapacity)
+  {
+    mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  JZRecordedMessage& Message = mMessages[WriteIndex & (eCapacity - 1)];
+  Message.mClock = Clock;
+  Message.mStatus = Status;
+  Message.mData1 = Data1;
+  Message.mData2 = Data2;
+
+  mWriteIndex.store(WriteIndex + 1, std::memory_order_release);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZRecordRing::GetCount() const
+{
+  return
+    mWriteIndex.load(std::memory_order_acquire) -
+    mReadIndex.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZRecordRing::IsEmpty() const
+{
+  return GetCount() == 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZRecordRing::GetDroppedCount() const
+{
+  return mDroppedCount.load(std::memory_order_relaxed);
+}
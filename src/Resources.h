@@ -109,6 +109,7 @@
 
 #define ID_TOOLS_HARMONY_BROWSER             (wxID_HIGHEST + 95)
 #define ID_TOOLS_RHYTHM_GENERATOR            (wxID_HIGHEST + 96)
+#define ID_TOOLS_PLAYBACK_STATISTICS         (wxID_HIGHEST + 97)
 
 #define ID_INSTRUMENT_ADD                    (wxID_HIGHEST + 100)
 #define ID_INSTRUMENT_DELETE                 (wxID_HIGHEST + 101)
@@ -158,3 +159,6 @@
 #define IDC_SL_RHYTHM_GROUP_CONTRIB          (wxID_HIGHEST + 1254)
 #define IDC_SL_RHYTHM_GROUP_LISTEN           (wxID_HIGHEST + 1255)
 #define IDC_CB_RHYTHM_RANDOMIZE              (wxID_HIGHEST + 1258)
+
+// JZSysexDialog resource IDs.
+#define IDC_BN_SYSEX_SEND                    (wxID_HIGHEST + 1260)
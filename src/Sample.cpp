@@ -23,6 +23,8 @@
 #include "Sample.h"
 
 #include "Audio.h"
+#include "Configuration.h"
+#include "Globals.h"
 #include "Random.h"
 #include "SampleCommand.h"
 #include "Mapper.h"
@@ -37,6 +39,9 @@
 
 using namespace std;
 
+// The head of a streamed sample that is kept in memory.
+static const int StreamPreloadSeconds = 1;
+
 JZSample::JZSample(JZSampleSet &s)
   : set(s),
     mLabel(),
@@ -44,6 +49,9 @@ JZSample::JZSample(JZSampleSet &s)
 {
   mpData   = 0;
   length   = 0;
+  mIsStreamed = false;
+  mStreamLength = 0;
+  mStreamOffset = 0;
   external_flag = 1;  // auto reload when file changes on disk
   external_time = 0;
   volume   = 127;
@@ -89,6 +97,7 @@ void JZSample::FreeData()
   delete [] mpData;
   mpData = 0;
   length = 0;
+  mIsStreamed = false;
   dirty  = 1;
 }
 
@@ -97,6 +106,7 @@ void JZSample::MakeData(int new_length, int zero)
   delete [] mpData;
   length = new_length;
   mpData = new short[length];
+  mIsStreamed = false;
   if (zero)
     memset(mpData, 0, length * sizeof(short));
 }
@@ -221,8 +231,11 @@ typedef struct
 } FmtChunk;
 
 //-----------------------------------------------------------------------------
+// Description:
+//   Only samples already in the format of the sample set are streamed,
+// because the streamer copies the file data as it is.
 //-----------------------------------------------------------------------------
-int JZSample::LoadWav()
+int JZSample::LoadWav(bool AllowStreaming)
 {
   struct stat buf;
   if (stat(mFileName.c_str(), &buf) == -1)
@@ -284,6 +297,28 @@ int JZSample::LoadWav()
     return 2;
   }
 
+  long TotalLength = data_length / 2;
+  long PreloadLength =
+    (long)set.GetSamplingRate() * set.GetChannelCount() * StreamPreloadSeconds;
+  long Threshold = 1024L * gpConfig->GetValue(C_AudioStreamThreshold);
+  if (
+    AllowStreaming &&
+    Threshold > 0 &&
+    data_length > Threshold &&
+    TotalLength > PreloadLength &&
+    bit_p_spl == 16 &&
+    channels == set.GetChannelCount() &&
+    sample_fq == set.GetSamplingRate() &&
+    pitch == 0)
+  {
+    mStreamOffset = (long)Ifs.tellg();
+    MakeData(PreloadLength, 0);
+    Ifs.read((char *)mpData, length * 2);
+    mStreamLength = TotalLength;
+    mIsStreamed = true;
+    return 0;
+  }
+
   return Convert(Ifs, data_length, channels, bit_p_spl, sample_fq);
 }
 
@@ -361,27 +396,6 @@ int JZSample::Convert(
     Transpose(f);
   }
 
-  // apply volume and pan
-  if (volume != 127 || pan != 0)
-  {
-    int ch1 = volume;
-    int ch2 = volume;
-    int  ppan = (set.GetChannelCount() == 2) ? pan : 0;
-    if (ppan > 0)
-    {
-      ch1 = (int)volume * (63L - ppan) / 64L;
-    }
-    else if (ppan < 0)
-    {
-      ch2 = (int)volume * (63L + ppan) / 64L;
-    }
-    for (int i = 0; i < length-1; i += 2)
-    {
-      mpData[i]   = (short)((int)mpData[i]   * ch1 >> 7);
-      mpData[i+1] = (short)((int)mpData[i+1] * ch2 >> 7);
-    }
-  }
-
   return 0;
 }
 
@@ -434,6 +448,19 @@ int JZSample::Load(int force)
   return 0;
 }
 
+int JZSample::MakeResident()
+{
+  if (!mIsStreamed)
+  {
+    return 0;
+  }
+
+  FreeData();
+  int rc = LoadWav(false);
+  dirty = 0;
+  return rc;
+}
+
 int JZSample::Align(int offs) const
 {
   if (offs < 0)
@@ -698,8 +725,6 @@ int JZSample::Save()
   if (!err)
   {
     dirty  = 0;
-    volume = 127;
-    pan    = 0;
   }
   return err;
 }
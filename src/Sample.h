@@ -212,7 +212,10 @@ class JZSample
     virtual ~JZSample();
 
     int Load(int force = 0);
-    int LoadWav();
+
+    // Samples above the .audio_stream_threshold that need no conversion are
+    // streamed unless AllowStreaming is false.
+    int LoadWav(bool AllowStreaming = true);
     int LoadRaw();
 
     int SaveWave();
@@ -225,9 +228,10 @@ class JZSample
       return mLabel;
     }
 
+    // Volume and pan are applied when the sample is mixed, so changing them
+    // does not reload the sample.  Changing the pitch does.
     void SetVolume(int vol)
     {
-      dirty |= (vol != volume);
       volume = vol;
     }
 
@@ -238,7 +242,6 @@ class JZSample
 
     void SetPan(int p)
     {
-      dirty |= (p != pan);
       pan = p;
     }
 
@@ -264,11 +267,35 @@ class JZSample
       return mFileName;
     }
 
+    // The number of shorts in memory, which is only the head of a streamed
+    // sample.
     int GetLength() const
     {
       return length;
     }
 
+    // A streamed sample keeps its first second in memory.  The rest is read
+    // from the file by the sample streamer while it plays.
+    bool IsStreamed() const
+    {
+      return mIsStreamed;
+    }
+
+    // The number of shorts including the part that is streamed.
+    long GetTotalLength() const
+    {
+      return mIsStreamed ? mStreamLength : length;
+    }
+
+    // The file position of the first short.
+    long GetStreamOffset() const
+    {
+      return mStreamOffset;
+    }
+
+    // Load all of a streamed sample, for example to edit it.
+    int MakeResident();
+
     bool IsEmpty() const
     {
       return length == 0;
@@ -386,6 +413,9 @@ class JZSample
 
     int length;  // number of shorts
     short* mpData; // signed shorts
+    bool mIsStreamed;
+    long mStreamLength;
+    long mStreamOffset;
     JZSampleSet& set;
 
     std::string mLabel;
@@ -0,0 +1,349 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "SampleStreamer.h"
+
+#include "Sample.h"
+
+#include <chrono>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the sample stream class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSampleStream::JZSampleStream()
+  : mState(eFree),
+    mRing(eRingSize),
+    mRead(0),
+    mWritten(0),
+    mpSample(0),
+    mPosition(0),
+    mRemaining(0),
+    mSkipCount(0),
+    mUnderrunCount(0),
+    mpFile(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSampleStream::~JZSampleStream()
+{
+  Reset();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+const short* JZSampleStream::Peek(long& Count)
+{
+  unsigned Read = mRead.load(memory_order_relaxed);
+  unsigned Written = mWritten.load(memory_order_acquire);
+
+  // Drop what was played as silence before it arrived.
+  if (mSkipCount > 0 && Written != Read)
+  {
+    unsigned Drop = Written - Read;
+    if (Drop > (unsigned long)mSkipCount)
+    {
+      Drop = mSkipCount;
+    }
+    Read += Drop;
+    mSkipCount -= Drop;
+    mRead.store(Read, memory_order_release);
+  }
+
+  if (mSkipCount > 0 || Written == Read)
+  {
+    Count = 0;
+    return 0;
+  }
+
+  unsigned Index = Read & (eRingSize - 1);
+  Count = Written - Read;
+  if (Count > (long)(eRingSize - Index))
+  {
+    Count = eRingSize - Index;
+  }
+  return &mRing[Index];
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStream::Consume(long Count)
+{
+  mRead.store(
+    mRead.load(memory_order_relaxed) + Count,
+    memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStream::Skip(long Count)
+{
+  mSkipCount += Count;
+  mUnderrunCount += Count;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStream::Close()
+{
+  mState.store(eClosing, memory_order_release);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The file is opened on the first call, so the rendering thread never
+// waits for it.  A file that cannot be read leaves the rest of the sample
+// silent.
+//-----------------------------------------------------------------------------
+void JZSampleStream::Fill()
+{
+  if (mRemaining <= 0)
+  {
+    return;
+  }
+
+  if (!mpFile)
+  {
+    const char* pFileName = mpSample->GetFileName().c_str();
+    mpFile = fopen(pFileName, "rb");
+    if (
+      !mpFile ||
+      fseek(
+        mpFile,
+        mpSample->GetStreamOffset() + mPosition * (long)sizeof(short),
+        SEEK_SET) != 0)
+    {
+      perror(pFileName);
+      mRemaining = 0;
+      return;
+    }
+  }
+
+  unsigned Written = mWritten.load(memory_order_relaxed);
+  unsigned Read = mRead.load(memory_order_acquire);
+  unsigned Free = eRingSize - (Written - Read);
+  while (Free > 0 && mRemaining > 0)
+  {
+    unsigned Index = Written & (eRingSize - 1);
+    long Count = Free;
+    if (Count > (long)(eRingSize - Index))
+    {
+      Count = eRingSize - Index;
+    }
+    if (Count > mRemaining)
+    {
+      Count = mRemaining;
+    }
+
+    size_t ReadCount = fread(&mRing[Index], sizeof(short), Count, mpFile);
+    if (ReadCount == 0)
+    {
+      mRemaining = 0;
+      break;
+    }
+    Written += ReadCount;
+    Free -= ReadCount;
+    mRemaining -= ReadCount;
+    mWritten.store(Written, memory_order_release);
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStream::Reset()
+{
+  if (mpFile)
+  {
+    fclose(mpFile);
+    mpFile = 0;
+  }
+  mpSample = 0;
+  mPosition = 0;
+  mRemaining = 0;
+  mSkipCount = 0;
+  mRead = 0;
+  mWritten = 0;
+}
+
+//*****************************************************************************
+// Description:
+//   This is the sample streamer class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSampleStreamer::JZSampleStreamer()
+  : mStreams(),
+    mDiskThread(),
+    mIsRunning(false),
+    mUnavailableCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSampleStreamer::~JZSampleStreamer()
+{
+  Stop();
+  for (
+    vector<JZSampleStream*>::iterator iStream = mStreams.begin();
+    iStream != mStreams.end();
+    ++iStream)
+  {
+    delete *iStream;
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStreamer::Start()
+{
+  if (mDiskThread.joinable())
+  {
+    return;
+  }
+
+  if (mStreams.empty())
+  {
+    for (int i = 0; i < eStreamCount; ++i)
+    {
+      mStreams.push_back(new JZSampleStream);
+    }
+  }
+
+  for (
+    vector<JZSampleStream*>::iterator iStream = mStreams.begin();
+    iStream != mStreams.end();
+    ++iStream)
+  {
+    (*iStream)->Reset();
+    (*iStream)->mUnderrunCount = 0;
+    (*iStream)->mState = JZSampleStream::eFree;
+  }
+  mUnavailableCount = 0;
+
+  mIsRunning = true;
+  mDiskThread = std::thread(&JZSampleStreamer::DiskLoop, this);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSampleStreamer::Stop()
+{
+  if (!mDiskThread.joinable())
+  {
+    return;
+  }
+
+  mIsRunning = false;
+  mDiskThread.join();
+
+  for (
+    vector<JZSampleStream*>::iterator iStream = mStreams.begin();
+    iStream != mStreams.end();
+    ++iStream)
+  {
+    (*iStream)->Reset();
+    (*iStream)->mState = JZSampleStream::eFree;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Only the rendering thread takes free streams, so finding one and marking
+// it open needs no lock.
+//-----------------------------------------------------------------------------
+JZSampleStream* JZSampleStreamer::Open(const JZSample* pSample, long Position)
+{
+  if (mIsRunning)
+  {
+    for (
+      vector<JZSampleStream*>::iterator iStream = mStreams.begin();
+      iStream != mStreams.end();
+      ++iStream)
+    {
+      JZSampleStream* pStream = *iStream;
+      if (pStream->mState.load(memory_order_acquire) == JZSampleStream::eFree)
+      {
+        pStream->mpSample = pSample;
+        pStream->mPosition = Position;
+        pStream->mRemaining = pSample->GetTotalLength() - Position;
+        pStream->mSkipCount = 0;
+        pStream->mState.store(JZSampleStream::eOpen, memory_order_release);
+        return pStream;
+      }
+    }
+  }
+
+  ++mUnavailableCount;
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+unsigned JZSampleStreamer::GetUnderrunCount() const
+{
+  unsigned UnderrunCount = 0;
+  for (
+    vector<JZSampleStream*>::const_iterator iStream = mStreams.begin();
+    iStream != mStreams.end();
+    ++iStream)
+  {
+    UnderrunCount += (*iStream)->mUnderrunCount;
+  }
+  return UnderrunCount;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The ring buffers hold more than half a second even at 48 kHz
+// stereo, so polling them every 10 ms keeps them well ahead of the voices.
+//-----------------------------------------------------------------------------
+void JZSampleStreamer::DiskLoop()
+{
+  while (mIsRunning)
+  {
+    for (
+      vector<JZSampleStream*>::iterator iStream = mStreams.begin();
+      iStream != mStreams.end();
+      ++iStream)
+    {
+      JZSampleStream* pStream = *iStream;
+      int State = pStream->mState.load(memory_order_acquire);
+      if (State == JZSampleStream::eOpen)
+      {
+        pStream->Fill();
+      }
+      else if (State == JZSampleStream::eClosing)
+      {
+        pStream->Reset();
+        pStream->mState.store(JZSampleStream::eFree, memory_order_release);
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
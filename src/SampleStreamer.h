@@ -0,0 +1,184 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+class JZSample;
+
+//*****************************************************************************
+// Description:
+//   This is the sample stream class declaration.  A stream carries the part
+// of a streamed sample after its preloaded head from the disk thread to one
+// voice, through a lock-free ring buffer with one writer and one reader.
+// All member functions are called by the thread that renders the voices
+// unless noted otherwise.
+//*****************************************************************************
+class JZSampleStream
+{
+  friend class JZSampleStreamer;
+
+  public:
+
+    enum
+    {
+      // The ring size in shorts, a power of two.
+      eRingSize = 65536
+    };
+
+    JZSampleStream();
+
+    ~JZSampleStream();
+
+    // Returns the next samples that arrived from the disk and sets Count to
+    // their number, which is 0 if none did.
+    const short* Peek(long& Count);
+
+    // Mark the passed number of peeked samples as played.
+    void Consume(long Count);
+
+    // Play the passed number of samples as silence because they did not
+    // arrive in time.  They are discarded when they come in.
+    void Skip(long Count);
+
+    // Give the stream back to the streamer.
+    void Close();
+
+  private:
+
+    enum TEState
+    {
+      eFree,
+      eOpen,
+      eClosing
+    };
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZSampleStream(const JZSampleStream&);
+
+    JZSampleStream& operator = (const JZSampleStream&);
+
+    // Called by the disk thread.
+    void Fill();
+
+    void Reset();
+
+    std::atomic<int> mState;
+
+    std::vector<short> mRing;
+
+    // Counts of shorts read and written, wrapped into the ring.
+    std::atomic<unsigned> mRead;
+    std::atomic<unsigned> mWritten;
+
+    // The sample and the position to read it from, set by Open().
+    const JZSample* mpSample;
+    long mPosition;
+    long mRemaining;
+
+    // Samples to discard when they arrive.
+    long mSkipCount;
+
+    unsigned mUnderrunCount;
+
+    // Used by the disk thread only.
+    FILE* mpFile;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the sample streamer class declaration.  It owns a fixed number
+// of streams and a disk thread that opens the sample files of the open
+// streams and keeps their ring buffers full.
+//*****************************************************************************
+class JZSampleStreamer
+{
+  public:
+
+    enum
+    {
+      eStreamCount = 32
+    };
+
+    JZSampleStreamer();
+
+    ~JZSampleStreamer();
+
+    // Allocate the streams and start the disk thread.
+    void Start();
+
+    // Stop the disk thread and close all streams.
+    void Stop();
+
+    bool IsRunning() const;
+
+    // Returns a stream that plays the passed sample from the passed position
+    // in shorts, or 0 if none is free.  Called by the rendering thread.
+    JZSampleStream* Open(const JZSample* pSample, long Position);
+
+    // The samples played as silence because the disk was late, and the
+    // streams not opened because all were taken.
+    unsigned GetUnderrunCount() const;
+
+    unsigned GetUnavailableCount() const;
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZSampleStreamer(const JZSampleStreamer&);
+
+    JZSampleStreamer& operator = (const JZSampleStreamer&);
+
+    void DiskLoop();
+
+    std::vector<JZSampleStream*> mStreams;
+
+    std::thread mDiskThread;
+
+    std::atomic<bool> mIsRunning;
+
+    unsigned mUnavailableCount;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the sample streamer class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZSampleStreamer::IsRunning() const
+{
+  return mIsRunning;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+unsigned JZSampleStreamer::GetUnavailableCount() const
+{
+  return mUnavailableCount;
+}
@@ -27,6 +27,7 @@
 //#include "Command.h"
 #include "Globals.h"
 #include "Metronome.h"
+#include "PlayBuffer.h"
 #include "StringUtilities.h"
 #include "Synth.h"
 
@@ -37,6 +38,50 @@
 
 using namespace std;
 
+//-----------------------------------------------------------------------------
+// Description:
+//   Add the parts of a metronome click that fall into [FrClock, ToClock) to
+// the click entries.  The passed key on event is consumed.
+//-----------------------------------------------------------------------------
+static void AddMetronomeClick(
+  JZKeyOnEvent* pKeyOn,
+  int FrClock,
+  int ToClock,
+  vector<JZScheduleEntry>& Clicks,
+  bool CloseNotes)
+{
+  JZScheduleEntry Entry;
+  Entry.mOnClock = pKeyOn->GetClock();
+  Entry.mTrackIndex = -1;
+
+  int OffClock = pKeyOn->GetClock() + pKeyOn->GetEventLength();
+  if (CloseNotes && OffClock >= ToClock)
+  {
+    OffClock = ToClock - 1;
+  }
+
+  if (OffClock >= FrClock && OffClock < ToClock)
+  {
+    Entry.mClock = OffClock;
+    Entry.mpEvent = new JZKeyOffEvent(
+      OffClock,
+      pKeyOn->GetChannel(),
+      pKeyOn->GetKey());
+    Clicks.push_back(Entry);
+  }
+
+  if (pKeyOn->GetClock() >= FrClock)
+  {
+    Entry.mClock = pKeyOn->GetClock();
+    Entry.mpEvent = pKeyOn;
+    Clicks.push_back(Entry);
+  }
+  else
+  {
+    delete pKeyOn;
+  }
+}
+
 //*****************************************************************************
 // Description:
 //   This is the bar information class definition.
@@ -139,7 +184,8 @@ JZSong::JZSong()
     mTicksPerQuarter(120),
     mIntroLength(0),
     mTrackCount(eMaxTrackCount),
-    mTracks()
+    mTracks(),
+    mPlaybackSchedule(*this)
 {
 }
 
@@ -337,25 +383,40 @@ int JZSong::StringToClock(const string& ClockString) const
 }
 
 //-----------------------------------------------------------------------------
+// Description:
+//   The playing tracks and the metronome clicks are merged with a min-heap,
+// so the events are put into the destination in clock order and it never
+// needs sorting.
 //-----------------------------------------------------------------------------
 void JZSong::MergeTracks(
   int FrClock,
   int ToClock,
-  JZEventArray* pDestin,
+  JZPlayBuffer* pDestin,
   const JZMetronomeInfo& MetronomeInfo,
   int delta,
-  bool AudioMode)
+  bool AudioMode,
+  int PassClock,
+  bool CloseNotes)
 {
+  mPlaybackSchedule.Update();
+  unsigned Epoch = mPlaybackSchedule.GetEpoch();
+
   // Make metronome
+  vector<JZScheduleEntry> Clicks;
   if (MetronomeInfo.IsOn())
   {
-    MakeMetronome(FrClock, ToClock, pDestin, MetronomeInfo, delta);
+    MakeMetronome(
+      FrClock,
+      ToClock,
+      Clicks,
+      MetronomeInfo,
+      PassClock,
+      CloseNotes);
   }
 
   // Find solo-tracks.
-  int i;
   bool DoSoloTracksExist = false;
-  for (i = 0; i < mTrackCount; i++)
+  for (int i = 0; i < mTrackCount; i++)
   {
     if (mTracks[i].mState == tsSolo)
     {
@@ -364,137 +425,162 @@ void JZSong::MergeTracks(
     }
   }
 
-  for (i = 0; i < mTrackCount; ++i)
+  // The metronome clicks go first, as they did before the track events.
+  JZScheduleMerger Merger;
+  Merger.AddRun(Clicks, 0, static_cast<int>(Clicks.size()));
+  for (int i = 0; i < mTrackCount; ++i)
+  {
+    if (IsTrackPlaying(i, DoSoloTracksExist, AudioMode))
+    {
+      const vector<JZScheduleEntry>& Entries =
+        mPlaybackSchedule.GetEntries(i);
+      Merger.AddRun(
+        Entries,
+        JZPlaybackSchedule::Find(Entries, FrClock),
+        JZPlaybackSchedule::Find(Entries, ToClock));
+    }
+  }
+
+  const JZScheduleEntry* pEntry;
+  while ((pEntry = Merger.Next()) != 0)
   {
-    JZTrack* pTrack = &mTracks[i];
-    if (
-      pTrack->mState == tsSolo ||
-      (!DoSoloTracksExist && pTrack->mState == tsPlay))
+    // Skip key off events of notes that were not played in this pass.
+    if (pEntry->mOnClock < PassClock)
     {
-      if (pTrack->GetAudioMode() != AudioMode)
+      continue;
+    }
+
+    pDestin->Put(
+      pEntry->mClock + delta,
+      pEntry->mpEvent->GetDevice(),
+      pEntry->mpEvent,
+      Epoch);
+  }
+
+  // The metronome clicks were created for this window only.
+  for (
+    vector<JZScheduleEntry>::const_iterator iClick = Clicks.begin();
+    iClick != Clicks.end();
+    ++iClick)
+  {
+    mPlaybackSchedule.Retire(iClick->mpEvent);
+  }
+
+  // At the end of a loop the key off events of notes that are still
+  // sounding will not be reached, so end those notes here.
+  if (CloseNotes && !AudioMode)
+  {
+    for (int i = 0; i < mTrackCount; ++i)
+    {
+      if (!IsTrackPlaying(i, DoSoloTracksExist, AudioMode))
       {
         continue;
       }
 
-      JZEventIterator Iterator(&mTracks[i]);
-      JZEvent* pEvent = Iterator.Range(FrClock, ToClock);
-      while (pEvent)
+      const vector<JZScheduleEntry>& Entries =
+        mPlaybackSchedule.GetEntries(i);
+      int EntryCount = JZPlaybackSchedule::Find(Entries, ToClock);
+      for (
+        int EntryIndex = JZPlaybackSchedule::Find(Entries, PassClock);
+        EntryIndex < EntryCount;
+        ++EntryIndex)
       {
-        JZEvent* pEventCopy = pEvent->Copy();
-        pEventCopy->SetClock(pEventCopy->GetClock() + delta);
-        pEventCopy->SetDevice(pTrack->GetDevice());
-        pDestin->Put(pEventCopy);
-
-        if (pEventCopy->IsPlayTrack())
+        JZKeyOnEvent* pKeyOn = Entries[EntryIndex].mpEvent->IsKeyOn();
+        if (
+          pKeyOn &&
+          pKeyOn->GetEventLength() != 0 &&
+          Entries[EntryIndex].mClock + pKeyOn->GetEventLength() >= ToClock)
         {
-          MergePlayTrackEvent(pEventCopy->IsPlayTrack(), pDestin, 0);
+          JZKeyOffEvent* pKeyOff = new JZKeyOffEvent(
+            ToClock - 1,
+            pKeyOn->GetChannel(),
+            pKeyOn->GetKey(),
+            pKeyOn->GetOffVelocity());
+          pKeyOff->SetDevice(pKeyOn->GetDevice());
+          mPlaybackSchedule.Retire(pKeyOff);
+          pDestin->Put(
+            ToClock - 1 + delta,
+            pKeyOff->GetDevice(),
+            pKeyOff,
+            Epoch);
         }
-
-        pEvent = Iterator.Next();
       }
     }
   }
 }
 
 //-----------------------------------------------------------------------------
-// Should call recursively, so playtrack events will resolve playtrack events.
 //-----------------------------------------------------------------------------
-void JZSong::MergePlayTrackEvent(
-  JZPlayTrackEvent* c, //the playtrack event
-  JZEventArray* pDestin,
-  int recursionDepth)
+JZPlaybackSchedule& JZSong::GetPlaybackSchedule()
+{
+  return mPlaybackSchedule;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSong::GetPlayingTracks(vector<bool>& IsPlaying, bool AudioMode) const
 {
-  // Recursion might be simple, but we have the infinite loop problem, if a
-  // playtrack point to itself, either directly or indirectly.
-  // We probaly need to keep a list of seen tracks, simpler is to limit the
-  // recursion level to 100 or something.
-  // The actual recursion is done later in the loop.
-  recursionDepth++;
-  if (recursionDepth > 100) //yes yes, you should use symbolics...
+  bool DoSoloTracksExist = false;
+  for (int i = 0; i < mTrackCount; ++i)
   {
-    return;
+    if (mTracks[i].mState == tsSolo)
+    {
+      DoSoloTracksExist = true;
+      break;
+    }
   }
 
-  fprintf(stderr, "playtrack %d\n", c->track);
-  JZTrack* pTrack = &mTracks[c->track]; // the track we want to play
-
-  // Get an iterator of all events the playtrack is pointing to.
-  JZEventIterator IteratorPL(pTrack);
-  JZEvent* f;
-
-  // FIXME this is just to test the idea.  It would be good to modify
-  // GetLastClock instead.
-  // Find an EOT event, otherwise default to the last clock (should be +
-  // length of the last event as well).
-  int loopLength = 0;
-
-  // Get an iterator of all events the playtrack is pointing to.
-  JZEventIterator IteratorEOT(pTrack);
-  f = IteratorEOT.Range(0, pTrack->GetLastClock());
+  IsPlaying.resize(mTrackCount);
+  for (int i = 0; i < mTrackCount; ++i)
+  {
+    IsPlaying[i] = IsTrackPlaying(i, DoSoloTracksExist, AudioMode);
+  }
+}
 
-  // looplength will be used to loop the track, for the duration of
-  // the playtrack event.
-  loopLength = pTrack->GetLastClock();
-  while (f)
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZSong::IsTrackPlaying(
+  int TrackIndex,
+  bool DoSoloTracksExist,
+  bool AudioMode) const
+{
+  const JZTrack& Track = mTracks[TrackIndex];
+  if (Track.GetAudioMode() != AudioMode)
   {
-    if (f->IsEndOfTrack())
-    {
-      loopLength = pTrack->GetLastClock();
-    }
-    f = IteratorEOT.Next();
-  }
-
-  int loopOffset = 0;
-
-  //   The loop below is supposed to repeat the referenced track for the
-  // duration of the playtrack event.  Also, we should look out for if we
-  // start playing in the middle of an playtrack event, curently it wont
-  // play anything.
-  //   To fix this we could search all unmuted tracks from the beginning to
-  // the start of the loop-point, and see if there are any playtrack events
-  // which start + length end up after the startloop.  Then we could move the
-  // start of those to the beginning of the loop, and shorten the length.
-  // There would still be a problem with playtracks not even bar length.
-  while (loopOffset < c->eventlength)
-  {
-    // No more events than the length of the playtrack!  and ensure the last
-    // iteration is no longer than what is left.
-    f = IteratorPL.Range(0, (c->eventlength-loopOffset));
-    while (f)
-    {
-      JZEvent* d = f->Copy();
-      d->SetClock(d->GetClock() + c->GetClock() + loopOffset);
-      if (d->IsKeyOn())
-      {
-        d->IsKeyOn()->SetKey(d->IsKeyOn()->GetKey() + c->transpose);
-      }
-      if (d->IsPlayTrack())
-      {
-        MergePlayTrackEvent(d->IsPlayTrack(), pDestin, recursionDepth);
-      }
-      d->SetDevice(pTrack->GetDevice());
-      pDestin->Put(d);
-      f = IteratorPL.Next();
-    }
-    loopOffset+=loopLength;
+    return false;
   }
+  return
+    Track.mState == tsSolo ||
+    (!DoSoloTracksExist && Track.mState == tsPlay);
 }
 
 //-----------------------------------------------------------------------------
+// Description:
+//   Create the clock ordered metronome clicks in [FrClock, ToClock) together
+// with their key off events.  The key off of a click started just before
+// FrClock falls into this window, so the search starts one click length
+// earlier.
 //-----------------------------------------------------------------------------
 void JZSong::MakeMetronome(
   int FrClock,
   int ToClock,
-  JZEventArray* pDestin,
+  vector<JZScheduleEntry>& Clicks,
   const JZMetronomeInfo& MetronomeInfo,
-  int delta)
+  int PassClock,
+  bool CloseNotes)
 {
+  int StartClock = FrClock - MetronomeInfo.GetClickLength();
+  if (StartClock < PassClock)
+  {
+    StartClock = PassClock;
+  }
+
   JZBarInfo BarInfo(*this);
-  BarInfo.SetClock(FrClock);
+  BarInfo.SetClock(StartClock);
   int clk = BarInfo.GetClock();
   int count = 1;
 
-  while (clk < FrClock)
+  while (clk < StartClock)
   {
     clk += BarInfo.GetTicksPerBar() / BarInfo.GetCountsPerBar();
     count++;
@@ -510,18 +596,30 @@ void JZSong::MakeMetronome(
     }
 
     // Insert normal click always
-    pDestin->Put(MetronomeInfo.CreateNormalEvent(clk + delta));
+    AddMetronomeClick(
+      MetronomeInfo.CreateNormalEvent(clk),
+      FrClock,
+      ToClock,
+      Clicks,
+      CloseNotes);
 
     //  On a bar?
     if (count == 1 && MetronomeInfo.IsAccented())
     {
       // Insert accented click also
-      pDestin->Put(MetronomeInfo.CreateAccentedEvent(clk + delta));
+      AddMetronomeClick(
+        MetronomeInfo.CreateAccentedEvent(clk),
+        FrClock,
+        ToClock,
+        Clicks,
+        CloseNotes);
     }
 
     clk += BarInfo.GetTicksPerBar() / BarInfo.GetCountsPerBar();
     count++;
   }
+
+  JZPlaybackSchedule::Sort(Clicks);
 }
 
 //-----------------------------------------------------------------------------
@@ -578,6 +676,9 @@ void JZSong::SetTicksPerQuarter(int TicksPerQuarter)
     }
   }
   mTicksPerQuarter = TicksPerQuarter;
+
+  // The events were changed in place, without a cleanup.
+  mPlaybackSchedule.InvalidateAll();
 }
 
 //-----------------------------------------------------------------------------
@@ -668,4 +769,6 @@ void JZSong::moveTrack(int from, int to)
     }
   }
   mTracks[to] = *pTrack;
+
+  mPlaybackSchedule.InvalidateAll();
 }
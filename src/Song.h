@@ -25,10 +25,13 @@
 #include "Track.h"
 #include "Configuration.h"
 #include "Globals.h"
+#include "PlaybackSchedule.h"
 
 #include <string>
+#include <vector>
 
 class JZMetronomeInfo;
+class JZPlayBuffer;
 class JZSong;
 
 //*****************************************************************************
@@ -114,19 +117,28 @@ class JZSong
 
     int StringToClock(const std::string& ClockString) const;
 
-    // Merge events from all tracks into the destination array.
+    // Merge events from all playing tracks in [FrClock, ToClock) into the
+    // destination buffer, in clock order.  The events are taken from the
+    // playback schedule, so key on events are followed by explicit key off
+    // events.  Key off events of notes started before PassClock, the clock
+    // where the current contiguous playback started, are skipped.  If
+    // CloseNotes is set, ToClock is the end of a loop and notes still
+    // sounding there get a key off just before it.
     void MergeTracks(
       int FrClock,
       int ToClock,
-      JZEventArray *Destin,
+      JZPlayBuffer* pDestin,
       const JZMetronomeInfo& MetronomeInfo,
       int DeltaClock = 0,
-      bool AudioMode = false);
+      bool AudioMode = false,
+      int PassClock = 0,
+      bool CloseNotes = false);
 
-    void MergePlayTrackEvent(
-      JZPlayTrackEvent* c,
-      JZEventArray *Destin,
-      int recursionDepth);
+    JZPlaybackSchedule& GetPlaybackSchedule();
+
+    // Fill IsPlaying with the play state of every track, taking mute and solo
+    // into account.
+    void GetPlayingTracks(std::vector<bool>& IsPlaying, bool AudioMode) const;
 
     int SetMeterChange(
       int BarNr,
@@ -138,9 +150,15 @@ class JZSong
     void MakeMetronome(
       int FrClock,
       int ToClock,
-      JZEventArray *Destin,
+      std::vector<JZScheduleEntry>& Clicks,
       const JZMetronomeInfo& MetronomeInfo,
-      int delta = 0);
+      int PassClock,
+      bool CloseNotes);
+
+    bool IsTrackPlaying(
+      int TrackIndex,
+      bool DoSoloTracksExist,
+      bool AudioMode) const;
 
   private:
 
@@ -156,6 +174,10 @@ class JZSong
 
     int mTrackCount;
     JZTrack mTracks[eMaxTrackCount];
+
+  private:
+
+    JZPlaybackSchedule mPlaybackSchedule;
 };
 
 //*****************************************************************************
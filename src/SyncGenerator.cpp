@@ -0,0 +1,548 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "SyncGenerator.h"
+
+#include "PlaybackStatistics.h"
+#include "Song.h"
+#include "Track.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   The MTC frame rates in the order of the MTC types.  The drop frame type
+// runs at 29.97 frames per second.
+//*****************************************************************************
+static const double gMtcFramesPerSecond[] =
+{
+  24.0,
+  25.0,
+  30000.0 / 1001.0,
+  30.0
+};
+
+//*****************************************************************************
+// Description:
+//   The offset of the driver time is the smallest one seen in a window of
+// this many microseconds.
+//*****************************************************************************
+static const double gOffsetWindow = 1000000.0;
+
+//*****************************************************************************
+// Description:
+//   The shortest time the worker thread sleeps again when it woke up before
+// a deadline, in microseconds, so a driver clock that stands still does not
+// keep it busy.
+//*****************************************************************************
+static const double gMinimumResleep = 100.0;
+
+//*****************************************************************************
+// Description:
+//   This is the sync generator class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSyncGenerator::JZSyncGenerator(JZPlaybackStatistics& Statistics)
+  : mStatistics(Statistics),
+    mMessages(0),
+    mStartClock(0),
+    mLoopClock(0),
+    mContinue(false),
+    mTicksPerQuarter(1),
+    mTempoMap(),
+    mMtcType(0),
+    mFramesPerSecond(gMtcFramesPerSecond[0]),
+    mMtcOffset(0.0),
+    mPassStart(0.0),
+    mPassEnd(0.0),
+    mPassSongStart(0.0),
+    mQuarterFrame(0),
+    mStartTime(),
+    mHasOffset(false),
+    mOffset(0.0),
+    mWindowOffset(0.0),
+    mWindowStart(0.0),
+    mIsStopping(false),
+    mMutex(),
+    mCondition(),
+    mWorker()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSyncGenerator::~JZSyncGenerator()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The tempo map and the MTC offset are copied here, in the thread that
+// owns the song, so the worker thread never touches the song.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::Start(
+  JZSong& Song,
+  int Clock,
+  int LoopClock,
+  bool Continue,
+  int Messages)
+{
+  Stop();
+
+  mMessages = Messages & (eMidiClock | eMtc);
+  if (!mMessages)
+  {
+    return;
+  }
+
+  mStartClock = Clock;
+  mLoopClock = LoopClock > Clock ? LoopClock : 0;
+  mContinue = Continue;
+  mTicksPerQuarter = Song.GetTicksPerQuarter();
+  BuildTempoMap(Song);
+
+  JZMtcTime* pMtcOffset = Song.GetTrack(0)->GetMtcOffset();
+  mMtcType = pMtcOffset->GetType();
+  mFramesPerSecond = gMtcFramesPerSecond[mMtcType];
+  mMtcOffset = pMtcOffset->ToMillisec() * 1000.0;
+  delete pMtcOffset;
+
+  mIsStopping = false;
+  mHasOffset = false;
+  mStartTime = JZClock::now();
+  mWorker = thread(&JZSyncGenerator::Run, this);
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::Stop()
+{
+  if (!mWorker.joinable())
+  {
+    return;
+  }
+
+  {
+    lock_guard<mutex> Lock(mMutex);
+    mIsStopping = true;
+  }
+  mCondition.notify_all();
+  mWorker.join();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::OnThreadStart()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZSyncGenerator::GetDriverTime(int&, double&)
+{
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Every segment starts at a tempo change and knows the time from the song
+// start to its first tick.  Tempos are rounded to whole microseconds per
+// quarter note like the drivers do.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::BuildTempoMap(JZSong& Song)
+{
+  mTempoMap.clear();
+
+  JZTempoSegment Segment;
+  Segment.mClock = 0;
+  Segment.mMicroseconds = 0.0;
+  Segment.mMicrosecondsPerTick = (60000000 / 120) / (double)mTicksPerQuarter;
+  mTempoMap.push_back(Segment);
+
+  JZEventIterator Iterator(Song.GetTrack(0));
+  JZEvent* pEvent = Iterator.First();
+  while (pEvent)
+  {
+    JZSetTempoEvent* pSetTempo = pEvent->IsSetTempo();
+    if (pSetTempo && pSetTempo->GetBPM() > 0)
+    {
+      const JZTempoSegment& Last = mTempoMap.back();
+      Segment.mClock = pSetTempo->GetClock();
+      Segment.mMicroseconds =
+        Last.mMicroseconds +
+        (Segment.mClock - Last.mClock) * Last.mMicrosecondsPerTick;
+      Segment.mMicrosecondsPerTick =
+        (60000000 / pSetTempo->GetBPM()) / (double)mTicksPerQuarter;
+      if (Segment.mClock == Last.mClock)
+      {
+        mTempoMap.back() = Segment;
+      }
+      else
+      {
+        mTempoMap.push_back(Segment);
+      }
+    }
+    pEvent = Iterator.Next();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The time from the song start to the passed song position.
+//-----------------------------------------------------------------------------
+double JZSyncGenerator::GetSongMicroseconds(double Clock) const
+{
+  // Find the last segment that starts at or before the clock.
+  vector<JZTempoSegment>::size_type Lo = 0;
+  vector<JZTempoSegment>::size_type Hi = mTempoMap.size();
+  while (Hi - Lo > 1)
+  {
+    vector<JZTempoSegment>::size_type Middle = (Lo + Hi) / 2;
+    if (mTempoMap[Middle].mClock <= Clock)
+    {
+      Lo = Middle;
+    }
+    else
+    {
+      Hi = Middle;
+    }
+  }
+
+  const JZTempoSegment& Segment = mTempoMap[Lo];
+  return
+    Segment.mMicroseconds +
+    (Clock - Segment.mClock) * Segment.mMicrosecondsPerTick;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The time from the start of playback to the passed clock, which keeps
+// counting when playback loops, like the clock of the players.
+//-----------------------------------------------------------------------------
+double JZSyncGenerator::GetPlayMicroseconds(double Clock) const
+{
+  double Start = GetSongMicroseconds(mStartClock);
+  if (mLoopClock == 0 || Clock < mLoopClock)
+  {
+    return GetSongMicroseconds(Clock) - Start;
+  }
+
+  double Length = mLoopClock - mStartClock;
+  double Passes = floor((Clock - mStartClock) / Length);
+  double Rest = Clock - mStartClock - Passes * Length;
+  return
+    Passes * (GetSongMicroseconds(mLoopClock) - Start) +
+    GetSongMicroseconds(mStartClock + Rest) - Start;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The worker thread.  MIDI clock starts on the next sixteenth note, the
+// unit of the song position pointer, and MTC on the next quarter frame.
+// Both are sent in the order of their deadlines.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::Run()
+{
+  OnThreadStart();
+
+  unsigned char Message[3];
+  long long ClockTick = 0;
+
+  if (mMessages & eMidiClock)
+  {
+    int Beat = (int)(
+      ((long long)mStartClock * 4 + mTicksPerQuarter - 1) / mTicksPerQuarter);
+    if (mContinue || Beat > 0)
+    {
+      Message[0] = 0xf2;
+      Message[1] = Beat & 0x7f;
+      Message[2] = (Beat >> 7) & 0x7f;
+      Send(Message, 3);
+      Message[0] = 0xfb;
+    }
+    else
+    {
+      Message[0] = 0xfa;
+    }
+    Send(Message, 1);
+    ClockTick = (long long)Beat * 6;
+  }
+
+  if (mMessages & eMtc)
+  {
+    StartMtcPass(0.0, mMtcOffset + GetSongMicroseconds(mStartClock));
+  }
+
+  while (true)
+  {
+    double ClockDeadline = HUGE_VAL;
+    if (mMessages & eMidiClock)
+    {
+      ClockDeadline = GetPlayMicroseconds(
+        (double)ClockTick * mTicksPerQuarter / 24.0);
+    }
+
+    double MtcDeadline = HUGE_VAL;
+    bool IsPassEnd = false;
+    if (mMessages & eMtc)
+    {
+      MtcDeadline =
+        mPassStart +
+        mQuarterFrame * 1000000.0 / (4.0 * mFramesPerSecond) -
+        mPassSongStart;
+      if (MtcDeadline >= mPassEnd)
+      {
+        MtcDeadline = mPassEnd;
+        IsPassEnd = true;
+      }
+    }
+
+    double Deadline = min(ClockDeadline, MtcDeadline);
+    if (!WaitUntil(Deadline))
+    {
+      break;
+    }
+
+    if (ClockDeadline <= MtcDeadline)
+    {
+      Message[0] = 0xf8;
+      Send(Message, 1);
+      ++ClockTick;
+    }
+    else if (IsPassEnd)
+    {
+      StartMtcPass(mPassEnd, mMtcOffset + GetSongMicroseconds(mStartClock));
+    }
+    else
+    {
+      SendQuarterFrame();
+    }
+
+    double Lateness = GetTime() - Deadline;
+    mStatistics.AddSyncJitter(Lateness > 0.0 ? (unsigned)Lateness : 0);
+  }
+
+  if (mMessages & eMidiClock)
+  {
+    Message[0] = 0xfc;
+    Send(Message, 1);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The current time on the playback time line.  The driver counts whole
+// clocks, so the driver time minus the time line position of its clock is
+// never less than the real offset.
+//-----------------------------------------------------------------------------
+double JZSyncGenerator::GetTime()
+{
+  int Clock;
+  double DriverTime;
+  if (!GetDriverTime(Clock, DriverTime))
+  {
+    return
+      chrono::duration<double, micro>(JZClock::now() - mStartTime).count();
+  }
+
+  double Offset = DriverTime - GetPlayMicroseconds(Clock);
+  if (!mHasOffset)
+  {
+    mHasOffset = true;
+    mOffset = mWindowOffset = Offset;
+    mWindowStart = DriverTime;
+  }
+  else
+  {
+    mOffset = min(mOffset, Offset);
+    mWindowOffset = min(mWindowOffset, Offset);
+    if (DriverTime - mWindowStart >= gOffsetWindow)
+    {
+      // Let the offset rise again when the driver clock runs slower than
+      // the tempo map, for example after a tempo change.
+      mOffset = mWindowOffset;
+      mWindowOffset = Offset;
+      mWindowStart = DriverTime;
+    }
+  }
+  return DriverTime - mOffset;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Sleep until the time line reaches the deadline.  A driver clock that
+// runs slower than the monotonic clock wakes the thread up early, so it
+// sleeps again for the rest.  Returns false if Stop() was called.
+//-----------------------------------------------------------------------------
+bool JZSyncGenerator::WaitUntil(double Microseconds)
+{
+  unique_lock<mutex> Lock(mMutex);
+  bool IsFirst = true;
+  while (!mIsStopping)
+  {
+    double Rest = Microseconds - GetTime();
+    if (Rest <= 0.0)
+    {
+      return true;
+    }
+    if (!IsFirst)
+    {
+      Rest = max(Rest, gMinimumResleep);
+    }
+    IsFirst = false;
+    mCondition.wait_until(
+      Lock,
+      JZClock::now() +
+        chrono::duration_cast<JZClock::duration>(
+          chrono::duration<double, micro>(Rest)));
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Start a pass of MTC at the passed time of playback and time code
+// position, both in microseconds, with a full frame message.  The pass ends
+// at the end of the loop.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::StartMtcPass(double Microseconds, double SongMicroseconds)
+{
+  mPassStart = Microseconds;
+  mPassSongStart = SongMicroseconds;
+  mPassEnd = HUGE_VAL;
+  if (mLoopClock)
+  {
+    mPassEnd =
+      Microseconds +
+      GetSongMicroseconds(mLoopClock) - GetSongMicroseconds(mStartClock);
+  }
+
+  mQuarterFrame =
+    (long long)ceil(SongMicroseconds * 4.0 * mFramesPerSecond / 1000000.0);
+
+  SendFullFrame(
+    (long long)floor(SongMicroseconds * mFramesPerSecond / 1000000.0));
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Eight quarter frames carry the time code of the frame in which the
+// first of them is sent, a nibble each.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::SendQuarterFrame()
+{
+  int Piece = (int)(mQuarterFrame % 8);
+  int Hours, Minutes, Seconds, Frames;
+  GetTimeCode((mQuarterFrame - Piece) / 4, Hours, Minutes, Seconds, Frames);
+
+  int Nibble = 0;
+  switch (Piece)
+  {
+    case 0:
+      Nibble = Frames & 0x0f;
+      break;
+    case 1:
+      Nibble = Frames >> 4;
+      break;
+    case 2:
+      Nibble = Seconds & 0x0f;
+      break;
+    case 3:
+      Nibble = Seconds >> 4;
+      break;
+    case 4:
+      Nibble = Minutes & 0x0f;
+      break;
+    case 5:
+      Nibble = Minutes >> 4;
+      break;
+    case 6:
+      Nibble = Hours & 0x0f;
+      break;
+    case 7:
+      Nibble = (Hours >> 4) | (mMtcType << 1);
+      break;
+  }
+
+  unsigned char Message[2];
+  Message[0] = 0xf1;
+  Message[1] = (unsigned char)((Piece << 4) | Nibble);
+  Send(Message, 2);
+
+  ++mQuarterFrame;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::SendFullFrame(long long Frame)
+{
+  int Hours, Minutes, Seconds, Frames;
+  GetTimeCode(Frame, Hours, Minutes, Seconds, Frames);
+
+  unsigned char Message[10];
+  Message[0] = 0xf0;
+  Message[1] = 0x7f;
+  Message[2] = 0x7f;
+  Message[3] = 0x01;
+  Message[4] = 0x01;
+  Message[5] = (unsigned char)((mMtcType << 5) | Hours);
+  Message[6] = (unsigned char)Minutes;
+  Message[7] = (unsigned char)Seconds;
+  Message[8] = (unsigned char)Frames;
+  Message[9] = 0xf7;
+  Send(Message, 10);
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   Convert a frame count into a time code.  Drop frame time code skips the
+// frame numbers 0 and 1 at the start of every minute except every tenth.
+//-----------------------------------------------------------------------------
+void JZSyncGenerator::GetTimeCode(
+  long long Frame,
+  int& Hours,
+  int& Minutes,
+  int& Seconds,
+  int& Frames) const
+{
+  int Rate = (int)(mFramesPerSecond + 0.5);
+  if (mMtcType == Mtc30Df)
+  {
+    long long TenMinutes = Frame / 17982;
+    long long Rest = Frame % 17982;
+    Frame += 18 * TenMinutes;
+    if (Rest >= 2)
+    {
+      Frame += 2 * ((Rest - 2) / 1798);
+    }
+  }
+
+  Frames = (int)(Frame % Rate);
+  long long TotalSeconds = Frame / Rate;
+  Seconds = (int)(TotalSeconds % 60);
+  Minutes = (int)((TotalSeconds / 60) % 60);
+  Hours = (int)((TotalSeconds / 3600) % 24);
+}
@@ -0,0 +1,198 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JZPlaybackStatistics;
+class JZSong;
+
+//*****************************************************************************
+// Description:
+//   This is the sync generator class declaration.  While a song plays, a
+// worker thread sends MIDI clock messages, 24 per quarter note, and MTC
+// quarter frame messages computed from the tempo map of the song.
+//
+//   Every message has an absolute deadline on the playback time line, so
+// timer errors do not add up: a late message delays only itself.  A driver
+// with a clock of its own reports it through GetDriverTime(), and the time
+// line follows that clock: its offset from the driver time is the smallest
+// one seen in a window, which is renewed every window.  Otherwise the time
+// line follows the monotonic clock from the start of playback.  The thread
+// sleeps until a deadline and checks the time line again when it wakes up.
+// How late each message was sent is added to the sync jitter statistics.
+//
+//   The tempo map is read when playback starts.  Tempo changes made while
+// playing are followed only as far as the driver clock follows them.  When
+// playback loops, MIDI clock keeps counting while MTC jumps back to the loop
+// start with a full frame message.
+//
+//   Derived classes send the messages to a driver.  Their destructors must
+// call Stop(), because the worker thread calls Send().
+//*****************************************************************************
+class JZSyncGenerator
+{
+  public:
+
+    // The messages to send.
+    enum
+    {
+      eMidiClock = 1,
+      eMtc = 2
+    };
+
+    JZSyncGenerator(JZPlaybackStatistics& Statistics);
+
+    virtual ~JZSyncGenerator();
+
+    // Start sending the passed messages for playback that starts at Clock
+    // and loops back to Clock at LoopClock, if LoopClock is not 0.
+    void Start(
+      JZSong& Song,
+      int Clock,
+      int LoopClock,
+      bool Continue,
+      int Messages);
+
+    // Stop the worker thread.  MIDI clock output ends with a stop message.
+    void Stop();
+
+    bool IsRunning() const;
+
+  protected:
+
+    // Called by the worker thread for every message.
+    virtual void Send(const unsigned char* pMessage, int Length) = 0;
+
+    // Called by the worker thread before it sends the first message, for
+    // example to raise its priority.
+    virtual void OnThreadStart();
+
+    // Called by the worker thread.  Returns the clock the driver has reached
+    // and the time of the driver clock in microseconds, or false if the
+    // driver has no clock of its own.
+    virtual bool GetDriverTime(int& Clock, double& Microseconds);
+
+  private:
+
+    struct JZTempoSegment
+    {
+      int mClock;
+      double mMicroseconds;
+      double mMicrosecondsPerTick;
+    };
+
+    typedef std::chrono::steady_clock JZClock;
+
+    void BuildTempoMap(JZSong& Song);
+
+    double GetSongMicroseconds(double Clock) const;
+
+    double GetPlayMicroseconds(double Clock) const;
+
+    void Run();
+
+    double GetTime();
+
+    bool WaitUntil(double Microseconds);
+
+    void StartMtcPass(double Microseconds, double SongMicroseconds);
+
+    void SendQuarterFrame();
+
+    void SendFullFrame(long long Frame);
+
+    void GetTimeCode(
+      long long Frame,
+      int& Hours,
+      int& Minutes,
+      int& Seconds,
+      int& Frames) const;
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZSyncGenerator(const JZSyncGenerator&);
+    JZSyncGenerator& operator = (const JZSyncGenerator&);
+
+  private:
+
+    JZPlaybackStatistics& mStatistics;
+
+    int mMessages;
+
+    int mStartClock;
+
+    int mLoopClock;
+
+    bool mContinue;
+
+    int mTicksPerQuarter;
+
+    std::vector<JZTempoSegment> mTempoMap;
+
+    // The MTC type, frame rate and the time code of the song start.
+    int mMtcType;
+    double mFramesPerSecond;
+    double mMtcOffset;
+
+    // The current pass through the song or loop for MTC: when it started
+    // and ends on the playback time line, where it started in the song,
+    // and the next quarter frame.
+    double mPassStart;
+    double mPassEnd;
+    double mPassSongStart;
+    long long mQuarterFrame;
+
+    JZClock::time_point mStartTime;
+
+    // The offset of the driver time from the playback time line.
+    bool mHasOffset;
+    double mOffset;
+    double mWindowOffset;
+    double mWindowStart;
+
+    bool mIsStopping;
+
+    std::mutex mMutex;
+
+    std::condition_variable mCondition;
+
+    std::thread mWorker;
+};
+
+//*****************************************************************************
+// Description:
+//   These are the sync generator class inline member functions.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+inline
+bool JZSyncGenerator::IsRunning() const
+{
+  return mWorker.joinable();
+}
@@ -0,0 +1,354 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#include "SysExSender.h"
+
+using namespace std;
+
+//*****************************************************************************
+// Description:
+//   This is the SysEx listener class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSysExListener::~JZSysExListener()
+{
+}
+
+//*****************************************************************************
+// Description:
+//   This is the SysEx sender class definition.
+//*****************************************************************************
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSysExSender::JZSysExSender()
+  : mQueues(),
+    mBytesPerSecond(0),
+    mGapMicroseconds(0),
+    mNextId(1),
+    mQueuedMessageCount(0),
+    mQueuedByteCount(0),
+    mPeakQueuedByteCount(0),
+    mSentMessageCount(0),
+    mIsStopping(false),
+    mMutex(),
+    mCondition()
+{
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+JZSysExSender::~JZSysExSender()
+{
+  Stop();
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSysExSender::SetPacing(int BytesPerSecond, int GapMilliseconds)
+{
+  lock_guard<mutex> Lock(mMutex);
+  mBytesPerSecond = BytesPerSecond > 0 ? BytesPerSecond : 0;
+  mGapMicroseconds = GapMilliseconds > 0 ? GapMilliseconds * 1000 : 0;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSysExSender::Send(
+  int Device,
+  const unsigned char* pMessage,
+  int Length,
+  JZSysExListener* pListener)
+{
+  if (Length <= 0)
+  {
+    return 0;
+  }
+
+  int QueueDevice = GetQueueDevice(Device);
+
+  lock_guard<mutex> Lock(mMutex);
+
+  JZDeviceQueue*& pQueue = mQueues[QueueDevice];
+  if (!pQueue)
+  {
+    pQueue = new JZDeviceQueue();
+    pQueue->mNextTime = JZClock::now();
+    pQueue->mpListener = nullptr;
+    pQueue->mIsSending = false;
+    pQueue->mWorker = thread(&JZSysExSender::Run, this, QueueDevice, pQueue);
+  }
+
+  pQueue->mMessages.push_back(JZMessage());
+  JZMessage& Message = pQueue->mMessages.back();
+  Message.mId = mNextId++;
+  Message.mData.assign(pMessage, pMessage + Length);
+  Message.mpListener = pListener;
+
+  ++mQueuedMessageCount;
+  mQueuedByteCount += Length;
+  if (mQueuedByteCount > mPeakQueuedByteCount)
+  {
+    mPeakQueuedByteCount = mQueuedByteCount;
+  }
+
+  mCondition.notify_all();
+
+  return Message.mId;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZSysExSender::IsBusy(int Device) const
+{
+  int QueueDevice = GetQueueDevice(Device);
+
+  lock_guard<mutex> Lock(mMutex);
+
+  map<int, JZDeviceQueue*>::const_iterator iQueue = mQueues.find(QueueDevice);
+  if (iQueue == mQueues.end())
+  {
+    return false;
+  }
+  const JZDeviceQueue* pQueue = iQueue->second;
+  return
+    !pQueue->mMessages.empty() ||
+    pQueue->mIsSending ||
+    JZClock::now() < pQueue->mNextTime;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+bool JZSysExSender::WaitUntilIdle(int TimeoutMilliseconds)
+{
+  bool IsLimited = TimeoutMilliseconds > 0;
+  JZClock::time_point Deadline =
+    JZClock::now() + chrono::milliseconds(TimeoutMilliseconds);
+
+  unique_lock<mutex> Lock(mMutex);
+  while (!mIsStopping && mQueuedMessageCount > 0)
+  {
+    if (!IsLimited)
+    {
+      mCondition.wait(Lock);
+    }
+    else if (mCondition.wait_until(Lock, Deadline) == cv_status::timeout)
+    {
+      return mQueuedMessageCount == 0;
+    }
+  }
+
+  JZClock::time_point NextTime = JZClock::now();
+  for (
+    map<int, JZDeviceQueue*>::const_iterator iQueue = mQueues.begin();
+    iQueue != mQueues.end();
+    ++iQueue)
+  {
+    if (iQueue->second->mNextTime > NextTime)
+    {
+      NextTime = iQueue->second->mNextTime;
+    }
+  }
+  bool IsIdle = true;
+  if (IsLimited && NextTime > Deadline)
+  {
+    NextTime = Deadline;
+    IsIdle = false;
+  }
+  while (!mIsStopping && JZClock::now() < NextTime)
+  {
+    mCondition.wait_until(Lock, NextTime);
+  }
+  return IsIdle;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSysExSender::RemoveListener(JZSysExListener* pListener)
+{
+  unique_lock<mutex> Lock(mMutex);
+
+  bool IsCalled = true;
+  while (IsCalled)
+  {
+    IsCalled = false;
+    for (
+      map<int, JZDeviceQueue*>::iterator iQueue = mQueues.begin();
+      iQueue != mQueues.end();
+      ++iQueue)
+    {
+      JZDeviceQueue* pQueue = iQueue->second;
+      for (
+        deque<JZMessage>::iterator iMessage = pQueue->mMessages.begin();
+        iMessage != pQueue->mMessages.end();
+        ++iMessage)
+      {
+        if (iMessage->mpListener == pListener)
+        {
+          iMessage->mpListener = nullptr;
+        }
+      }
+      if (pQueue->mpListener == pListener)
+      {
+        IsCalled = true;
+      }
+    }
+    if (IsCalled)
+    {
+      mCondition.wait(Lock);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSysExSender::Stop()
+{
+  {
+    lock_guard<mutex> Lock(mMutex);
+    mIsStopping = true;
+  }
+  mCondition.notify_all();
+
+  for (
+    map<int, JZDeviceQueue*>::iterator iQueue = mQueues.begin();
+    iQueue != mQueues.end();
+    ++iQueue)
+  {
+    iQueue->second->mWorker.join();
+    delete iQueue->second;
+  }
+
+  lock_guard<mutex> Lock(mMutex);
+  mQueues.clear();
+  mQueuedMessageCount = 0;
+  mQueuedByteCount = 0;
+  mIsStopping = false;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSysExSender::GetQueuedMessageCount() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mQueuedMessageCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSysExSender::GetQueuedByteCount() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mQueuedByteCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSysExSender::GetPeakQueuedByteCount() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mPeakQueuedByteCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+unsigned JZSysExSender::GetSentMessageCount() const
+{
+  lock_guard<mutex> Lock(mMutex);
+  return mSentMessageCount;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+int JZSysExSender::GetQueueDevice(int Device) const
+{
+  return Device;
+}
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZSysExSender::OnThreadStart()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Description:
+//   The worker thread of a device.  The pause after a message is measured
+// from the time it was handed to the driver, so the time the driver takes
+// is part of it.
+//-----------------------------------------------------------------------------
+void JZSysExSender::Run(int Device, JZDeviceQueue* pQueue)
+{
+  OnThreadStart();
+
+  unique_lock<mutex> Lock(mMutex);
+  while (!mIsStopping)
+  {
+    if (pQueue->mMessages.empty())
+    {
+      mCondition.wait(Lock);
+      continue;
+    }
+    if (JZClock::now() < pQueue->mNextTime)
+    {
+      mCondition.wait_until(Lock, pQueue->mNextTime);
+      continue;
+    }
+
+    JZMessage Message;
+    Message.mId = pQueue->mMessages.front().mId;
+    Message.mData.swap(pQueue->mMessages.front().mData);
+    Message.mpListener = pQueue->mMessages.front().mpListener;
+    pQueue->mMessages.pop_front();
+    pQueue->mpListener = Message.mpListener;
+    pQueue->mIsSending = true;
+
+    // Only SysEx messages are paced.
+    int Length = static_cast<int>(Message.mData.size());
+    long long Microseconds = 0;
+    if (Message.mData[0] == 0xF0)
+    {
+      Microseconds = mGapMicroseconds;
+      if (mBytesPerSecond > 0)
+      {
+        Microseconds += 1000000LL * Length / mBytesPerSecond;
+      }
+    }
+    JZClock::time_point Start = JZClock::now();
+    Lock.unlock();
+
+    Transmit(Device, &Message.mData[0], Length);
+    if (Message.mpListener)
+    {
+      Message.mpListener->OnSysExSent(Message.mId);
+    }
+
+    Lock.lock();
+    pQueue->mNextTime = Start + chrono::microseconds(Microseconds);
+    pQueue->mpListener = nullptr;
+    pQueue->mIsSending = false;
+    --mQueuedMessageCount;
+    mQueuedByteCount -= Length;
+    ++mSentMessageCount;
+    mCondition.notify_all();
+  }
+}
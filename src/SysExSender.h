@@ -0,0 +1,184 @@
+//*****************************************************************************
+// The JAZZ++ Midi Sequencer
+//
+// Copyright (C) 1994-2000 Andreas Voss and Per Sigmond, all rights reserved.
+// Modifications Copyright (C) 2004 Patrick Earl
+// Modifications Copyright (C) 2008-2013 Peter J. Stieber
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//*****************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Description:
+//   This is the SysEx listener class declaration.  A listener passed to
+// JZSysExSender::Send() is told when the message went out.
+//*****************************************************************************
+class JZSysExListener
+{
+  public:
+
+    virtual ~JZSysExListener();
+
+    // Called by a sender thread after the message with the passed ID was
+    // handed to the driver.
+    virtual void OnSysExSent(int Id) = 0;
+};
+
+//*****************************************************************************
+// Description:
+//   This is the SysEx sender class declaration.  It sends MIDI messages,
+// usually large SysEx messages, to the output devices in the background so
+// the caller never waits for a slow MIDI interface.
+//
+//   Every queue device, see GetQueueDevice(), has a queue and a worker
+// thread of its own, created when the first message for it is queued.  The
+// messages of a device are sent in order and paced: after a SysEx message
+// of N bytes the next message follows no earlier than N divided by the
+// byte rate plus the gap.  Short messages can be queued as well, so they
+// are not overtaken by a SysEx message sent before them.  They are not
+// paced themselves.
+//
+//   Derived classes send the messages to a driver.  Their destructors must
+// call Stop(), because the worker threads call Transmit().
+//*****************************************************************************
+class JZSysExSender
+{
+  public:
+
+    JZSysExSender();
+
+    virtual ~JZSysExSender();
+
+    // A rate of 0 bytes per second sends without pacing, apart from the gap.
+    void SetPacing(int BytesPerSecond, int GapMilliseconds);
+
+    // Queue a complete MIDI message, including the 0xF0 and 0xF7 of a SysEx
+    // message, and return its ID.
+    int Send(
+      int Device,
+      const unsigned char* pMessage,
+      int Length,
+      JZSysExListener* pListener = nullptr);
+
+    // Whether a message for the device is queued or being sent, or the
+    // pause after the last one has not passed yet.  A message sent around
+    // the sender while it is busy may overtake the queued ones.
+    bool IsBusy(int Device) const;
+
+    // Wait until all queued messages were sent and the pause after the
+    // last one has passed, but no longer than the passed time unless it is
+    // 0.  Returns false if the time ran out first.
+    bool WaitUntilIdle(int TimeoutMilliseconds);
+
+    // The listener is not called any more when this returns.  It must not
+    // be called from OnSysExSent().
+    void RemoveListener(JZSysExListener* pListener);
+
+    // Stop the worker threads.  Messages that were not sent yet are dropped.
+    void Stop();
+
+    // The messages and bytes that are queued but were not sent yet.
+    int GetQueuedMessageCount() const;
+    int GetQueuedByteCount() const;
+
+    // The largest number of bytes queued at once.
+    int GetPeakQueuedByteCount() const;
+
+    unsigned GetSentMessageCount() const;
+
+  protected:
+
+    // Devices sent to the same destination must share a queue, or their
+    // messages are not paced against each other.  By default every device
+    // has a queue of its own.
+    virtual int GetQueueDevice(int Device) const;
+
+    // Called by the worker thread of the queue device for every message.
+    virtual void Transmit(
+      int Device,
+      const unsigned char* pMessage,
+      int Length) = 0;
+
+    // Called by a worker thread before it sends the first message.
+    virtual void OnThreadStart();
+
+  private:
+
+    typedef std::chrono::steady_clock JZClock;
+
+    struct JZMessage
+    {
+      int mId;
+      std::vector<unsigned char> mData;
+      JZSysExListener* mpListener;
+    };
+
+    struct JZDeviceQueue
+    {
+      std::deque<JZMessage> mMessages;
+
+      // When the next message may be sent.
+      JZClock::time_point mNextTime;
+
+      // The listener of the message being sent.
+      JZSysExListener* mpListener;
+
+      bool mIsSending;
+
+      std::thread mWorker;
+    };
+
+    void Run(int Device, JZDeviceQueue* pQueue);
+
+  private:
+
+    // Hidden and unimplemented to prevent accidental copy or assignment.
+    JZSysExSender(const JZSysExSender&);
+    JZSysExSender& operator = (const JZSysExSender&);
+
+  private:
+
+    std::map<int, JZDeviceQueue*> mQueues;
+
+    int mBytesPerSecond;
+
+    int mGapMicroseconds;
+
+    int mNextId;
+
+    int mQueuedMessageCount;
+
+    int mQueuedByteCount;
+
+    int mPeakQueuedByteCount;
+
+    unsigned mSentMessageCount;
+
+    bool mIsStopping;
+
+    mutable std::mutex mMutex;
+
+    std::condition_variable mCondition;
+};
@@ -401,8 +401,21 @@ void JZUndoBuffer::Clear()
 
 void JZSimpleEventArray::Resize()
 {
+  Reserve(mMaxEvents + 50);
+}
+
+// Description:
+//   Make room for at least the passed number of events, so a lot of events
+// can be added without growing the array many times.
+void JZSimpleEventArray::Reserve(int MaxEvents)
+{
+  if (MaxEvents <= mMaxEvents)
+  {
+    return;
+  }
+
   int i;
-  mMaxEvents += 50;
+  mMaxEvents = MaxEvents;
   JZEvent** ppEvents = new JZEvent* [mMaxEvents];
 
   // Copy the previuosly existing event pointers.
@@ -510,7 +523,8 @@ JZEventArray::JZEventArray()
     mpBank(0),
     mpBank2(0),
     mpReset(0),
-    mAudioMode(false)
+    mAudioMode(false),
+    mRevision(0)
 {
   mEventCount = 0;
 
@@ -642,6 +656,8 @@ void JZEventArray::Clear()
 
   mState = tsPlay;
   mAudioMode = false;
+
+  ++mRevision;
 }
 
 
@@ -670,13 +686,21 @@ void JZSimpleEventArray::Sort()
 
 
 void JZEventArray::Cleanup(bool dont_delete_killed_events)
+{
+  Sort();  // moves all killed events to the end of array
+
+  CleanupSorted(dont_delete_killed_events);
+}
+
+
+void JZEventArray::CleanupSorted(bool dont_delete_killed_events)
 {
   JZEvent* pEvent;
   JZControlEvent* pControl;
   JZSysExEvent* s;
   int i;
 
-  Sort();  // moves all killed events to the end of array
+  ++mRevision;
 
   // clear track defaults
 //  delete mpName;
@@ -1921,6 +1945,32 @@ void JZTrack::Merge(JZEventArray* t)
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
+// Description:
+//   Check if the events that are not killed are in clock order.
+static bool IsSorted(JZEvent** ppEvents, int EventCount)
+{
+  JZEvent* pPrevious = 0;
+  for (int i = 0; i < EventCount; ++i)
+  {
+    if (ppEvents[i]->IsKilled())
+    {
+      continue;
+    }
+    if (pPrevious && pPrevious->Compare(*ppEvents[i]) > 0)
+    {
+      return false;
+    }
+    pPrevious = ppEvents[i];
+  }
+  return true;
+}
+
+
+// Description:
+//   Both the track and the recorded events are sorted, so instead of
+// appending the copies and sorting the whole track, the copies are merged
+// into the track in one pass.  At the same clock, the events already in the
+// track come first.
 void JZTrack::MergeRange(
   const JZEventArray& Other,
   int FromClock,
@@ -1939,7 +1989,8 @@ void JZTrack::MergeRange(
     }
   }
 
-  // Merge Recorded mppEvents
+  // Copy Recorded mppEvents
+  vector<JZEvent*> Copies;
   JZEventIterator Copy(&Other);
   JZEvent* pEvent = Copy.Range(FromClock, ToClock);
   while (pEvent)
@@ -1953,10 +2004,73 @@ void JZTrack::MergeRange(
         pChannelEvent->SetChannel(mChannel - 1);
       }
     }
-    Put(c);
+    Copies.push_back(c);
     pEvent = Copy.Next();
   }
-  Cleanup();
+
+  mChanged = true;
+  JZUndoBuffer& UndoBuffer = mUndoBuffers[mUndoIndex];
+  UndoBuffer.Reserve(UndoBuffer.mEventCount + Copies.size());
+  for (
+    vector<JZEvent*>::const_iterator iCopy = Copies.begin();
+    iCopy != Copies.end();
+    ++iCopy)
+  {
+    UndoBuffer.Put(*iCopy, 0);
+  }
+
+  if (
+    !IsSorted(mppEvents, mEventCount) ||
+    (!Copies.empty() && !IsSorted(&Copies[0], Copies.size())))
+  {
+    // Not expected, but take the slow path rather than break the order.
+    Reserve(mEventCount + Copies.size());
+    for (
+      vector<JZEvent*>::const_iterator iCopy = Copies.begin();
+      iCopy != Copies.end();
+      ++iCopy)
+    {
+      JZEventArray::Put(*iCopy);
+    }
+    Cleanup();
+    return;
+  }
+
+  // Killed events are dropped like Cleanup() does; the undo buffer owns
+  // them.
+  int MaxEvents = mEventCount + Copies.size();
+  JZEvent** ppEvents = new JZEvent* [MaxEvents]();
+  int EventCount = 0;
+  vector<JZEvent*>::size_type CopyIndex = 0;
+  for (int i = 0; i < mEventCount; ++i)
+  {
+    JZEvent* pTrackEvent = mppEvents[i];
+    if (pTrackEvent->IsKilled())
+    {
+      continue;
+    }
+    while (
+      CopyIndex < Copies.size() &&
+      Copies[CopyIndex]->Compare(*pTrackEvent) < 0)
+    {
+      ppEvents[EventCount++] = Copies[CopyIndex++];
+    }
+    ppEvents[EventCount++] = pTrackEvent;
+  }
+  while (CopyIndex < Copies.size())
+  {
+    ppEvents[EventCount++] = Copies[CopyIndex++];
+  }
+
+  delete [] mppEvents;
+  mppEvents = ppEvents;
+  mEventCount = EventCount;
+  mMaxEvents = MaxEvents;
+
+  // on audio tracks, adjust length of keyon events to
+  // actual sample length
+  gpMidiPlayer->AdjustAudioLength(this);
+  JZEventArray::CleanupSorted(TRUE);
 }
 
 
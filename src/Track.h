@@ -380,6 +380,8 @@ class JZSimpleEventArray
     // Resize **mppEvents
     void Resize();
 
+    void Reserve(int MaxEvents);
+
     virtual void Clear();
 
     void Put(JZEvent* pEvent);
@@ -501,6 +503,9 @@ class JZEventArray : public JZSimpleEventArray
     virtual void Clear();
     void Cleanup(bool dont_delete_killed_events = false);
 
+    // Cleanup() for events that are already sorted.
+    void CleanupSorted(bool dont_delete_killed_events = false);
+
     void Keyoff2Length();
     void Length2Keyoff();
 
@@ -528,9 +533,19 @@ class JZEventArray : public JZSimpleEventArray
       mAudioMode = AudioMode;
     }
 
+    // Incremented whenever the event list is cleared or cleaned up, so
+    // cached copies of the events (see JZPlaybackSchedule) can tell when
+    // they are out of date.
+    unsigned GetRevision() const
+    {
+      return mRevision;
+    }
+
   protected:
 
     bool mAudioMode;
+
+    unsigned mRevision;
 };
 
 
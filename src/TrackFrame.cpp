@@ -30,6 +30,7 @@
 #include "Harmony.h"
 #include "Help.h"
 #include "JazzPlusPlusApplication.h"
+#include "PlaybackStatisticsDialog.h"
 #include "Player.h"
 #include "Project.h"
 #include "ProjectManager.h"
@@ -121,6 +122,10 @@ BEGIN_EVENT_TABLE(JZTrackFrame, JZEventFrame)
 
   EVT_MENU(ID_TOOLS_RHYTHM_GENERATOR, JZTrackFrame::OnToolsRhythmGenerator)
 
+  EVT_MENU(
+    ID_TOOLS_PLAYBACK_STATISTICS,
+    JZTrackFrame::OnToolsPlaybackStatistics)
+
   EVT_MENU(ID_SETTINGS_METRONOME, JZTrackFrame::OnSettingsMetronome)
 
   EVT_MENU(ID_SETTINGS_SYNTHESIZER, JZTrackFrame::OnSettingsSynthesizerType)
@@ -320,6 +325,9 @@ void JZTrackFrame::CreateMenu()
   mpToolsMenu = new wxMenu;
   mpToolsMenu->Append(ID_TOOLS_HARMONY_BROWSER, "&Harmony Browser...");
   mpToolsMenu->Append(ID_TOOLS_RHYTHM_GENERATOR, "&Rhythm Generator...");
+  mpToolsMenu->Append(
+    ID_TOOLS_PLAYBACK_STATISTICS,
+    "&Playback Statistics...");
 
 #if 0
   // Move to Project Menu
@@ -712,6 +720,14 @@ void JZTrackFrame::OnToolsRhythmGenerator(wxCommandEvent& Event)
   CreateRhythmGenerator(mpTrackWindow, mpProject);
 }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+void JZTrackFrame::OnToolsPlaybackStatistics(wxCommandEvent& Event)
+{
+  JZPlaybackStatisticsDialog PlaybackStatisticsDialog(this, *gpMidiPlayer);
+  PlaybackStatisticsDialog.ShowModal();
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void JZTrackFrame::OnSettingsMetronome(wxCommandEvent& Event)
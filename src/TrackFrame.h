@@ -107,6 +107,8 @@ class JZTrackFrame : public JZEventFrame, public JZButtonLabelInterface
 
     void OnToolsRhythmGenerator(wxCommandEvent& Event);
 
+    void OnToolsPlaybackStatistics(wxCommandEvent& Event);
+
     void OnSettingsMetronome(wxCommandEvent& Event);
 
     void OnSettingsSynthesizerType(wxCommandEvent& Event);
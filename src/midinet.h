@@ -21,6 +21,21 @@
 //
 // Description:
 //   midinet.h using RPC and TCP protocol - Written by Per Sigmond, HiA
+//
+//   The datagram protocol below is shared by midinetd and the player.  Each
+// UDP packet carries a header followed by bundles of timestamped MIDI bytes.
+// Every bundle has a sequence number and every packet repeats the bundles
+// sent just before it, so the receiver recovers isolated lost packets
+// without asking for them again.  When the sender falls silent it repeats
+// its last packet a few times, so the last bundles are not lost either.
+// All numbers are big endian.
+//
+//   packet header   magic 'J' 'Z', version, type, send time (4 bytes,
+//                   microseconds of the sender clock), bundle count, unused
+//   bundle header   sequence number (2 bytes), time (4 bytes, microseconds
+//                   of the sender clock), data length (2 bytes)
+//   bundle data     events: delay after the bundle time (2 bytes,
+//                   microseconds), length (1 byte), raw MIDI bytes
 //*****************************************************************************
 
 #ifndef midinet_h
@@ -39,4 +54,55 @@ int get_recbuf_mpu( unsigned char **bufptr );
 }
 #endif
 
+#define MIDINET_UDP_PORT 5044
+
+#define MIDINET_UDP_MAGIC0 'J'
+#define MIDINET_UDP_MAGIC1 'Z'
+#define MIDINET_UDP_VERSION 1
+
+/* Packet types */
+#define MIDINET_UDP_HELLO 1
+#define MIDINET_UDP_BUNDLES 2
+#define MIDINET_UDP_BYE 3
+
+#define MIDINET_UDP_HEADER_SIZE 10
+#define MIDINET_UDP_BUNDLE_HEADER_SIZE 8
+#define MIDINET_UDP_EVENT_HEADER_SIZE 3
+
+/* Stay below the ethernet MTU to avoid IP fragmentation. */
+#define MIDINET_UDP_MAX_PACKET 1400
+
+/* Number of earlier bundles repeated in every packet. */
+#define MIDINET_UDP_REDUNDANCY 2
+
+/* While nothing new is sent, the last packet is repeated after this many
+   microseconds, this many times, so a lost last packet is recovered too. */
+#define MIDINET_UDP_RESEND_INTERVAL 20000
+#define MIDINET_UDP_RESEND_COUNT MIDINET_UDP_REDUNDANCY
+
+/* Bundle data sized so a bundle and its repeated predecessors always fit. */
+#define MIDINET_UDP_MAX_BUNDLE_DATA \
+  ((MIDINET_UDP_MAX_PACKET - MIDINET_UDP_HEADER_SIZE) / \
+   (MIDINET_UDP_REDUNDANCY + 1) - MIDINET_UDP_BUNDLE_HEADER_SIZE)
+
+/* Longest event delay that fits the event header. */
+#define MIDINET_UDP_MAX_DELAY 0xffff
+
+#define MIDINET_PUT16(p, v) \
+  ((p)[0] = (unsigned char)((v) >> 8), \
+   (p)[1] = (unsigned char)(v))
+
+#define MIDINET_PUT32(p, v) \
+  ((p)[0] = (unsigned char)((v) >> 24), \
+   (p)[1] = (unsigned char)((v) >> 16), \
+   (p)[2] = (unsigned char)((v) >> 8), \
+   (p)[3] = (unsigned char)(v))
+
+#define MIDINET_GET16(p) \
+  ((unsigned short)(((p)[0] << 8) | (p)[1]))
+
+#define MIDINET_GET32(p) \
+  (((unsigned int)(p)[0] << 24) | ((unsigned int)(p)[1] << 16) | \
+   ((unsigned int)(p)[2] << 8) | (unsigned int)(p)[3])
+
 #endif
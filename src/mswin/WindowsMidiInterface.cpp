@@ -28,6 +28,7 @@
 #include "WindowsMidiInterface.h"
 
 #include "WindowsAudioInterface.h"
+#include "PlaybackStatistics.h"
 
 extern "C"
 {
@@ -156,6 +157,19 @@ static inline void outsysex(tWinPlayerState* pState)
   // from the queue.
 }
 
+//*****************************************************************************
+//*****************************************************************************
+static inline void AddDispatchLateness(
+  tWinPlayerState* pState,
+  int Microseconds)
+{
+  if (pState->mpStatistics)
+  {
+    pState->mpStatistics->AddDispatchLateness(
+      Microseconds > 0 ? Microseconds : 0);
+  }
+}
+
 //*****************************************************************************
 // handle incoming midi data (internal clock)
 //*****************************************************************************
@@ -250,6 +264,7 @@ void CALLBACK midiIntTimerHandler(
       }
       else
       {
+        int Lateness = (pState->play_time - (int)pMidiEvent->ref) * 1000;
         if (pMidiEvent->data == SYSEX_EVENT)
         {
           outsysex(pState);
@@ -268,6 +283,7 @@ void CALLBACK midiIntTimerHandler(
             return;
           }
         }
+        AddDispatchLateness(pState, Lateness);
       }
     }
     (void) pState->play_buffer.get();
@@ -412,6 +428,8 @@ void CALLBACK midiMidiTimerHandler(
 
     if (pMidiEvent->data)
     {
+      int Lateness =
+        (pState->play_clock - (int)pMidiEvent->ref) * pState->time_per_tick;
       if (pMidiEvent->data == SYSEX_EVENT)
       {
         outsysex(pState);
@@ -430,6 +448,7 @@ void CALLBACK midiMidiTimerHandler(
           return;
         }
       }
+      AddDispatchLateness(pState, Lateness);
     }
     (void) pState->play_buffer.get();
     pMidiEvent = pState->play_buffer.peek();
@@ -629,6 +648,7 @@ void CALLBACK midiMtcTimerHandler(
 
     if (pMidiEvent->data)
     {
+      int Lateness = (pState->play_time - (int)pMidiEvent->ref) * 1000;
       if (pMidiEvent->data == SYSEX_EVENT)
       {
         outsysex(pState);
@@ -647,6 +667,7 @@ void CALLBACK midiMtcTimerHandler(
           return;
         }
       }
+      AddDispatchLateness(pState, Lateness);
     }
     (void) pState->play_buffer.get();
     pMidiEvent = pState->play_buffer.peek();
@@ -50,6 +50,7 @@ void CALLBACK MidiOutProc(
 
 //*****************************************************************************
 //*****************************************************************************
+class JZPlaybackStatistics;
 class JZWindowsAudioPlayer;
 
 // pseudo data word of struct JZMidiEvent, values must be less
@@ -379,6 +380,9 @@ struct tWinPlayerState
   JZWindowsAudioPlayer* audio_player;
   int time_correction;
 
+  // How late the timer handlers send the events, if set.
+  JZPlaybackStatistics* mpStatistics;
+
   JZWinSysexBufferArray* mpInputSysexBuffers;
   JZWinSysexBufferArray* mpOutputSysexBuffers;
   bool mSysexFound;
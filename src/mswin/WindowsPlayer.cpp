@@ -47,7 +47,8 @@ using namespace std;
 //-----------------------------------------------------------------------------
 JZWindowsPlayer::JZWindowsPlayer(JZSong* pSong)
   : JZPlayer(pSong),
-    mpState(0)
+    mpState(0),
+    mMidiClockEvent(0)
 {
   mPollMillisec = 25;
   timer_installed = FALSE;
@@ -62,6 +63,7 @@ JZWindowsPlayer::JZWindowsPlayer(JZSong* pSong)
   mpState->soft_thru = gpConfig->GetValue(C_SoftThru);
   mpState->doing_mtc_rec = FALSE;
   mpState->audio_player = 0;
+  mpState->mpStatistics = &mStatistics;
 
   int ilong = -1, olong = -1;
   if (
@@ -559,13 +561,19 @@ void JZWindowsPlayer::OutNow(JZParam *r)
 //-----------------------------------------------------------------------------
 void JZWindowsPlayer::FillMidiClocks(int to)
 {
+  // The clock records reference our own event, but they must not make the
+  // first record look younger than the schedule events behind it.
+  unsigned Epoch = mpSong->GetPlaybackSchedule().GetEpoch();
+  if (!mPlayBuffer.IsEmpty())
+  {
+    Epoch = mPlayBuffer.GetRecord(0).mEpoch;
+  }
+
   while (midiClockOut <= to)
   {
-    JZMidiClockEvent* pEvent = new JZMidiClockEvent(midiClockOut);
-    mPlayBuffer.Put(pEvent);
+    mPlayBuffer.Insert(midiClockOut, 0, &mMidiClockEvent, Epoch);
     midiClockOut = midiClockOut + mpState->ticks_per_signal;
   }
-  mPlayBuffer.Sort();
 }
 
 //-----------------------------------------------------------------------------
@@ -695,7 +703,7 @@ void JZWindowsPlayer::StartPlay(int Clock, int LoopClock, int Continue)
       pEvent = new JZContPlayEvent(0);
     }
     OutNow(pEvent);
-    FillMidiClocks(mPlayBuffer.GetLastClock()); // also does a sort
+    FillMidiClocks(mPlayBuffer.GetLastClock());
   }
 
 
@@ -828,18 +836,18 @@ void JZWindowsPlayer::FlushToDevice()
 //-----------------------------------------------------------------------------
 void JZWindowsPlayer::FlushToDevice(int clock)
 {
-  JZEventIterator Iterator(&mPlayBuffer);
-  JZEvent* pEvent = Iterator.Range(0, clock);
-  if (pEvent)
+  int Count = 0;
+  while (
+    Count < mPlayBuffer.GetCount() &&
+    mPlayBuffer.GetRecord(Count).mClock < clock)
   {
-    do
-    {
-      OutEvent(pEvent);
-      pEvent->Kill();
-      pEvent = Iterator.Next();
-    } while (pEvent);
-
-    mPlayBuffer.Cleanup(0);
+    OutRecord(mPlayBuffer.GetRecord(Count));
+    ++Count;
+  }
+  if (Count > 0)
+  {
+    mPlayBuffer.RemoveFirst(Count);
+    ReclaimPlayedEvents();
   }
 }
 
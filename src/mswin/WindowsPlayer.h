@@ -83,6 +83,9 @@ class JZWindowsPlayer : public JZPlayer
     void FillMidiClocks(int to);
     void FlushToDevice(int clock);
 
+    // Referenced by the MIDI clock records in the play buffer.
+    JZMidiClockEvent mMidiClockEvent;
+
     JZEventArray OutOfBandEvents;
     int RealTimeClock2Time(int clock);
     int Time2RealTimeClock(int time);